@@ -6,6 +6,7 @@ Description: a crawler that takes in a seed URL, parses the pages and extracts o
 Can search a number of depths and saves these html files into the target directory folder
 
 Inputs: ./crawler [SEED URL] [TARGET DIRECTORY WHERE TO PUT THE DATA] [MAX CRAWLING DEPTH]
+  [--container]
 
 Outputs: For each webpage crawled the crawler program will create a file in the 
 [TARGET DIRECTORY]. The name of the file will start a 1 for the  [SEED URL] 
@@ -16,6 +17,11 @@ depth of search in the file. The URL will be on the first line of the file
 and the depth on the second line. The HTML will for the webpage 
 will start on the third line.
 
+With --container the pages are appended to a single page store
+([TARGET DIRECTORY]/pages.tse, see utils/pagestore.h) instead, in the same
+order and with the same URL, depth and HTML. The indexer and the query
+engine read either.
+
  */
 
 #include <stdio.h>
@@ -27,6 +33,7 @@ will start on the third line.
 
 #include "../utils/header.h"
 #include "../utils/hash.h"
+#include "../utils/pagestore.h"
 #include "crawler.h"
 #include "html.h"
 
@@ -53,6 +60,7 @@ DICTIONARY* dict = NULL;
 char *url_list[MAX_URL_PER_PAGE]; 
 
 int fileCounter = 0; // counter for the html files scraped
+PAGE_STORE* pageStore = NULL; // where pages go with --container, NULL for files
 int url_listLength; // counts length of the URL for looping later
 
 // for crawler statistics
@@ -76,19 +84,27 @@ void validateArgs(int argc, char* argv[]){
   char *writableTest = NULL; // dynamically allocate to prevent overflow
 
   // check for correct number of parameters first
-  if (argc != 4){
+  if (argc != 4 && argc != 5){
     fprintf(stderr, "Error: insufficient arguments. 3 required, you provided %d \n", argc - 1);
-    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] \n");
+    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] [--container] \n");
+
+    exit(1);
+  }
+
+  // the only option is --container, after the depth
+  if (argc == 5 && strcmp(argv[4], "--container")){
+    fprintf(stderr, "Error: unknown option %s \n", argv[4]);
+    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] [--container] \n");
 
     exit(1);
   }
 
   // Validate the max depth (cannot exceed 4)
   // Validate depth is single digit 
-  if ( (argv[argc - 1][1]) || (argv[argc - 1][0] > '4') 
-      || (argv[argc - 1][0] < '0') ) {
-    fprintf(stderr, "Error: Depth must be between 0 and 4. You entered %s \n", argv[argc - 1]);
-    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] \n");
+  if ( (argv[3][1]) || (argv[3][0] > '4') 
+      || (argv[3][0] < '0') ) {
+    fprintf(stderr, "Error: Depth must be between 0 and 4. You entered %s \n", argv[3]);
+    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] [--container] \n");
 
     exit(1);
   }
@@ -96,7 +112,7 @@ void validateArgs(int argc, char* argv[]){
   // Validate that directory exists
   if ( stat(argv[2], &s) != 0){
     fprintf(stderr, "Error: The dir argument %s was not found.  Please enter writable and valid directory. \n", argv[2]);
-    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] \n");
+    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] [--container] \n");
 
     exit(1);
   }
@@ -114,7 +130,7 @@ void validateArgs(int argc, char* argv[]){
 
   if ( writableResult != 0){
     fprintf(stderr, "Error: The dir argument %s was not writable.  Please enter writable and valid directory. \n", argv[2]);
-    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] \n");
+    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] [--container] \n");
 
     exit(1);
   }
@@ -127,7 +143,7 @@ void validateArgs(int argc, char* argv[]){
   // an exit status of not 0 means there was an error
   if (testResult != 0){
     fprintf(stderr, "Error: The URL %s was invalid. Please enter a valid URL. \n", argv[1]);
-    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] \n");
+    printf("Usage: ./crawler [SEED_URL] [TARGET_DIR WHERE TO PUT DATA] [CRAWLING_DEPTH] [--container] \n");
 
     exit(1);
   }
@@ -149,7 +165,7 @@ int initLists(){
 
 // given a URL, getPage function will use wget to grab the HTML and store it in
 // a file within the target directory along with the URL and current_depth
-// prepended to it
+// prepended to it (or in the page store with --container)
 char* getPage(char* url, int current_depth, char* target_directory){
   char* wgetCmd;
   int wgetResult;
@@ -231,19 +247,24 @@ char* getPage(char* url, int current_depth, char* target_directory){
   // increment the file counter for writing
   fileCounter++;
 
-  sprintf(dirWithCounter, "%s/%d", target_directory, fileCounter);
+  // the page store keeps the URL and depth in the record of the page
+  if (pageStore != NULL){
+    appendPage(pageStore, url, current_depth, fileBuffer, strlen(fileBuffer));
+  } else {
+    sprintf(dirWithCounter, "%s/%d", target_directory, fileCounter);
 
-  fileSave = fopen(dirWithCounter, "w");
+    fileSave = fopen(dirWithCounter, "w");
 
-  if (fileSave == NULL){
-    fprintf(stderr, "Error writing temp file to target directory. Aborting \n");
-    exit(1);
-  }
+    if (fileSave == NULL){
+      fprintf(stderr, "Error writing temp file to target directory. Aborting \n");
+      exit(1);
+    }
 
-  // Commit the buffer to file
-  fprintf(fileSave, "%s\n%d\n%s", url, current_depth, fileBuffer);
+    // Commit the buffer to file
+    fprintf(fileSave, "%s\n%d\n%s", url, current_depth, fileBuffer);
 
-  fclose(fileSave);
+    fclose(fileSave);
+  }
 
   // Remove the file
   printf("\n Removing file");
@@ -570,7 +591,12 @@ int main(int argc, char* argv[]) {
   current_depth = 0;
   seedURL = argv[1];
   target_directory = argv[2];
-  specified_max_depth = atoi(argv[argc - 1]);
+  specified_max_depth = atoi(argv[3]);
+
+  // pages are appended to the page store of the directory with --container
+  if (argc == 5){
+    pageStore = createPageStore(target_directory);
+  }
 
   int seedHash = hash1(seedURL) % MAX_NUMBER_OF_SLOTS;
 
@@ -674,6 +700,7 @@ int main(int argc, char* argv[]) {
   // cleanup
   printf("[crawler]:Done crawling. Cleaning up\n");
   cleanup();
+  closePageStore(pageStore);
 
   // print stats
   printStatistics();
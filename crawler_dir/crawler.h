@@ -88,7 +88,7 @@ char *url_list[MAX_URL_PER_PAGE];
 // once a URL is determined to be unique. Get the HTML file saved in TEMP 
 // and read it into a string that is returned by getPage. Store TEMP
 // to a file 1..N after writing the URL and depth on the first and second 
-// lines respectively.
+// lines respectively (or append it to the page store with --container).
 
 char *getPage(char* url, int depth,  char* path);
 
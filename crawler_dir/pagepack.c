@@ -0,0 +1,178 @@
+/*
+
+FILE: pagepack.c
+By: Delos Chang
+
+Description: converts a directory crawled into one file per page into a
+page store (see utils/pagestore.h), so the indexer and the query engine
+read all of its pages from a single file
+
+INPUTS: ./pagepack [--remove] [TARGET DIRECTORY WHERE THE CRAWLED PAGES ARE]
+
+Outputs: [TARGET DIRECTORY]/pages.tse holding the pages 1 to N of the
+directory, with the same document ids. With --remove the page files are
+deleted once the store is complete.
+
+Design Spec:
+Every page file is read whole and split into its URL line, its depth
+line and the HTML after them. A page is only packed if writing those
+three parts back the way the crawler does gives the file byte for byte,
+so the store holds exactly what the directory held. If any page does not
+(or a directory already has a store) nothing is changed.
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../utils/header.h"
+#include "../utils/file.h"
+#include "../utils/pagestore.h"
+
+// Reads the whole file into a malloc'ed buffer and sets its length.
+// Unlike loadDocument, nothing is cut short at a NUL byte
+static char* readPageFile(char* filepath, size_t* length){
+  FILE* fp = fopen(filepath, "rb");
+  if (fp == NULL){
+    fprintf(stderr, "Could not read file %s. Aborting. \n", filepath);
+    return NULL;
+  }
+
+  size_t size = 0;
+  size_t capacity = 64 * 1024;
+  char* page = (char*) malloc(capacity);
+  MALLOC_CHECK(page);
+
+  size_t readResult;
+  while ((readResult = fread(page + size, 1, capacity - size, fp)) > 0){
+    size += readResult;
+    if (size == capacity){
+      capacity *= 2;
+      page = (char*) realloc(page, capacity);
+      MALLOC_CHECK(page);
+    }
+  }
+
+  if (ferror(fp)){
+    fprintf(stderr, "Error reading the file %s. Aborting. \n", filepath);
+    fclose(fp);
+    free(page);
+    return NULL;
+  }
+
+  fclose(fp);
+  *length = size;
+  return page;
+}
+
+// Splits the page into URL, depth and body and appends it to the store.
+// Returns 0 if the page is not laid out the way the crawler writes it
+static int packPage(PAGE_STORE* store, char* page, size_t length){
+  char depthLine[16];
+
+  char* urlEnd = memchr(page, '\n', length);
+  if (urlEnd == NULL){
+    return 0;
+  }
+
+  char* depthStart = urlEnd + 1;
+  char* depthEnd = memchr(depthStart, '\n', length - (depthStart - page));
+  if (depthEnd == NULL){
+    return 0;
+  }
+
+  int depth = atoi(depthStart);
+  int depthLength = snprintf(depthLine, sizeof(depthLine), "%d", depth);
+  if (depth < 0 || depthLength != depthEnd - depthStart
+      || memcmp(depthLine, depthStart, depthLength)){
+    return 0;
+  }
+
+  // the URL is kept NUL terminated in the store's record
+  *urlEnd = '\0';
+  if (strlen(page) != (size_t) (urlEnd - page)){
+    return 0;
+  }
+
+  char* body = depthEnd + 1;
+  appendPage(store, page, depth, body, length - (body - page));
+  return 1;
+}
+
+int main(int argc, char* argv[]){
+  char* filepath = NULL;
+  char name[32];
+  int removePages = 0;
+  size_t length;
+
+  if (argc == 3 && !strcmp(argv[1], "--remove")){
+    removePages = 1;
+  } else if (argc != 2){
+    printf("Usage: ./pagepack [--remove] [TARGET DIRECTORY WHERE THE CRAWLED PAGES ARE] \n");
+    return 1;
+  }
+
+  char* dir = argv[argc - 1];
+
+  if (hasPageStore(dir)){
+    fprintf(stderr, "Error: %s already has a page store \n", dir);
+    return 1;
+  }
+
+  int numPages = dirScan(dir);
+  if (numPages <= 0){
+    printf("No pages found in %s \n", dir);
+    return 1;
+  }
+
+  PAGE_STORE* store = createPageStore(dir);
+  char* storePath = pageStorePath(dir);
+
+  // the pages are named 1 to numPages, like the indexer expects
+  for (int id = 1; id <= numPages; id++){
+    snprintf(name, sizeof(name), "%d", id);
+    filepath = createFilepath(filepath, dir, name);
+
+    char* page = readPageFile(filepath, &length);
+    if (page == NULL || !packPage(store, page, length)){
+      if (page != NULL){
+        fprintf(stderr, "Error: %s is not a crawled page (URL, depth, HTML). Aborting. \n",
+            filepath);
+      }
+
+      // leave the directory as it was
+      closePageStore(store);
+      unlink(storePath);
+      return 1;
+    }
+
+    free(page);
+    free(filepath);
+    filepath = NULL;
+  }
+
+  closePageStore(store);
+
+  if (removePages){
+    for (int id = 1; id <= numPages; id++){
+      snprintf(name, sizeof(name), "%d", id);
+      filepath = createFilepath(filepath, dir, name);
+
+      if (unlink(filepath) != 0){
+        fprintf(stderr, "Error removing %s \n", filepath);
+      }
+
+      free(filepath);
+      filepath = NULL;
+    }
+  }
+
+  printf("Packed %d pages into %s \n", numPages, storePath);
+  free(storePath);
+
+  return 0;
+}
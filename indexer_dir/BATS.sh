@@ -51,6 +51,18 @@ readable.  Please enter readable and valid directory."
 testCmd[j]="./indexer ./unreadable/ index.dat"
 let j++
 
+## test an invalid number of threads
+testName[j]="$j. testing invalid --threads value"
+testExpected[j]="Expected Error: --threads needs a number from 1 to 256"
+testCmd[j]="./indexer --threads 0 ../crawler_dir/data/ index.dat"
+let j++
+
+## test a memory limit too small to be kept
+testName[j]="$j. testing invalid --memory-limit value"
+testExpected[j]="Expected Error: --memory-limit needs a number of megabytes from 16 to 1048576"
+testCmd[j]="./indexer --memory-limit 4 ../crawler_dir/data/ index.dat"
+let j++
+
 # correct input for 3 parameters
 #testName[j]="$j. testing correct input arguments for filename index.dat (3 parameters)"
 #testExpected[j]="No errors expected."
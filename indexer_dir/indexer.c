@@ -7,9 +7,31 @@ Description: an indexer that creates an inverted list of words
 and their occurrences amongst different documents. This inverted index
 will be constructed into a file and reloaded to the query engine.
 
-Inputs: ./indexer [TARGET DIRECTORY WHERE TO FIND THE DATA] [RESULTS FILE NAME]
+Inputs: ./indexer [OPTIONS] [TARGET DIRECTORY WHERE TO FIND THE DATA] [RESULTS FILE NAME]
  OR (for debugging / to test reloading)
-  ./indexer [TARGET_DIRECTORY] [RESULTS FILENAME] [RESULTS FILENAME] [REWRITTEN FILENAME]
+  ./indexer [OPTIONS] [TARGET_DIRECTORY] [RESULTS FILENAME] [RESULTS FILENAME] [REWRITTEN FILENAME]
+
+Options:
+  --binary   write the results file in the binary, mmap-able format
+             (see ../utils/indexfile.h) instead of text
+  --threads N
+             index with N threads: each indexes a run of consecutive
+             documents into a partial index, then the partial indexes
+             are merged by word. The results file is the same as with
+             one thread
+  --memory-limit MB
+             keep the indexer within MB megabytes: whenever the index
+             being built fills half of them it is written out as a
+             sorted run and emptied, and the runs are merged into the
+             results file at the end. The results file is the same as
+             without a limit
+  --incremental
+             record the pages the results file was built from in
+             [RESULTS FILE NAME].state, and next time only index the pages
+             that are new or changed since: the results file is reloaded,
+             the postings of changed pages are replaced and an index of
+             the new pages is merged in. The results file is the same as
+             a full rebuild
 
 Outputs: For each file in the target directory, the indexer will check
 all the words in each file and count their occurrences. This will
@@ -26,6 +48,10 @@ written to the result file in the format of:
   - 7 6 mean the document with identifier 7 has 6 occurrences of cat in
     it
 
+The URL, depth and number of indexed words of every document are written
+to [RESULTS FILE NAME].docs (see ../utils/doctable.h), so that the query
+engine can print results without opening the crawled pages.
+
  */
 
 #include <stdio.h>
@@ -36,21 +62,154 @@ written to the result file in the format of:
 #include <sys/stat.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #include "../utils/header.h"
 #include "../utils/index.h"
 #include "../utils/hash.h"
 #include "../utils/file.h"
+#include "../utils/docreader.h"
+#include "../utils/indexrun.h"
+#include "../utils/indexstate.h"
+#include "../utils/indexfile.h"
+#include "../utils/pagestore.h"
+#include "../utils/doctable.h"
 #include "indexer.h"
 
 // create the index
 INVERTED_INDEX* index = NULL;
 INVERTED_INDEX* indexReload = NULL;
 
+// format of the results file (set with --binary)
+int indexFormat = INDEX_FORMAT_TEXT;
+
+// slots of a new table of document terms (a power of two)
+#define INDEXER_TERMS_INITIAL_SLOTS 1024
+
+// most threads --threads accepts
+#define INDEXER_MAX_THREADS 256
+
+// number of threads that build the index (set with --threads)
+int indexThreads = 1;
+
+// megabytes --memory-limit accepts. The indexer takes a few megabytes
+// before it indexes anything, so a smaller limit could not be kept
+#define INDEXER_MIN_MEMORY_LIMIT 16
+#define INDEXER_MAX_MEMORY_LIMIT (1024 * 1024)
+
+// share of --memory-limit the indexes being built may fill before they
+// are spilled to runs. The rest is left for the pages being loaded, the
+// word table while it doubles and the spill itself
+#define INDEXER_INDEX_MEMORY_PERCENT 50
+
+// bytes the indexer may use, 0 for no limit (set with --memory-limit)
+size_t indexMemoryLimit = 0;
+
+// runs are named after the results file, e.g. index.dat.run0.3
+char* runFilePrefix = NULL;
+
+// the runs spilled while building the index, in document order
+char** indexRuns = NULL;
+int numIndexRuns = 0;
+
+// 1 to only index the pages that are new or changed since the results
+// file was last built (set with --incremental)
+int incrementalIndexing = 0;
+
+// URL, depth and length of the documents being indexed
+DOC_TABLE* docTable = NULL;
+
+// classes of characters for the tokenizer
+#define CHARACTER_DROPPED 0     // stripped, as sanitize does
+#define CHARACTER_WORD 1        // part of a word
+#define CHARACTER_SPACE 2       // ends a word
+#define CHARACTER_TAG_OPEN 3    // '<'
+#define CHARACTER_TAG_CLOSE 4   // '>'
+
+// where the tokenizer is in the page
+#define TOKENIZER_TEXT_START 0  // after a tag, before any text
+#define TOKENIZER_TEXT 1        // in the text between tags
+#define TOKENIZER_TAG 2         // between '<' and '>'
+
+// what the tokenizer does with each byte of a page (CHARACTER_*) and the
+// byte it writes for it, filled by buildCharacterClasses
+static unsigned char characterClasses[256];
+static char loweredCharacters[256];
+
 // this function prints generic usage information 
 void printUsage(){
-    printf("Normal Usage: ./indexer [TARGET DIRECTORY] [RESULTS FILENAME]\n");
-    printf("Testing Usage: ./indexer [TARGET DIRECTORY] [RESULTS FILENAME] [RESULTS FILENAME] [REWRITTEN FILENAME]\n");
+    printf("Normal Usage: ./indexer [OPTIONS] [TARGET DIRECTORY] [RESULTS FILENAME]\n");
+    printf("Testing Usage: ./indexer [OPTIONS] [TARGET DIRECTORY] [RESULTS FILENAME] [RESULTS FILENAME] [REWRITTEN FILENAME]\n");
+    printf("Options: --binary (write the binary index format)\n");
+    printf("         --threads N (index with N threads, then merge)\n");
+    printf("         --memory-limit MB (spill sorted runs to keep within MB megabytes, then merge)\n");
+    printf("         --incremental (only index the pages that are new or changed since the last run)\n");
+}
+
+// this function consumes the leading --options and removes them from
+// argv so that the positional arguments can be validated as before
+void parseOptions(int* argc, char* argv[]){
+  int consumed = 0;
+
+  while (consumed + 1 < *argc && !strncmp(argv[consumed + 1], "--", 2)){
+    char* option = argv[consumed + 1];
+
+    if (!strcmp(option, "--binary")){
+      indexFormat = INDEX_FORMAT_BINARY;
+    } else if (!strcmp(option, "--threads")){
+      // the option takes the next argument as its value
+      char* end = NULL;
+      long value = consumed + 2 < *argc ? strtol(argv[consumed + 2], &end, 10) : 0;
+
+      if (end == NULL || *end != '\0' || value < 1 || value > INDEXER_MAX_THREADS){
+        fprintf(stderr, "Error: --threads needs a number from 1 to %d \n", INDEXER_MAX_THREADS);
+        printUsage();
+
+        exit(1);
+      }
+
+      indexThreads = (int) value;
+      consumed++;
+    } else if (!strcmp(option, "--incremental")){
+      incrementalIndexing = 1;
+    } else if (!strcmp(option, "--memory-limit")){
+      char* end = NULL;
+      long value = consumed + 2 < *argc ? strtol(argv[consumed + 2], &end, 10) : 0;
+
+      if (end == NULL || *end != '\0' || value < INDEXER_MIN_MEMORY_LIMIT
+          || value > INDEXER_MAX_MEMORY_LIMIT){
+        fprintf(stderr, "Error: --memory-limit needs a number of megabytes from %d to %d \n",
+            INDEXER_MIN_MEMORY_LIMIT, INDEXER_MAX_MEMORY_LIMIT);
+        printUsage();
+
+        exit(1);
+      }
+
+      indexMemoryLimit = (size_t) value * 1024 * 1024;
+      consumed++;
+    } else {
+      fprintf(stderr, "Error: unknown option %s \n", option);
+      printUsage();
+
+      exit(1);
+    }
+
+    consumed++;
+  }
+
+  // the delta of an incremental run is merged in memory
+  if (incrementalIndexing && indexMemoryLimit > 0){
+    fprintf(stderr, "Error: --incremental cannot be combined with --memory-limit \n");
+    printUsage();
+
+    exit(1);
+  }
+
+  // shift the positional arguments down over the options
+  for (int i = 1; i + consumed < *argc; i++){
+    argv[i] = argv[i + consumed];
+  }
+  *argc -= consumed;
 }
 
 // this function will validate the arguments passed
@@ -138,259 +297,492 @@ void validateDebugArgs(char* loadFile, char* writeReload){
 ------------
 
 Updates the inverted index by hashing the word and storing it in a 
-WordNode with accompanying DocumentNodes
+WordNode with accompanying postings. The word occurs frequency times
+in the document
 
 returns 1 if successful
 returns 0 if false
 
 */
-int updateIndex(INVERTED_INDEX* index, char* word, int documentId){
-  // hash first
-  int wordHash = hash1(word) % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode = NULL;
-  WordNode* wordNode = NULL;
-
-  // check if hash slot occupied first?
-  if (index->hash[wordHash] == NULL){
-    // not occupied, fill the spot
-    // create Document node first
-    docNode = NULL;
-    docNode = newDocNode(docNode, documentId, 1);
-
-    // create Word Node of word and document node first
-    wordNode = NULL;
-    wordNode = newWordNode(wordNode, docNode, word);
-
-    // indexing at this slot will bring this wordNode up first
-    index->hash[wordHash] = wordNode;
-
-    // change end of inverted Index
-    index->end = wordNode;
-
-    return 1;
-  } else {
-    // occupied, move down the list checking for identical WordNode
-    WordNode* checkWordNode = index->hash[wordHash];
+int updateIndex(INVERTED_INDEX* index, char* word, int documentId, int frequency){
+  // look the word up in the word table first
+  WordNode* matchedWordNode = findWordNode(index, word);
 
-    WordNode* matchedWordNode;
-    WordNode* endWordNode = NULL;
+  if (matchedWordNode == NULL){
+    // WordNode doesn't exist, create new
+    matchedWordNode = NULL;
+    matchedWordNode = newWordNode(matchedWordNode, word, index);
 
-    // check if the pointer is on the current word
-    // we are looking for.
-    // if not, run down the list and check for the word
+    addWordNode(index, matchedWordNode);
+  }
 
-    if (!strncmp(checkWordNode->word, word, WORD_LENGTH)){
-      matchedWordNode = checkWordNode;
+  // documents are indexed in ascending order, so this either bumps the
+  // frequency of the last posting or appends a new one
+  addPosting(matchedWordNode, documentId, frequency, index);
 
-    } else {
-      // loop until the end of the word list
-      // the last WordNode 
-
-      while (checkWordNode != NULL){
-        // reached end of the WordNode list?
-        if ( (checkWordNode->next == NULL) ){
-          // store this last word node in the list
-          endWordNode = checkWordNode;
-          break;
-        }
+  return 1;
+}
 
-        checkWordNode = checkWordNode->next;
-        if (!strncmp(checkWordNode->word, word, WORD_LENGTH)){
-          // found a match that wasn't the first in the list
-          matchedWordNode = checkWordNode; // store this word node
-          break;
-        }
-      }
 
+// Fills characterClasses and loweredCharacters from the rules of sanitize
+// and capitalToLower, so that the tokenizer applies both as it goes
+static void buildCharacterClasses(){
+  for (int b = 0; b < 256; b++){
+    char c = (char) b;
+
+    if (!sanitizeKeepsCharacter(c)){
+      characterClasses[b] = CHARACTER_DROPPED;
+    } else if (c == '<'){
+      characterClasses[b] = CHARACTER_TAG_OPEN;
+    } else if (c == '>'){
+      characterClasses[b] = CHARACTER_TAG_CLOSE;
+    } else if (c == ' '){
+      characterClasses[b] = CHARACTER_SPACE;
+    } else {
+      characterClasses[b] = CHARACTER_WORD;
     }
 
-    // either we ran to end of list and the word was not found
-    // OR we have found a match
-    if (matchedWordNode != NULL){
-      // WordNode already exists
-      // see if document Node exists
-
-      // grab first of the document nodes
-      DocumentNode* matchDocNode = matchedWordNode->page;
-      DocumentNode* endDocNode;
-
-      while (matchDocNode != NULL){
-        // check if the matched Doc Node has the same document ID
-        if (matchDocNode->document_id == documentId){
-          // this is the correct document to increase page frequency
-          matchDocNode->page_word_frequency++;
-          break;
-        }
-        if ( (matchDocNode->next == NULL) ){
+    loweredCharacters[b] = (c >= 'A' && c <= 'Z') ? (char) ('a' + c - 'A') : c;
+  }
+}
 
-          // end of the doc node listing
-          endDocNode = matchDocNode;
+// Creates an empty table of document terms
+DOCUMENT_TERMS* newDocumentTerms(){
+  DOCUMENT_TERMS* terms = (DOCUMENT_TERMS*) malloc(sizeof(DOCUMENT_TERMS));
+  MALLOC_CHECK(terms);
 
-          // create Document node first
-          docNode = NULL;
-          docNode = newDocNode(docNode, documentId, 1);
+  terms->numSlots = INDEXER_TERMS_INITIAL_SLOTS;
+  terms->slots = (DOCUMENT_TERM*) calloc(terms->numSlots, sizeof(DOCUMENT_TERM));
+  terms->used = (int*) malloc(sizeof(int) * terms->numSlots);
+  MALLOC_CHECK(terms->slots);
+  MALLOC_CHECK(terms->used);
+  terms->numUsed = 0;
 
-          // the docNode should be last now
-          endDocNode->next = docNode;
-          break;
-        }
+  return terms;
+}
 
-        matchDocNode = matchDocNode->next;
-      }
-    } else {
-      // WordNode doesn't exist, create new
-      // create Document node first
-      docNode = NULL;
-      docNode = newDocNode(docNode, documentId, 1);
+void freeDocumentTerms(DOCUMENT_TERMS* terms){
+  free(terms->slots);
+  free(terms->used);
+  free(terms);
+}
 
-      wordNode = NULL;
-      wordNode = newWordNode(wordNode, docNode, word);
+// Finds the slot of the word, or the empty slot where it would go
+static int probeDocumentTerm(DOCUMENT_TERMS* terms, char* word, int length,
+    unsigned long wordHash){
+  int mask = terms->numSlots - 1;
+  int position = (int) (wordHash & mask);
 
-      // adjust previous 
-      endWordNode->next = wordNode;
+  while (1){
+    DOCUMENT_TERM* term = &(terms->slots[position]);
 
+    if (term->word == NULL || (term->hash == wordHash && term->length == length
+        && !memcmp(term->word, word, length))){
+      return position;
     }
 
-    return 1;
+    position = (position + 1) & mask;
   }
+}
 
-  return 1;
+// Doubles the table, keeping the order the words first occurred in
+static void growDocumentTerms(DOCUMENT_TERMS* terms){
+  DOCUMENT_TERM* oldSlots = terms->slots;
+
+  terms->numSlots *= 2;
+  terms->slots = (DOCUMENT_TERM*) calloc(terms->numSlots, sizeof(DOCUMENT_TERM));
+  terms->used = (int*) realloc(terms->used, sizeof(int) * terms->numSlots);
+  MALLOC_CHECK(terms->slots);
+  MALLOC_CHECK(terms->used);
+
+  for (int i = 0; i < terms->numUsed; i++){
+    DOCUMENT_TERM* term = &(oldSlots[terms->used[i]]);
+    int position = probeDocumentTerm(terms, term->word, term->length, term->hash);
+
+    terms->slots[position] = *term;
+    terms->used[i] = position;
+  }
+
+  free(oldSlots);
 }
 
+// Counts one more occurrence of the word in the page
+static void countDocumentTerm(DOCUMENT_TERMS* terms, char* word, int length,
+    unsigned long wordHash){
+  int position = probeDocumentTerm(terms, word, length, wordHash);
+  DOCUMENT_TERM* term = &(terms->slots[position]);
 
-//Grabs the next word from HTML Document and returns the position of the word.
-//This is used by a bigger loop to continuously index the HTML page
-// grabNextWordFromHTMLDocument: uses the loadedDocument buffer to parse for the words
-// it will retrieve everything between a set of tags, including javascript. The word
-// retrieved from this function is passed to updateIndex to be updated
-int getNextWordFromHTMLDocument(char* loadedDocument, char* word, int position, 
-INVERTED_INDEX* index, int documentId){
-  int tagFlag = 0;
-  int recordFlag = 1;
-  char character;
-
-  while ( loadedDocument[position] != 0) {
-    character = loadedDocument[position];
-    if ( character == '<' ){
-      // if recordFlag is set, stop the recording
-      if (recordFlag){
-        recordFlag = 0;
-      }
+  if (term->word != NULL){
+    term->frequency++;
+    return;
+  }
 
-      tagFlag = 1;
-      position++; // keep moving along the HTML (skipping the tag)
+  term->word = word;
+  term->length = length;
+  term->hash = wordHash;
+  term->frequency = 1;
+  terms->used[terms->numUsed++] = position;
 
-    } else if ( character == '>'){
-      tagFlag = 0;
-      position++;
+  // keep the table at most half full
+  if (terms->numUsed * 2 > terms->numSlots){
+    growDocumentTerms(terms);
+  }
+}
 
-      // start recording at this position; set the recordFlag
-      // must be opening tag
-      if (!recordFlag){
-        recordFlag = 1;
-      }
-    } 
-
-    // if the tagFlag is 0 and has reached this point, 
-    // then we must have encountered the '>' and moved 1 position after it
-    else if ( tagFlag == 0 && recordFlag){
-      int validLength = 0;
-      // start recording the words
-      char* startRecord = &(loadedDocument[position]);
-
-      // keep going until the closing tag is next
-      while ((loadedDocument[position + 1] != '<' && (loadedDocument[position + 1] != '\0')) ){
-        position++;
-        validLength++;
-      }
+// Hands every distinct word of the page to updateIndex with its
+// frequency, then empties the table for the next page
+static void flushDocumentTerms(DOCUMENT_TERMS* terms, INVERTED_INDEX* index, int documentId){
+  for (int i = 0; i < terms->numUsed; i++){
+    DOCUMENT_TERM* term = &(terms->slots[terms->used[i]]);
 
-      // make sure it is at least 2 characters long
-      if (validLength > 1){
-        // stop recording the words 
-        char* endRecord = &(loadedDocument[position + 1]);
+    // update the index with this word and check it was successful
+    if (updateIndex(index, term->word, documentId, term->frequency) != 1){
+      fprintf(stderr, "Could not successfully index %s", term->word);
+    }
 
-        // take what is between endRecord and startRecord and place
-        // into grabWords
-        char grabWords[(endRecord - startRecord) + 1];
-        BZERO(grabWords, (endRecord - startRecord) + 1);
-        strncpy(grabWords, startRecord, (endRecord - startRecord));
+    term->word = NULL;
+  }
 
-        // grabWords now contains the segment of words between tags
+  terms->numUsed = 0;
+}
 
-        // split by space to get words
-        word = strtok(grabWords, " ");
-        while (word != NULL){
+// Counts the word that ends at *out, if it is at least 3 characters long.
+// The word is terminated in place and *out moves past the NUL: the
+// character after the word was already read (or filtered out), so out
+// still does not pass in. Returns 1 if the word was counted
+static int countWord(DOCUMENT_TERMS* terms, char* word, char** out, unsigned long wordHash){
+  if (word == NULL || *out - word < 3){
+    return 0;
+  }
 
-          // make sure the word is at least 3 characters long
-          if ( strlen(word) > 2){
+  int length = (int) (*out - word);
+  *(*out)++ = '\0';
 
-            // update the index with this word
-            int result = updateIndex(index, word, documentId);
+  countDocumentTerm(terms, word, length, wordHash);
 
-            // check if index update was successful
-            if (result != 1){
-              fprintf(stderr, "Could not successfully index %s", word);
-            }
-          }
+  return 1;
+}
 
-          // get the next word
-          word = strtok(NULL, " "); // uses null pointer
+// Indexes the words of a page
+// indexHTMLDocument: does what sanitize, capitalToLower and the tag by tag
+// scan used to do one after the other, in a single pass. Everything
+// between '<' and '>' is skipped; the text between tags (javascript
+// included) is split at spaces. The characters sanitize keeps are
+// lowercased and written back over the page (out never passes in), so
+// each word is a span of the buffer and is counted where it lies. Like
+// before, a '>' after the text has started is part of a word.
+// The words are counted in terms first (hashed as they are read, the
+// way hash1 would), and each distinct one goes into the index once
+int indexHTMLDocument(char* loadedDocument, DOCUMENT_TERMS* terms, INVERTED_INDEX* index,
+    int documentId){
+  const unsigned char* in = (const unsigned char*) loadedDocument;
+  char* out = loadedDocument;
+  char* word = NULL; // start of the word being read, NULL between words
+  unsigned long wordHash = 0;
+  int state = TOKENIZER_TEXT_START;
+  int numWords = 0;
+
+  for (; *in; in++){
+    unsigned char character = *in;
+
+    switch (characterClasses[character]){
+      case CHARACTER_DROPPED:
+        break;
+
+      case CHARACTER_TAG_OPEN:
+        numWords += countWord(terms, word, &out, wordHash);
+        word = NULL;
+        state = TOKENIZER_TAG;
+        break;
+
+      case CHARACTER_TAG_CLOSE:
+        if (state != TOKENIZER_TEXT){
+          state = TOKENIZER_TEXT_START;
+          break;
         }
-        return(position + 1);
-      }
 
-      // stop recording because next characters will be a tag
-      recordFlag = 0;
+        // inside the text, '>' is just another character
+        if (word == NULL){
+          word = out;
+          wordHash = 5381;
+        }
+        wordHash = wordHash * 33 + character;
+        *out++ = (char) character;
+        break;
 
-    } else {
-      position++;
+      case CHARACTER_SPACE:
+        if (state == TOKENIZER_TAG){
+          break;
+        }
+
+        numWords += countWord(terms, word, &out, wordHash);
+        word = NULL;
+        state = TOKENIZER_TEXT;
+        break;
+
+      default:
+        if (state == TOKENIZER_TAG){
+          break;
+        }
+
+        if (word == NULL){
+          word = out;
+          wordHash = 5381;
+        }
+        wordHash = wordHash * 33 + (unsigned char) loweredCharacters[character];
+        *out++ = loweredCharacters[character];
+        state = TOKENIZER_TEXT;
+        break;
     }
   }
 
-  return -1;
+  // the text can run to the end of the page
+  numWords += countWord(terms, word, &out, wordHash);
+
+  flushDocumentTerms(terms, index, documentId);
 
+  return numWords;
 }
 
 
-// Builds an index from the files in the directory
-// buildIndexFromDir:  scans through the target directory. It iterates through 
-// each file in the directory and uses the getNextWordFromHTMLDocument to 
-// parse it and then subsequently update the index
-void buildIndexFromDir(char* dir, int numOfFiles, INVERTED_INDEX* index){
-  char* writable = NULL;
+// the documents one worker thread indexes into its own partial index
+typedef struct _DOCUMENT_RANGE {
+  char *dir;
+  int first;
+  int last;
+  int part;                         // position of the range in document order
+  INVERTED_INDEX *index;
+  size_t memoryBudget;              // bytes index may take before it is spilled (0 for no limit)
+  char **runFiles;                  // runs spilled so far, in document order
+  int numRuns;
+} DOCUMENT_RANGE;
+
+// Writes the index of the range out as its next run and empties it
+static void spillIndexRun(DOCUMENT_RANGE* range){
+  size_t length = strlen(runFilePrefix) + 32;
+  char* runFile = (char*) malloc(length);
+  MALLOC_CHECK(runFile);
+  snprintf(runFile, length, "%s.run%d.%d", runFilePrefix, range->part, range->numRuns);
+
+  writeIndexRun(range->index, runFile);
+  emptyIndex(range->index);
+
+  range->runFiles = (char**) realloc(range->runFiles, sizeof(char*) * (range->numRuns + 1));
+  MALLOC_CHECK(range->runFiles);
+  range->runFiles[range->numRuns++] = runFile;
+
+  printf("Spilled the index to %s\n", runFile);
+}
+
+// Indexes the documents of the range (first to last, inclusive) into
+// its index, spilling the index to a run whenever it outgrows the budget.
+// The pages are loaded ahead by a document reader; with several threads
+// the readers share DOCUMENT_READER_WINDOW pages
+static void indexDocuments(DOCUMENT_RANGE* range){
+  int window = DOCUMENT_READER_WINDOW / indexThreads;
+  DOCUMENT_TERMS* terms = newDocumentTerms();
   char* loadedDocument;
-  int currentPosition;
+  int documentId;
+
+  DOCUMENT_READER* reader = startDocumentReader(range->dir, range->first, range->last,
+      window > 2 ? window : 2);
 
   // Loop through each of the files 
-  for (int i = 1; i < numOfFiles + 1; i++){
-    // cut off if more than 1000 digits
-    char converted_i[1001];
-    snprintf(converted_i, 1000, "%d", i);
+  while ((loadedDocument = nextDocument(reader, &documentId)) != NULL){
+    // Filter, lowercase and index the words in one pass, after taking
+    // down the URL and depth it writes over
+    recordDocument(docTable, documentId, loadedDocument);
+    recordDocumentWords(docTable, documentId,
+        indexHTMLDocument(loadedDocument, terms, range->index, documentId));
 
-    writable = createFilepath(writable, dir, converted_i);
+    free(loadedDocument);
+    printf("Indexing document %d\n", documentId);
 
-    // Load the document from the filepath
-    loadedDocument = loadDocument(writable);
-    sanitize(loadedDocument);
-    capitalToLower(loadedDocument);
+    if (range->memoryBudget > 0 && indexMemoryUsed(range->index) > range->memoryBudget){
+      spillIndexRun(range);
+    }
+  }
 
-    free(writable);
+  stopDocumentReader(reader);
+  freeDocumentTerms(terms);
+}
 
-    // Loop through and index the words
-    int documentId = i;
+static void* indexDocumentRange(void* argument){
+  indexDocuments((DOCUMENT_RANGE*) argument);
+  return NULL;
+}
 
-    char* word = NULL;
-    currentPosition = 0;
+// Builds an index from the files first to last in the directory
+// buildIndexFromDir:  scans through the target directory. It iterates through 
+// each file in the range and uses indexHTMLDocument to 
+// parse it and then subsequently update the index
+// With --threads, each thread indexes a run of consecutive documents into
+// a partial index of its own, and the partial indexes are then merged by
+// word (in parallel too) into index
+// With --memory-limit, an index that outgrows its share of the limit is
+// spilled to a run. If any was, what is left in memory is spilled too and
+// the runs are listed in indexRuns for main to merge; index stays empty
+void buildIndexFromDir(char* dir, int first, int last, INVERTED_INDEX* index){
+  int numOfFiles = last - first + 1;
+  int numThreads = indexThreads < numOfFiles ? indexThreads : numOfFiles;
+  int numRuns = 0;
+
+  if (numThreads < 1){
+    numThreads = 1;
+  }
 
-    // Updating the index is done within the getNextWordFromHTMLDocument function
-    while ( (currentPosition = getNextWordFromHTMLDocument(
-      loadedDocument, word, currentPosition, index, documentId)) != -1){}
+  buildCharacterClasses();
+
+  DOCUMENT_RANGE* ranges = (DOCUMENT_RANGE*) malloc(sizeof(DOCUMENT_RANGE) * numThreads);
+  INVERTED_INDEX** partials = (INVERTED_INDEX**) malloc(sizeof(INVERTED_INDEX*) * numThreads);
+  pthread_t* threads = (pthread_t*) malloc(sizeof(pthread_t) * numThreads);
+  int* started = (int*) malloc(sizeof(int) * numThreads);
+  MALLOC_CHECK(ranges);
+  MALLOC_CHECK(partials);
+  MALLOC_CHECK(threads);
+  MALLOC_CHECK(started);
+
+  for (int t = 0; t < numThreads; t++){
+    BZERO(&(ranges[t]), sizeof(DOCUMENT_RANGE));
+    ranges[t].dir = dir;
+    ranges[t].first = first + (int) ((long) numOfFiles * t / numThreads);
+    ranges[t].last = first + (int) ((long) numOfFiles * (t + 1) / numThreads) - 1;
+    ranges[t].part = t;
+    ranges[t].memoryBudget = indexMemoryLimit / 100 * INDEXER_INDEX_MEMORY_PERCENT / numThreads;
+
+    // a single range is indexed straight into index
+    ranges[t].index = index;
+    if (numThreads > 1){
+      ranges[t].index = NULL;
+      ranges[t].index = initStructure(ranges[t].index);
+    }
+    partials[t] = ranges[t].index;
 
-    free(loadedDocument);
-    printf("Indexing document %d\n", i);
+    // if no thread can be started, this one indexes the range itself
+    started[t] = numThreads > 1
+      && !pthread_create(&(threads[t]), NULL, indexDocumentRange, &(ranges[t]));
+    if (!started[t]){
+      indexDocumentRange(&(ranges[t]));
+    }
+  }
+
+  for (int t = 0; t < numThreads; t++){
+    if (started[t]){
+      pthread_join(threads[t], NULL);
+    }
+    numRuns += ranges[t].numRuns;
   }
 
+  if (numRuns == 0){
+    // the ranges are in document order, as mergeIndexes needs
+    if (numThreads > 1){
+      mergeIndexes(index, partials, numThreads, numThreads);
+    }
+  } else {
+    // the rest of each range goes after its own runs, so that the runs
+    // stay in document order
+    for (int t = 0; t < numThreads; t++){
+      if (ranges[t].index->numWords > 0){
+        spillIndexRun(&(ranges[t]));
+      }
+      if (numThreads > 1){
+        cleanUpIndex(ranges[t].index);
+      }
+
+      indexRuns = (char**) realloc(indexRuns, sizeof(char*) * (numIndexRuns + ranges[t].numRuns));
+      MALLOC_CHECK(indexRuns);
+      for (int r = 0; r < ranges[t].numRuns; r++){
+        indexRuns[numIndexRuns++] = ranges[t].runFiles[r];
+      }
+      free(ranges[t].runFiles);
+    }
+  }
 
+  free(ranges);
+  free(partials);
+  free(threads);
+  free(started);
+}
+
+// Brings an index up to date with the pages in the directory
+// updateIndexFromDir: reloads the index saved in targetFile, which was
+// built from the pages recorded in before. The postings of the pages that
+// changed or disappeared since are dropped and the changed pages are
+// indexed again in place. The new pages (after before->lastDocumentId)
+// are built into a delta index the way buildIndexFromDir builds any
+// index, and the delta is merged in. Only the changed and new pages are
+// parsed; the other pages keep what docsBefore records of them in
+// docTable. Returns the updated index
+INVERTED_INDEX* updateIndexFromDir(char* dir, int numOfFiles, char* targetFile,
+    INDEX_STATE* before, INDEX_STATE* now, DOC_TABLE* docsBefore){
+  INVERTED_INDEX* updated = NULL;
+  int lastIndexed = before->lastDocumentId;
+  int numChanged = 0;
+
+  updated = initStructure(updated);
+  if (reloadIndexFromFile(targetFile, updated) == NULL){
+    exit(1);
+  }
+
+  // the pages that are gone or not the same as when they were indexed
+  char* removed = (char*) calloc(lastIndexed + 1, sizeof(char));
+  MALLOC_CHECK(removed);
+
+  for (int documentId = 1; documentId <= lastIndexed; documentId++){
+    if (documentId > numOfFiles || indexStateChanged(before, now, documentId)){
+      removed[documentId] = 1;
+      numChanged++;
+    } else {
+      copyDocument(docTable, docsBefore, documentId);
+    }
+  }
+
+  buildCharacterClasses();
+
+  if (numChanged > 0){
+    DOCUMENT_TERMS* terms = newDocumentTerms();
+
+    removeDocuments(updated, removed, lastIndexed);
+
+    for (int documentId = 1; documentId <= lastIndexed && documentId <= numOfFiles; documentId++){
+      if (!removed[documentId]){
+        continue;
+      }
+
+      char* loadedDocument = loadPage(dir, documentId);
+      recordDocument(docTable, documentId, loadedDocument);
+      recordDocumentWords(docTable, documentId,
+          indexHTMLDocument(loadedDocument, terms, updated, documentId));
+
+      free(loadedDocument);
+      printf("Reindexing document %d\n", documentId);
+    }
+
+    freeDocumentTerms(terms);
+  }
+
+  printf("Incremental update: %d changed or removed pages, %d new pages\n",
+      numChanged, numOfFiles > lastIndexed ? numOfFiles - lastIndexed : 0);
+
+  // the new pages all come after the indexed ones, as mergeIndexes needs
+  if (numOfFiles > lastIndexed){
+    INVERTED_INDEX* partials[2];
+    INVERTED_INDEX* merged = NULL;
+    INVERTED_INDEX* delta = NULL;
+
+    delta = initStructure(delta);
+    buildIndexFromDir(dir, lastIndexed + 1, numOfFiles, delta);
+
+    partials[0] = updated;
+    partials[1] = delta;
+    merged = initStructure(merged);
+    mergeIndexes(merged, partials, 2, indexThreads);
+
+    updated = merged;
+  }
+
+  free(removed);
+  return updated;
 }
 
 int main(int argc, char* argv[]){
@@ -399,28 +791,108 @@ int main(int argc, char* argv[]){
   int numOfFiles;
 
   // (1) Validate the parameters
+  parseOptions(&argc, argv);
   validateArgs(argc, argv);
 
   // NORMAL CREATE-INDEX MODE
     // (2) Grab number of files in target dir to loop through
     targetDir = argv[1]; // set the directory
     targetFile = argv[2]; // set the new file to be written to 
-    numOfFiles = dirScan(targetDir); 
+    numOfFiles = countPages(targetDir); // files, or the records of a page store
 
     // (3) Initialize the inverted index
-    index = initStructure(index);
+    runFilePrefix = targetFile;
+
+    // (4) Loop through files to build index. With --incremental, the
+    // index saved last time is updated instead if its state was saved too
+    INDEX_STATE* stateBefore = NULL;
+    INDEX_STATE* stateNow = NULL;
+    DOC_TABLE* docsBefore = NULL;
+    char* stateFile = NULL;
+    char* docTableFile = docTablePath(targetFile);
+
+    if (incrementalIndexing){
+      stateFile = (char*) malloc(strlen(targetFile) + strlen(INDEX_STATE_SUFFIX) + 1);
+      MALLOC_CHECK(stateFile);
+      sprintf(stateFile, "%s%s", targetFile, INDEX_STATE_SUFFIX);
+
+      stateNow = scanIndexState(targetDir, numOfFiles);
+      if (access(targetFile, R_OK) == 0){
+        stateBefore = loadIndexState(stateFile);
+        docsBefore = openDocTable(docTableFile);
+      }
+
+      // without the document table of the pages it was built from, the
+      // index is rebuilt
+      if (stateBefore != NULL && (docsBefore == NULL
+            || docsBefore->numDocuments != stateBefore->lastDocumentId)){
+        freeIndexState(stateBefore);
+        stateBefore = NULL;
+      }
+    }
 
-    // (4) Loop through files to build index
-    buildIndexFromDir(targetDir, numOfFiles, index);
+    // nothing to do if no page changed and the format is the same
+    int upToDate = stateBefore != NULL && indexStatesEqual(stateBefore, stateNow)
+      && isIndexFile(targetFile) == (indexFormat == INDEX_FORMAT_BINARY);
+
+    if (!upToDate){
+      docTable = newDocTable(numOfFiles);
+    }
+
+    if (upToDate){
+      printf("The index in %s is up to date\n", targetFile);
+    } else if (stateBefore != NULL){
+      index = updateIndexFromDir(targetDir, numOfFiles, targetFile, stateBefore, stateNow,
+          docsBefore);
+    } else {
+      index = initStructure(index);
+      buildIndexFromDir(targetDir, 1, numOfFiles, index);
+    }
     LOG("Index finished building");
 
-    // (5) Save the index to a file (sorted)
-    saveIndexToFile(index, targetFile);
+    // (5) Save the index to a file (sorted), merging the runs if it
+    // was spilled
+    if (upToDate){
+      // the results file is left as it is
+    } else if (numIndexRuns > 0){
+      mergeIndexRuns(indexRuns, numIndexRuns, targetFile, indexFormat);
+      LOG("Merging the runs finished");
+
+      for (int r = 0; r < numIndexRuns; r++){
+        remove(indexRuns[r]);
+        free(indexRuns[r]);
+      }
+      free(indexRuns);
+    } else {
+      saveIndexToFile(index, targetFile, indexFormat);
+    }
+
+    if (!upToDate){
+      saveDocTable(docTable, docTableFile);
+    }
+    freeDocTable(docTable);
+    freeDocTable(docsBefore);
+    free(docTableFile);
+
+    // the state goes last, so that it never describes an older index
+    if (incrementalIndexing){
+      if (!upToDate){
+        saveIndexState(stateNow, stateFile);
+      }
+
+      freeIndexState(stateBefore);
+      freeIndexState(stateNow);
+      free(stateFile);
+    }
 
     LOG("Writing index to file finished");
 
+    printPeakMemory("Indexer");
+
     // Clean up basic index 
-    cleanUpIndex(index);
+    if (index != NULL){
+      cleanUpIndex(index);
+    }
 
   // DEBUG MODE: reloading the index file
   if ( argc == 5){
@@ -441,7 +913,7 @@ int main(int argc, char* argv[]){
     }
 
     // Write the index in memory to file
-    saveIndexToFile(reloadResult, writeReload);
+    saveIndexToFile(reloadResult, writeReload, indexFormat);
 
     // Clean up reloaded index
     LOG("Cleaning up");
@@ -4,10 +4,36 @@
 // *****************Impementation Spec********************************
 // File: indexer.c
 // This file contains useful information for implementing the indexer:
+// - DATA STRUCTURES
 // - PROTOTYPES
 
+// DATA STRUCTURES
+
+// a distinct word of the page being indexed and how often it occurs
+typedef struct _DOCUMENT_TERM {
+  char *word;                       // NUL terminated in the page (NULL if the slot is free)
+  int length;                       // strlen of word
+  int frequency;                    // occurrences in the page so far
+  unsigned long hash;               // hash1 of word
+} DOCUMENT_TERM;
+
+// the words of one page, counted before they go into the index, so the
+// index sees each distinct word of a page once. Open addressing, linear
+// probing, at most half full
+typedef struct _DOCUMENT_TERMS {
+  DOCUMENT_TERM *slots;
+  int numSlots;                     // size of the table (a power of two)
+  int *used;                        // taken slots, in the order the words first occurred
+  int numUsed;                      // number of distinct words
+} DOCUMENT_TERMS;
+
 // function PROTOTYPES used by indexer.c 
 
+// parseOptions: consumes the leading --options (e.g. --binary, --threads N,
+// --memory-limit MB, --incremental)
+// and removes them from argv and argc
+void parseOptions(int* argc, char* argv[]);
+
 // validateArgs: validates all the arguments are valid (e.g. directory exists)
 void validateArgs(int argc, char* argv[]);
 
@@ -20,17 +46,28 @@ void validateDebugArgs(char* loadFile, char* writeReload);
 //char* loadDocument(char* filepath);
 
 
-// grabNextWordFromHTMLDocument: uses the loadedDocument buffer to parse for the words
-// it will retrieve everything between a set of tags, including javascript. The word
-// retrieved from this function is passed to updateIndex to be updated
-int getNextWordFromHTMLDocument(char* loadedDocument, char* word, int position, 
-INVERTED_INDEX* index, int documentId);
+// indexHTMLDocument: filters, lowercases and splits the page into words in a
+// single pass over the loadedDocument buffer, skipping the tags. It retrieves
+// everything between a set of tags, including javascript. Each word is
+// terminated in place in the buffer and counted in terms; then every distinct
+// word is passed to updateIndex once, with its frequency. Returns the number
+// of words (occurrences) indexed
+int indexHTMLDocument(char* loadedDocument, DOCUMENT_TERMS* terms, INVERTED_INDEX* index,
+    int documentId);
+
+// newDocumentTerms: creates the table indexHTMLDocument counts the words of a
+// page in. It is emptied after every page, so one is enough per thread
+DOCUMENT_TERMS* newDocumentTerms();
+
+// freeDocumentTerms: frees the table
+void freeDocumentTerms(DOCUMENT_TERMS* terms);
 
-// updateIndex: given a word and document ID, this function will hash the word and 
-// if there are other WordNodes in that slot, it will check if the WordNode for this 
-// word exists already. If not, it goes through the list and checks. If none exists,
-// it will insert the WordNode to the end of the list and update the index.
-int updateIndex(INVERTED_INDEX* index, char* word, int documentId);
+// updateIndex: given a word, document ID and the number of times the word
+// occurs in the document, this function will look the word up in the index's
+// word table. If no WordNode exists for it, it inserts a new one (the table
+// grows as needed). Then it adds the occurrences to the word's posting for
+// this document, appending one if this is the first time the document is seen.
+int updateIndex(INVERTED_INDEX* index, char* word, int documentId, int frequency);
 
 // sanitize: this will sanitize a buffer, stripping everything that should not be
 // parsed into words: e.g. -- newline characters, @, & etc. When choosing what to 
@@ -39,9 +76,20 @@ int updateIndex(INVERTED_INDEX* index, char* word, int documentId);
 //void sanitize(char* loadedDocument);
 
 // buildIndexFromDir:  scans through the target directory. It iterates through 
-// each file in the directory and uses the getNextWordFromHTMLDocument to 
-// parse it and then subsequently update the index
-void buildIndexFromDir(char* dir, int numOfFiles, INVERTED_INDEX* index);
+// the files first to last and uses indexHTMLDocument to 
+// parse them and then subsequently update the index. With --threads N, N
+// partial indexes are built in parallel and merged into index. With
+// --memory-limit, indexes that outgrow the limit are spilled to sorted runs
+// (listed in indexRuns) that are merged into the results file afterwards
+void buildIndexFromDir(char* dir, int first, int last, INVERTED_INDEX* index);
+
+// updateIndexFromDir: with --incremental, reloads the index in targetFile and
+// brings it up to date with the pages in the directory: the pages that changed
+// between the states before and now are indexed again, and the pages that are
+// new are indexed into a delta index that is merged in. The document table
+// keeps what docsBefore records of the other pages. Returns the new index
+INVERTED_INDEX* updateIndexFromDir(char* dir, int numOfFiles, char* targetFile,
+    INDEX_STATE* before, INDEX_STATE* now, DOC_TABLE* docsBefore);
 
 // initStructure: This function initializes the primary index used to read the HTML files 
 // It will hold the hash list which holds the WordNodes which hold the 
@@ -0,0 +1,177 @@
+/*
+
+FILE: sanitizebench.c
+By: Delos Chang
+
+Description: a benchmark that compares sanitize with the way it used to
+filter pages (one character at a time with sprintf and strcat)
+
+INPUTS: ./sanitizebench [TARGET DIRECTORY WHERE THE CRAWLED PAGES ARE]
+
+Outputs: the number of pages and bytes filtered, and how many MB a
+second each version gets through
+
+Design Spec:
+Every page of the directory is loaded into memory once. Each version
+then filters a fresh copy of every page, BENCH_ROUNDS times, and only
+the filtering is timed. The outputs of the two versions are compared
+page by page, so the benchmark also checks that sanitize still gives
+byte for byte the same result.
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../utils/header.h"
+#include "../utils/index.h"
+#include "../utils/file.h"
+
+// every version filters the pages this many times so the timings are stable
+#define BENCH_ROUNDS 5
+
+// seconds since some fixed point
+static double now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The previous sanitize, kept as the reference: it appends every valid
+// character to a second buffer with sprintf and strcat, so it is
+// quadratic in the size of the page
+static void sanitizeByAppending(char* loadedDocument){
+  char* temp;
+  char* clear;
+
+  temp = malloc(sizeof(char) * strlen(loadedDocument) + 1);
+  MALLOC_CHECK(temp);
+  BZERO(temp, (strlen(loadedDocument) + 1));
+
+  clear = malloc(sizeof(char) + 1);
+  MALLOC_CHECK(clear);
+  BZERO(clear, sizeof(char));
+
+  for (int i = 0; loadedDocument[i]; i++){
+    if (loadedDocument[i] > 13){
+      if (loadedDocument[i] == 39 || loadedDocument[i] == ','
+        || loadedDocument[i] == '.'
+        || loadedDocument[i] == '"'){
+        continue;
+      }
+
+      if ((loadedDocument[i] >= 33 && loadedDocument[i] <=44) &&
+        (loadedDocument[i] != '&')){
+        continue;
+      }
+
+      if (loadedDocument[i] >= 59 && loadedDocument[i] <= 64
+        && loadedDocument[i] != 60 && loadedDocument[i] != 62){
+        continue;
+      }
+
+      if (loadedDocument[i] >= 91 && loadedDocument[i] <= 96){
+        continue;
+      }
+
+      if (loadedDocument[i] >= 123 && loadedDocument[i] <= 127){
+        continue;
+      }
+
+      sprintf(clear, "%c", loadedDocument[i]);
+      strcat(temp, clear);
+    }
+  }
+
+  strcpy(loadedDocument, temp);
+
+  free(temp);
+  free(clear);
+}
+
+// Filters a copy of every page with filter, BENCH_ROUNDS times. The
+// copies of the last round are left in results
+static double benchSanitizer(void (*filter)(char*), char** pages, int numPages,
+    char** results){
+  double seconds = 0;
+
+  for (int round = 0; round < BENCH_ROUNDS; round++){
+    for (int i = 0; i < numPages; i++){
+      free(results[i]);
+      results[i] = (char*) malloc(strlen(pages[i]) + 1);
+      MALLOC_CHECK(results[i]);
+      strcpy(results[i], pages[i]);
+
+      double start = now();
+      filter(results[i]);
+      seconds += now() - start;
+    }
+  }
+
+  return seconds;
+}
+
+int main(int argc, char* argv[]){
+  char* filepath = NULL;
+  char name[32];
+  long numBytes = 0;
+
+  if (argc != 2){
+    printf("Usage: ./sanitizebench [TARGET DIRECTORY WHERE THE CRAWLED PAGES ARE] \n");
+    return 1;
+  }
+
+  int numPages = dirScan(argv[1]);
+  if (numPages <= 0){
+    printf("No pages found in %s \n", argv[1]);
+    return 1;
+  }
+
+  char** pages = (char**) calloc(numPages, sizeof(char*));
+  char** appended = (char**) calloc(numPages, sizeof(char*));
+  char** filtered = (char**) calloc(numPages, sizeof(char*));
+  MALLOC_CHECK(pages);
+  MALLOC_CHECK(appended);
+  MALLOC_CHECK(filtered);
+
+  // the pages are named 1 to numPages, like the indexer expects
+  for (int i = 0; i < numPages; i++){
+    snprintf(name, sizeof(name), "%d", i + 1);
+    filepath = createFilepath(filepath, argv[1], name);
+    pages[i] = loadDocument(filepath);
+    free(filepath);
+    filepath = NULL;
+
+    numBytes += strlen(pages[i]);
+  }
+
+  double appendSeconds = benchSanitizer(sanitizeByAppending, pages, numPages, appended);
+  double filterSeconds = benchSanitizer(sanitize, pages, numPages, filtered);
+
+  int mismatches = 0;
+  for (int i = 0; i < numPages; i++){
+    if (strcmp(appended[i], filtered[i]) != 0){
+      fprintf(stderr, "Error: page %d is filtered differently! \n", i + 1);
+      mismatches++;
+    }
+    free(pages[i]);
+    free(appended[i]);
+    free(filtered[i]);
+  }
+  free(pages);
+  free(appended);
+  free(filtered);
+
+  double filteredMB = (double) numBytes * BENCH_ROUNDS / 1e6;
+
+  printf("%d pages, %ld bytes\n", numPages, numBytes);
+  printf("%-14s %12s\n", "sanitize", "MB/s");
+  printf("%-14s %12.1f\n", "appending", filteredMB / appendSeconds);
+  printf("%-14s %12.1f\n", "in place", filteredMB / filterSeconds);
+
+  return mismatches ? 1 : 0;
+}
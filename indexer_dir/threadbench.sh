@@ -0,0 +1,53 @@
+#!/bin/bash
+# Name: threadbench.sh
+#
+# Description: This script measures how the indexer scales with --threads.
+# It builds the index of a directory of crawled pages with 1, 2, 4, 8 and
+# 16 threads, checks that every index is the same as the single threaded
+# one and prints the time taken and the throughput of each run.
+
+# Input:  [TARGET DIRECTORY WHERE THE CRAWLED PAGES ARE] (default ../crawler_dir/data)
+# Output: one line per thread count: seconds, pages a second, MB a second
+# and the speedup over one thread
+
+# Command Line Options: None.
+
+# Pseudocode: for each thread count, run the indexer under the bash time
+# builtin, compare its index to the one of the 1 thread run with cmp, and
+# work out the rates with awk
+
+TARGET_DIR=${1:-../crawler_dir/data}
+BENCH_DIR=`mktemp -d`
+
+if [ ! -d "$TARGET_DIR" ]; then
+  echo "Error: The dir argument $TARGET_DIR was not found."
+  exit 1
+fi
+
+NUM_PAGES=`ls "$TARGET_DIR" | grep -c '^[0-9][0-9]*$'`
+NUM_BYTES=`cat "$TARGET_DIR"/* | wc -c`
+
+echo "$NUM_PAGES pages, $NUM_BYTES bytes, `getconf _NPROCESSORS_ONLN` CPUs"
+printf "%8s %10s %12s %10s %8s\n" "threads" "seconds" "pages/s" "MB/s" "speedup"
+
+TIMEFORMAT=%R
+status=0
+
+for threads in 1 2 4 8 16; do
+  seconds=`{ time ./indexer --threads $threads "$TARGET_DIR" "$BENCH_DIR/index_$threads.dat" \
+    > /dev/null 2>&1; } 2>&1`
+
+  if [ $threads -eq 1 ]; then
+    baseline=$seconds
+  elif ! cmp -s "$BENCH_DIR/index_1.dat" "$BENCH_DIR/index_$threads.dat"; then
+    echo "Error: the index built with $threads threads is different"
+    status=1
+  fi
+
+  awk -v t=$threads -v s=$seconds -v b=$baseline -v p=$NUM_PAGES -v n=$NUM_BYTES \
+    'BEGIN { printf "%8d %10.3f %12.1f %10.2f %8.2f\n", t, s, p / s, n / s / 1e6, b / s }'
+done
+
+rm -rf "$BENCH_DIR"
+
+exit $status
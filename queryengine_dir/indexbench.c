@@ -0,0 +1,252 @@
+/*
+
+FILE: indexbench.c
+By: Delos Chang
+
+Description: a benchmark that compares the text posting format of
+index.dat with the compressed (delta + varint) postings of the index,
+and the scalar block decoder with the SSSE3 one
+
+INPUTS: ./indexbench [TEXT INDEX FILENAME]
+
+Outputs: for the text format, the fixed width format of version 1
+binary files and the compressed postings: the bytes taken by one posting
+and how many postings a second can be decoded. Then how many postings a
+second each block decoder gets through
+
+Design Spec:
+The text index is read into memory once. Every line's "id freq" pairs
+are then parsed with strtol, BENCH_ROUNDS times, and timed. The same
+file is reloaded into an inverted index, whose WordNodes hold their
+postings compressed, and every word's postings are decoded with a
+POSTINGS_CURSOR BENCH_ROUNDS times, and timed. Both passes add up the
+document ids and frequencies so that they can be checked against each
+other.
+
+The block decoders are timed on BENCH_BLOCKS blocks of made up postings
+(mostly small gaps and frequencies, like those of a frequent word) so
+that they are compared on the decoding alone.
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../utils/header.h"
+#include "../utils/index.h"
+
+// every format is decoded this many times so the timings are stable
+#define BENCH_ROUNDS 10
+
+// blocks the block decoders are timed on
+#define BENCH_BLOCKS 4096
+
+// seconds since some fixed point
+static double now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Parses the postings of every line of the text index. Returns the sum
+// of the document ids and frequencies, and sets the number of postings
+// and the bytes their text takes up
+static unsigned long decodeText(char* text, long* numPostings, long* postingBytes){
+  unsigned long checksum = 0;
+  char* position = text;
+  char* end;
+
+  *numPostings = 0;
+  *postingBytes = 0;
+
+  while (*position){
+    // skip the word
+    while (*position && *position != ' '){
+      position++;
+    }
+
+    long documentCount = strtol(position, &end, 10);
+    char* postingsStart = end;
+    position = end;
+
+    for (long i = 0; i < documentCount; i++){
+      checksum += strtol(position, &end, 10);
+      position = end;
+      checksum += strtol(position, &end, 10);
+      position = end;
+    }
+
+    // on to the next line
+    while (*position && *position != '\n'){
+      position++;
+    }
+    *postingBytes += position - postingsStart;
+    *numPostings += documentCount;
+
+    if (*position){
+      position++;
+    }
+  }
+
+  return checksum;
+}
+
+// Decodes the compressed postings of every word in the index
+static unsigned long decodeVarints(INVERTED_INDEX* index, long* numPostings, long* postingBytes){
+  POSTINGS_CURSOR cursor;
+  unsigned long checksum = 0;
+
+  *numPostings = 0;
+  *postingBytes = 0;
+
+  for (int i = 0; i < index->numSlots; i++){
+    WordNode* wordNode = index->slots[i].wordNode;
+    if (wordNode == NULL){
+      continue;
+    }
+
+    startWordPostings(&cursor, wordNode);
+    while (nextPosting(&cursor)){
+      checksum += cursor.documentId + cursor.frequency;
+    }
+
+    *numPostings += wordNode->numPages;
+    *postingBytes += wordNode->postingsLength;
+  }
+
+  return checksum;
+}
+
+// Times decodePostingsBlock with decoder on the blocks. Returns the sum
+// of the document ids and frequencies
+static unsigned long benchBlockDecoder(int decoder, unsigned char* blocks, double* seconds){
+  int documentIds[POSTINGS_BLOCK_SIZE];
+  int frequencies[POSTINGS_BLOCK_SIZE];
+  unsigned long checksum = 0;
+
+  if (selectPostingsDecoder(decoder) != decoder){
+    return 0;
+  }
+
+  double start = now();
+  for (int round = 0; round < BENCH_ROUNDS; round++){
+    const unsigned char* next = blocks;
+    int documentId = 0;
+
+    for (int b = 0; b < BENCH_BLOCKS; b++){
+      next = decodePostingsBlock(next, documentId, documentIds, frequencies);
+      documentId = documentIds[POSTINGS_BLOCK_SIZE - 1];
+      checksum += documentId + frequencies[b % POSTINGS_BLOCK_SIZE];
+    }
+  }
+  *seconds = now() - start;
+
+  return checksum;
+}
+
+// Encodes made up blocks and compares the block decoders on them
+static void benchBlockDecoders(){
+  uint32_t gaps[POSTINGS_BLOCK_SIZE];
+  uint32_t frequencies[POSTINGS_BLOCK_SIZE];
+  double scalarSeconds;
+  double ssse3Seconds;
+  long length = 0;
+
+  unsigned char* blocks = (unsigned char*) malloc((size_t) BENCH_BLOCKS * POSTINGS_MAX_BLOCK_BYTES);
+  MALLOC_CHECK(blocks);
+
+  srand(1);
+  for (int b = 0; b < BENCH_BLOCKS; b++){
+    for (int i = 0; i < POSTINGS_BLOCK_SIZE; i++){
+      // one gap in 8 is a long jump
+      gaps[i] = 1 + (rand() % 8 == 0 ? rand() % 5000 : rand() % 16);
+      frequencies[i] = 1 + (rand() % 16 == 0 ? rand() % 400 : rand() % 4);
+    }
+    length += encodePostingsBlock(blocks + length, gaps, frequencies);
+  }
+
+  unsigned long scalar = benchBlockDecoder(POSTINGS_DECODER_SCALAR, blocks, &scalarSeconds);
+  unsigned long ssse3 = benchBlockDecoder(POSTINGS_DECODER_SSSE3, blocks, &ssse3Seconds);
+
+  double decoded = (double) BENCH_BLOCKS * POSTINGS_BLOCK_SIZE * BENCH_ROUNDS / 1e6;
+
+  printf("\n%d blocks of %d postings, %.2f bytes a posting\n", BENCH_BLOCKS,
+      POSTINGS_BLOCK_SIZE, (double) length / ((double) BENCH_BLOCKS * POSTINGS_BLOCK_SIZE));
+  printf("%-14s %16s\n", "decoder", "Mpostings/s");
+  printf("%-14s %16.1f\n", "scalar", decoded / scalarSeconds);
+
+  if (ssse3 == 0){
+    printf("%-14s %16s\n", "ssse3", "not supported");
+  } else if (ssse3 != scalar){
+    fprintf(stderr, "Error: the block decoders disagree! \n");
+  } else {
+    printf("%-14s %16.1f\n", "ssse3", decoded / ssse3Seconds);
+  }
+
+  // leave the fastest decoder selected
+  selectPostingsDecoder(POSTINGS_DECODER_SSSE3);
+  free(blocks);
+}
+
+int main(int argc, char* argv[]){
+  long numPostings, textBytes, varintBytes;
+  unsigned long textChecksum = 0;
+  unsigned long varintChecksum = 0;
+  double start;
+
+  if (argc != 2){
+    printf("Usage: ./indexbench [TEXT INDEX FILENAME] \n");
+    return 1;
+  }
+
+  char* text = loadDocument(argv[1]);
+
+  start = now();
+  for (int round = 0; round < BENCH_ROUNDS; round++){
+    textChecksum = decodeText(text, &numPostings, &textBytes);
+  }
+  double textSeconds = now() - start;
+
+  free(text);
+
+  INVERTED_INDEX* index = NULL;
+  index = initStructure(index);
+  reloadIndexFromFile(argv[1], index);
+
+  start = now();
+  for (int round = 0; round < BENCH_ROUNDS; round++){
+    varintChecksum = decodeVarints(index, &numPostings, &varintBytes);
+  }
+  double varintSeconds = now() - start;
+
+  cleanUpIndex(index);
+
+  if (textChecksum != varintChecksum){
+    fprintf(stderr, "Error: the formats decoded different postings! \n");
+    return 1;
+  }
+
+  if (numPostings == 0){
+    printf("The index has no postings \n");
+    return 0;
+  }
+
+  double decoded = (double) numPostings * BENCH_ROUNDS / 1e6;
+
+  printf("%ld postings\n", numPostings);
+  printf("%-14s %8s %16s\n", "format", "bytes", "Mpostings/s");
+  printf("%-14s %8.2f %16.1f\n", "text", (double) textBytes / numPostings,
+      decoded / textSeconds);
+  printf("%-14s %8.2f %16s\n", "fixed (v1)", 2.0 * sizeof(uint32_t), "-");
+  printf("%-14s %8.2f %16.1f\n", "compressed", (double) varintBytes / numPostings,
+      decoded / varintSeconds);
+
+  benchBlockDecoders();
+
+  return 0;
+}
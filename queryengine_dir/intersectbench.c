@@ -0,0 +1,434 @@
+/*
+
+FILE: intersectbench.c
+By: Delos Chang
+
+Description: a benchmark that compares ANDing two words with an AND
+iterator, whose leading word skips through the other and whose decoded
+blocks are intersected with each of the scalar and vector kernels, with
+skipping alone and with the way lists used to be intersected (every
+document of one against every document of the other), and then the
+kernels on their own on arrays of ids
+
+INPUTS: ./intersectbench
+
+Outputs: for a long word in BENCH_LONG documents and shorter words in
+1 / ratio as many: how many microseconds one AND of the two takes with
+the old nested loops over their lists of DocumentNodes, when the short
+word's iterator only skips through the long one's, and with an AND
+iterator (../utils/dociterator.h) with each kernel. Then, for
+two arrays of BENCH_KERNEL_IDS ids that have a given share of their ids
+in common, how many million ids a second each kernel gets through
+
+Design Spec:
+The words are made up: the long one is in BENCH_LONG documents picked
+at random out of BENCH_DOCUMENTS. A short word takes half of its
+documents from the long one, so that there are matches, and half at
+random. They are put in an inverted index in memory, whose postings are
+compressed in blocks like those of an index file. Each version ANDs the
+same pair of words BENCH_ROUNDS times, walking every document the AND
+is on. The nested loops get the words as lists of DocumentNodes, as the
+query engine used to make them, and only the intersecting is timed.
+The results of every version are compared, so the benchmark also
+checks that they all find the same documents with the same
+frequencies.
+
+The kernels are then timed on arrays of ids alone, so that they are
+compared on the intersecting and not on decoding postings. Their
+results are compared in the same way.
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../utils/header.h"
+#include "../utils/index.h"
+#include "../utils/intersect.h"
+#include "../utils/dociterator.h"
+#include "querylogic.h"
+
+// every version ANDs the words this many times so the timings are stable
+#define BENCH_ROUNDS 5
+
+// documents in the made up collection, and of the long word
+#define BENCH_DOCUMENTS 200000
+#define BENCH_LONG 20000
+
+// how many times fewer documents the short word is in, one row each
+static const int ratios[] = { 1, 2, 4, 8, 16, 32, 64, 256, 1024, 10000 };
+
+// ids in each of the arrays the kernels intersect, out of 4 times as many
+#define BENCH_KERNEL_IDS 100000
+
+// share of the ids of the arrays that are in both, one row each
+static const double selectivities[] = { 0.001, 0.01, 0.1, 0.5, 0.9, 1 };
+
+// kernels, one column each
+#define NUM_KERNELS 3
+static const char* kernelNames[NUM_KERNELS] = { "scalar", "sse2", "avx2" };
+
+// seconds since some fixed point
+static double now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The intersection the query engine used to do, kept as the reference:
+// every document of final is looked for from the start of list, so it
+// is quadratic
+static void intersectByNestedLoops(DocumentNode** final, DocumentNode** list,
+    DocumentNode** result){
+  DocumentNode* docNode = NULL;
+  int numMatches = 0;
+
+  for (int i = 0; final[i] != NULL; i++){
+    for (int j = 0; list[j] != NULL; j++){
+      if (final[i]->document_id == list[j]->document_id){
+        docNode = NULL;
+        docNode = newDocNode(docNode, final[i]->document_id,
+          final[i]->page_word_frequency + list[j]->page_word_frequency);
+
+        result[numMatches] = docNode;
+        numMatches++;
+        break;
+      }
+    }
+  }
+  result[numMatches] = NULL;
+}
+
+// Makes a NULL terminated list of the DocumentNodes of word, in
+// document order, as the query engine used to
+static DocumentNode** listOfWord(char* word, INVERTED_INDEX* index){
+  DOC_ITERATOR* iterator = keywordIterator(word, index);
+  DocumentNode** list = newDocumentList(iterator->cost);
+  int length = 0;
+
+  while (nextDocIterator(iterator) != DOC_ITERATOR_END){
+    list[length++] = newDocNode(NULL, iterator->documentId, docIteratorFrequency(iterator));
+  }
+  list[length] = NULL;
+  freeDocIterator(iterator);
+
+  return list;
+}
+
+// Times the nested loops on the lists of the two words. Returns the sum
+// of the document ids and frequencies they found, and adds the time it
+// took to seconds
+static unsigned long runNestedLoops(char* shortWord, INVERTED_INDEX* index, double* seconds){
+  DocumentNode** longList = listOfWord("long", index);
+  DocumentNode** shortList = listOfWord(shortWord, index);
+  DocumentNode** result = newDocumentList(BENCH_LONG);
+  unsigned long checksum = 0;
+
+  for (int round = 0; round < BENCH_ROUNDS; round++){
+    double start = now();
+    intersectByNestedLoops(longList, shortList, result);
+    *seconds += now() - start;
+
+    // the results are checked and put back outside the timing
+    checksum = 0;
+    for (int k = 0; result[k]; k++){
+      checksum += result[k]->document_id + result[k]->page_word_frequency;
+    }
+    cleanUpList(result);
+  }
+
+  cleanUpDocumentList(longList);
+  cleanUpDocumentList(shortList);
+  free(result);
+
+  return checksum + 1;
+}
+
+// Picks length of the ids in candidates (numCandidates of them, in
+// order) at random and adds word to the index for each of them, in order
+static void makeWord(char* word, int* candidates, int numCandidates, int length,
+    INVERTED_INDEX* index){
+  // selection sampling keeps the ids in order
+  int picked = 0;
+  for (int i = 0; i < numCandidates && picked < length; i++){
+    if (rand() % (numCandidates - i) < length - picked){
+      reconstructIndex(word, candidates[i], 1 + rand() % 8, index);
+      picked++;
+    }
+  }
+}
+
+// Adds a short word in length documents to the index: half of them are
+// documents of the long word, whose ids are in longIds
+static void makeShortWord(char* word, int* longIds, int length, INVERTED_INDEX* index){
+  int* ids = (int*) malloc(sizeof(int) * (BENCH_LONG + BENCH_DOCUMENTS));
+  MALLOC_CHECK(ids);
+
+  // take every other id of the long word and every other id of the
+  // collection (which may be in the long word too), merged in order
+  int numIds = 0;
+  int j = 0;
+  for (int id = 2; id <= BENCH_DOCUMENTS; id += 2){
+    while (j < BENCH_LONG && longIds[j] < id){
+      if (j % 2 == 0){
+        ids[numIds++] = longIds[j];
+      }
+      j++;
+    }
+    if (j == BENCH_LONG || longIds[j] != id){
+      ids[numIds++] = id;
+    }
+  }
+  while (j < BENCH_LONG){
+    if (j % 2 == 0){
+      ids[numIds++] = longIds[j];
+    }
+    j++;
+  }
+
+  makeWord(word, ids, numIds, length, index);
+  free(ids);
+}
+
+// ANDs the iterators of two words without an AND iterator: the short
+// one leads and the long one skips to each of its documents. Returns the
+// sum of the document ids and frequencies found
+static unsigned long skipThrough(DOC_ITERATOR* shortWord, DOC_ITERATOR* longWord){
+  unsigned long checksum = 0;
+  int documentId = nextDocIterator(shortWord);
+
+  while (documentId != DOC_ITERATOR_END){
+    int found = advanceDocIterator(longWord, documentId);
+
+    if (found == documentId){
+      checksum += documentId + docIteratorFrequency(shortWord) + docIteratorFrequency(longWord);
+      documentId = nextDocIterator(shortWord);
+    } else {
+      documentId = advanceDocIterator(shortWord, found);
+    }
+  }
+
+  return checksum;
+}
+
+// Runs one version: skipping alone (kernel -1), or an AND iterator with
+// kernel. Returns the sum of the document ids and frequencies it found,
+// 0 if the CPU does not have the kernel, and adds the time it took to
+// seconds
+static unsigned long runVersion(int kernel, char* shortWord, INVERTED_INDEX* index,
+    double* seconds){
+  unsigned long checksum = 0;
+
+  if (kernel >= 0 && selectIntersectKernel(kernel) != kernel){
+    return 0;
+  }
+
+  for (int round = 0; round < BENCH_ROUNDS; round++){
+    DOC_ITERATOR* words[2];
+    words[0] = keywordIterator("long", index);
+    words[1] = keywordIterator(shortWord, index);
+
+    double start = now();
+    if (kernel < 0){
+      checksum = skipThrough(words[1], words[0]);
+      freeDocIterator(words[0]);
+      freeDocIterator(words[1]);
+    } else {
+      DOC_ITERATOR* both = newAndIterator(words, 2);
+
+      checksum = 0;
+      while (nextDocIterator(both) != DOC_ITERATOR_END){
+        checksum += both->documentId + docIteratorFrequency(both);
+      }
+      freeDocIterator(both);
+    }
+    *seconds += now() - start;
+  }
+
+  return checksum + 1;
+}
+
+// Makes two arrays of about BENCH_KERNEL_IDS increasing ids out of 4
+// times as many, with about selectivity of the ids of b also in a
+static void makeKernelArrays(double selectivity, int* a, int* aLength, int* b, int* bLength){
+  int universe = 4 * BENCH_KERNEL_IDS;
+  int picked = 0;
+  double otherChance = (1 - selectivity) * BENCH_KERNEL_IDS / (universe - BENCH_KERNEL_IDS);
+
+  *aLength = 0;
+  *bLength = 0;
+  for (int id = 1; id <= universe; id++){
+    // selection sampling for a
+    int inA = rand() % (universe - id + 1) < BENCH_KERNEL_IDS - picked;
+    double chance = inA ? selectivity : otherChance;
+
+    if (inA){
+      a[(*aLength)++] = id;
+      picked++;
+    }
+    if ((double) rand() / RAND_MAX < chance){
+      b[(*bLength)++] = id;
+    }
+  }
+}
+
+// Times intersectDocumentIds with kernel. Returns the sum of the
+// positions of the matches, 0 if the CPU does not have the kernel
+static unsigned long benchKernel(int kernel, int* a, int aLength, int* b, int bLength,
+    int* aMatches, int* bMatches, double* seconds){
+  unsigned long checksum = 0;
+
+  if (selectIntersectKernel(kernel) != kernel){
+    return 0;
+  }
+
+  double start = now();
+  for (int round = 0; round < BENCH_ROUNDS; round++){
+    int numMatches = intersectDocumentIds(a, aLength, b, bLength, aMatches, bMatches);
+    checksum = numMatches;
+    if (numMatches > 0){
+      checksum += aMatches[numMatches - 1] + bMatches[numMatches - 1] + aMatches[numMatches / 2];
+    }
+  }
+  *seconds = now() - start;
+
+  return checksum + 1;
+}
+
+// Compares the kernels on arrays with more and more ids in common
+static void benchKernels(){
+  int* a = (int*) malloc(sizeof(int) * 4 * BENCH_KERNEL_IDS);
+  int* b = (int*) malloc(sizeof(int) * 4 * BENCH_KERNEL_IDS);
+  int* aMatches = (int*) malloc(sizeof(int) * 4 * BENCH_KERNEL_IDS);
+  int* bMatches = (int*) malloc(sizeof(int) * 4 * BENCH_KERNEL_IDS);
+  MALLOC_CHECK(a);
+  MALLOC_CHECK(b);
+  MALLOC_CHECK(aMatches);
+  MALLOC_CHECK(bMatches);
+
+  printf("\narrays of about %d ids out of %d, Mids/s\n", BENCH_KERNEL_IDS,
+      4 * BENCH_KERNEL_IDS);
+  printf("%8s", "common");
+  for (int k = 0; k < NUM_KERNELS; k++){
+    printf(" %12s", kernelNames[k]);
+  }
+  printf("\n");
+
+  for (size_t s = 0; s < sizeof(selectivities) / sizeof(selectivities[0]); s++){
+    int aLength, bLength;
+    unsigned long scalar = 0;
+
+    makeKernelArrays(selectivities[s], a, &aLength, b, &bLength);
+
+    printf("%7.1f%%", selectivities[s] * 100);
+    for (int k = 0; k < NUM_KERNELS; k++){
+      double seconds = 0;
+      unsigned long checksum = benchKernel(k, a, aLength, b, bLength, aMatches, bMatches,
+          &seconds);
+
+      if (k == INTERSECT_KERNEL_SCALAR){
+        scalar = checksum;
+      }
+
+      if (checksum == 0){
+        printf(" %12s", "-");
+      } else if (checksum != scalar){
+        fprintf(stderr, "Error: the %s kernel disagrees! \n", kernelNames[k]);
+        exit(1);
+      } else {
+        printf(" %12.1f", (double) (aLength + bLength) * BENCH_ROUNDS / 1e6 / seconds);
+      }
+    }
+    printf("\n");
+  }
+
+  // leave the fastest kernel selected
+  selectIntersectKernel(INTERSECT_KERNEL_AVX2);
+
+  free(a);
+  free(b);
+  free(aMatches);
+  free(bMatches);
+}
+
+int main(){
+  INVERTED_INDEX* index = NULL;
+  index = initStructure(index);
+  int* collection = (int*) malloc(sizeof(int) * BENCH_DOCUMENTS);
+  int* longIds = (int*) malloc(sizeof(int) * BENCH_LONG);
+  MALLOC_CHECK(collection);
+  MALLOC_CHECK(longIds);
+
+  srand(1);
+  for (int i = 0; i < BENCH_DOCUMENTS; i++){
+    collection[i] = i + 1;
+  }
+  makeWord("long", collection, BENCH_DOCUMENTS, BENCH_LONG, index);
+  free(collection);
+
+  // the documents of the long word, for the short ones to pick from
+  DOC_ITERATOR* longWord = keywordIterator("long", index);
+  for (int i = 0; i < BENCH_LONG; i++){
+    longIds[i] = nextDocIterator(longWord);
+  }
+  freeDocIterator(longWord);
+
+  printf("long word in %d documents out of %d, microseconds an AND\n",
+      BENCH_LONG, BENCH_DOCUMENTS);
+  printf("%8s %8s %12s %12s", "ratio", "short", "nested", "skipping");
+  for (int k = 0; k < NUM_KERNELS; k++){
+    printf(" %12s", kernelNames[k]);
+  }
+  printf("\n");
+
+  for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++){
+    int shortLength = BENCH_LONG / ratios[r];
+    char shortWord[32];
+
+    sprintf(shortWord, "short%d", ratios[r]);
+    makeShortWord(shortWord, longIds, shortLength, index);
+
+    printf("%8d %8d", ratios[r], shortLength);
+    double seconds = 0;
+    unsigned long nested = runNestedLoops(shortWord, index, &seconds);
+    printf(" %12.1f", seconds * 1e6 / BENCH_ROUNDS);
+
+    seconds = 0;
+    unsigned long skipping = runVersion(-1, shortWord, index, &seconds);
+    printf(" %12.1f", seconds * 1e6 / BENCH_ROUNDS);
+    if (skipping != nested){
+      fprintf(stderr, "Error: skipping found different documents than the nested loops! \n");
+      return 1;
+    }
+
+    for (int k = 0; k < NUM_KERNELS; k++){
+      seconds = 0;
+      unsigned long checksum = runVersion(k, shortWord, index, &seconds);
+
+      if (checksum == 0){
+        printf(" %12s", "-");
+      } else if (checksum != skipping){
+        fprintf(stderr, "Error: the AND with the %s kernel found different documents! \n",
+            kernelNames[k]);
+        return 1;
+      } else {
+        printf(" %12.1f", seconds * 1e6 / BENCH_ROUNDS);
+      }
+    }
+    printf("\n");
+  }
+
+  // leave the fastest kernel selected
+  selectIntersectKernel(INTERSECT_KERNEL_AVX2);
+
+  free(longIds);
+  cleanUpIndex(index);
+
+  benchKernels();
+
+  return 0;
+}
@@ -6,7 +6,10 @@ By: Delos Chang
 Description: a command-line processing engine that asks users for input
 and creates a ranking from the crawler and indexer to display to the user
 
-INPUTS: ./queryengine [TARGET INDEXER FILENAME] [RESULTS FILE NAME]
+INPUTS: ./queryengine [--eager] [--top N] [TARGET INDEXER FILENAME] [RESULTS FILE NAME]
+--eager reconstructs the whole index before the first query instead of
+decoding each keyword's postings when it is first searched for
+--top N only prints the best N results of each query
 AND / OR operators for command-line processing
 - a space (" ") represents an 'AND' operator
 - a capital OR represents an 'OR' operator
@@ -17,19 +20,29 @@ Outputs: The query engine will output a ranking based on the queries that the
 user enters
 
 Design Spec: 
-The query engine reloads from index.dat into memory via an inverted index structure.
+The query engine opens index.dat lazily: the file is mapped and only the word at the
+start of each line is recorded. The first time a keyword is searched for, its line is
+decoded into an inverted index structure that serves later searches. If the index file
+is in the binary format (indexer --binary) keywords are looked up directly in the mapping.
 When the user enters a query, it is sanitized (removing extraneous characters) and then
-split into a keyword list (queryList). Each keyword is checked against the inverted index:
-hashing the word, then checking the hash slot and traversing until a WordNode is found.
-If a WordNode is not found, then the word was not indexed. If it is found, all the URLNodes
-of that WordNode are returned as a list. 
+split into a keyword list (queryList). lookUp makes a document iterator over the postings
+of each keyword (one with no documents if the word was not indexed). The keywords between
+two ORs are ANDed: dense words, whose documents a binary index keeps as document bitmaps,
+are ANDed as bitmaps, and the other words skip ahead to the documents their shortest list
+has. The ANDed groups are then ORed together.
 
-If the next keyword in the queryList is AND, the engine will find the intersection of word1's
-list with word2's list. If the next keyword is OR, the engine will find the union of word1's
-list with word2's list. This approach is iterated across the entire queryList.
+collectResults walks the documents of the whole query one at a time, in document order, and
+makes a DocumentNode only for those that match, with the BM25 scores of the keywords that
+matched them. With --top N it keeps the best N in a heap with the worst of them on top.
+The results are then sorted by score (or by frequency) and printed out for the user.
 
-A quicksort algorithm is used to rank the page word frequencies and sort the URLs. This is 
-printed out for the user.
+The URL of each result is looked up in the document table the indexer wrote next to the
+index (index.dat.docs), which is mapped at startup; only without one are the crawled pages
+opened.
+
+The document table also has the number of words of every document, so the results are
+ranked with BM25: the idf of each keyword and the length of each document weigh its
+occurrences. Indexes without one are ranked by word frequency.
 
 Implementation Spec Pseudocode: 
 1. Validate user input arguments
@@ -37,12 +50,13 @@ Implementation Spec Pseudocode:
 3. Query the user via the command line
 4. Change the capital letters to lower case letters
 5. Cross-reference the query with the index 
-6. Rank results via an algorithm based on word frequency with AND / OR operators
+6. Rank results with BM25 (or by word frequency) with AND / OR operators
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -50,14 +64,61 @@ Implementation Spec Pseudocode:
 
 #include "../utils/header.h"
 #include "../utils/index.h"
+#include "../utils/indexfile.h"
+#include "../utils/doctable.h"
 #include "querylogic.h"
 #include "queryengine.h"
 
 INVERTED_INDEX* indexReload = NULL;
 
+// reconstruct the whole index before the first query (set with --eager)
+int eagerReload = 0;
+
 // this function prints generic usage information 
 void printUsage(){
-  printf("Usage: ./queryengine ../indexer_dir/index.dat ../crawler_dir/data \n"); 
+  printf("Usage: ./queryengine [--eager] [--top N] ../indexer_dir/index.dat ../crawler_dir/data \n"); 
+}
+
+// this function consumes the leading --options and removes them from
+// argv so that the positional arguments can be validated as before
+void parseOptions(int* argc, char* argv[]){
+  int consumed = 0;
+
+  while (consumed + 1 < *argc && !strncmp(argv[consumed + 1], "--", 2)){
+    char* option = argv[consumed + 1];
+
+    if (!strcmp(option, "--eager")){
+      eagerReload = 1;
+    } else if (!strcmp(option, "--top") && consumed + 2 < *argc){
+      // the number of results comes right after the option
+      char* end;
+      long limit = strtol(argv[consumed + 2], &end, 10);
+
+      if (*end != '\0' || limit < 1 || limit > INT_MAX){
+        fprintf(stderr, "Error: --top takes a positive number of results, not %s \n",
+            argv[consumed + 2]);
+        printUsage();
+
+        exit(1);
+      }
+
+      resultLimit = (int) limit;
+      consumed++;
+    } else {
+      fprintf(stderr, "Error: unknown option %s \n", option);
+      printUsage();
+
+      exit(1);
+    }
+
+    consumed++;
+  }
+
+  // shift the positional arguments down over the options
+  for (int i = 1; i + consumed < *argc; i++){
+    argv[i] = argv[i + consumed];
+  }
+  *argc -= consumed;
 }
 
 void validateArgs(int argc, char* argv[]){
@@ -91,6 +152,7 @@ void validateArgs(int argc, char* argv[]){
 
 int main(int argc, char* argv[]){
   // (1) Validate the parameters
+  parseOptions(&argc, argv);
   validateArgs(argc, argv);
 
   // (2) Initialize the inverted index
@@ -104,13 +166,36 @@ int main(int argc, char* argv[]){
   char* urlDir = argv[2];
   int rankingResult = 0;
 
-  INVERTED_INDEX* reloadResult = reloadIndexFromFile(loadFile, indexReload);
-  if (reloadResult == NULL){
-    exit(1);
+  // By default the index is only opened: a binary index file is mapped and
+  // queried in place, a text index has its words recorded and each word's
+  // postings are decoded the first time it is searched for.
+  if (eagerReload){
+    INVERTED_INDEX* reloadResult = reloadIndexFromFile(loadFile, indexReload);
+    if (reloadResult == NULL){
+      exit(1);
+    } else {
+      LOG("Finished reloading index from file");
+    }
   } else {
-    LOG("Finished reloading index from file");
+    if (openIndexLazily(loadFile, indexReload) == NULL){
+      exit(1);
+    }
+    LOG("Finished opening index file");
+  }
+
+  // the URLs of the results come from the document table the indexer
+  // wrote next to the index, if there is one
+  char* docTableFile = docTablePath(loadFile);
+  resultDocTable = openDocTable(docTableFile);
+  free(docTableFile);
+
+  // which also has the document lengths results are ranked with
+  if (resultDocTable != NULL){
+    resultScorer = newBM25Scorer(resultDocTable);
   }
 
+  printPeakMemory("Query engine");
+
   // (3) Query the user via the command line
   while (1) {
     char query[1000];
@@ -137,11 +222,10 @@ int main(int argc, char* argv[]){
     sanitizeKeywords(queryList);
 
     // (4c) Lookup the keywords, apply operators, and return results
-    DocumentNode* saved[1000];
-    BZERO(saved, 1000);
-    lookUp(saved, queryList, indexReload);
+    DocumentNode** saved = lookUp(queryList, indexReload);
 
     // (5) Rank results via an algorithm based on word frequency with AND / OR operators
+    // (and free them)
     rankingResult = rankAndPrint(saved, urlDir); 
     if ( rankingResult != 1){
       fprintf(stderr, "Couldn't rank results");
@@ -160,6 +244,8 @@ int main(int argc, char* argv[]){
   // (7) Clean up the reloaded index
   LOG("Cleaning up");
   cleanUpIndex(indexReload);
+  freeBM25Scorer(resultScorer);
+  freeDocTable(resultDocTable);
 
   return 0;
 }
@@ -8,6 +8,8 @@
 // function PROTOTYPES used by queryengine.c 
 void printUsage();
 
+void parseOptions(int* argc, char* argv[]);
+
 void validateArgs(int argc, char* argv[]);
 
 #endif
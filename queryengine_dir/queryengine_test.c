@@ -16,10 +16,10 @@
 //  It tests the following functions:
 //
 //   INVERTED_INDEX* initStructure(INVERTED_INDEX* index);
-//   DocumentNode** intersection(DocumentNode** final, DocumentNode** list,
+//   DOC_ITERATOR* newAndIterator(DOC_ITERATOR** children, int numChildren);
 //   char** curateWords(char** queryList, char* query);
 //   void rankByFrequency(DocumentNode** saved, int l, int r);
-//   DocumentNode** lookUp(DocumentNode** saved, char** queryList, INVERTED_INDEX* indexReload);
+//   DocumentNode** lookUp(char** queryList, INVERTED_INDEX* indexReload);
 //
 //  If any of the tests fail it prints status 
 //  If all tests pass it prints status.
@@ -46,25 +46,40 @@
 //  This test case calls initStructure() and checks to make sure 
 //  search engine can initialize the basic inverted index structure
 //  
-//  The following test cases  (1-3) are for function:
+//  The following test cases  (1-4) are for function:
 //
-//  DocumentNode** intersection(DocumentNode** final, DocumentNode** list,
-//    DocumentNode** result, int* resultSlot);
+//  DOC_ITERATOR* newAndIterator(DOC_ITERATOR** children, int numChildren);
 //
 //  Test case: TestANDOp:1
-//  This test case calls intersection() for the condition where one list is empty
-//  and the other is not. The result should be that the intersection will be
-//  an empty list
+//  This test case ANDs two words for the condition where one word is in
+//  a document and the other is in none. The AND should have no documents
 //
 //  Test case: TestANDOp:2
-//  This test case calls intersection() for the condition where both lists
-//  are not empty. They have the same DocumentNode. The result should be that the 
-//  intersection will NOT be an empty list
+//  This test case ANDs two words for the condition where both are in the
+//  same document. The AND should be on that document with the sum of
+//  their frequencies
 //
 //  Test case: TestANDOp:3
-//  This test case calls intersection() for the condition where both lists
-//  are not empty. They do not have the same DocumentNode. The intersection
-//  and thus resultant list should be empty 
+//  This test case ANDs two words for the condition where both are in a
+//  document but not in the same one. The AND should have no documents
+//
+//  Test case: TestANDOp:4
+//  This test case ANDs words of about the same length, whose decoded
+//  blocks are intersected with every kernel the CPU has, and a word much
+//  longer than the other, which is skipped through. Both should find the
+//  common documents in order with the sum of their frequencies, and
+//  advanceDocIterator() should find the first document at or past an id
+//
+//  The following test cases (1) for functions:
+//
+//   int intersectDocumentIds(const int* a, int aLength, const int* b, int bLength,
+//     int* aMatches, int* bMatches);
+//   int selectIntersectKernel(int kernel);
+//
+//  Test case: TestIntersectKernels:1
+//  This test intersects arrays of ids with a few and with all ids in
+//  common, and lengths that do not fill the last block, with every
+//  kernel the CPU has, and checks the positions of the matches
 //
 //  The following test cases (1-2) for function:
 //
@@ -86,9 +101,9 @@
 //  This test case calls rankByFrequency() for the condition the DocumentNode
 //  page frequencies are different and need to be ranked accordingly
 //
-//  The following test cases (1-5) for function:
+//  The following test cases (1-6) for function:
 //
-//   DocumentNode** lookUp(DocumentNode** saved, char** queryList, INVERTED_INDEX* indexReload);
+//   DocumentNode** lookUp(char** queryList, INVERTED_INDEX* indexReload);
 //
 //  Test case: TestLookUp:1
 //  This test calls lookUp() for the condition where 
@@ -112,15 +127,216 @@
 //  This test calls lookUp() for the condition where 
 //  the query has both AND and OR
 //
+//  Test case: TestLookUp:6
+//  This test calls lookUp() for the condition where the keywords are in
+//  thousands of documents with ids far past 10000. The results should
+//  all be there, in document order, with a document in both sides of
+//  an OR only once
+//
+//  The following test cases (1) for functions:
+//
+//   void saveIndexToFile(INVERTED_INDEX* index, char* targetFile, int format);
+//   INDEX_FILE* openIndexFile(char* path);
+//
+//  Test case: TestIndexFile:1
+//  This test saves a small index in the binary format, maps it and
+//  calls lookUp() on the mapped file with an AND and an OR query
+//
+//  The following test cases (1) for functions:
+//
+//   void addToDocBitmap(DOC_BITMAP_BUILDER* builder, int documentId);
+//   int docBitmapRank(const DOC_BITMAP* bitmap, int documentId);
+//   DOC_BITMAP* docBitmapAnd(const DOC_BITMAP* a, const DOC_BITMAP* b);
+//   DOC_BITMAP* docBitmapOr(const DOC_BITMAP* a, const DOC_BITMAP* b);
+//   DOC_BITMAP* docBitmapAndNot(const DOC_BITMAP* a, const DOC_BITMAP* b);
+//   int readDocBitmapIds(const DOC_BITMAP* bitmap, DOC_BITMAP_ITERATOR* iterator,
+//       int* ids, int maxIds);
+//
+//  Test case: TestDocBitmap:1
+//  This test builds bitmaps with run, array and bitmap containers,
+//  combines them and checks every id read back against the sets. It
+//  then saves an index with a dense word, checks that it is stored as a
+//  bitmap and calls lookUp() ANDing it with itself and other words
+//
+//  The following test cases (1) for functions:
+//
+//   DOC_ITERATOR* keywordIterator(char* keyword, INVERTED_INDEX* indexReload);
+//   int nextDocIterator(DOC_ITERATOR* iterator);
+//   int advanceDocIterator(DOC_ITERATOR* iterator, int documentId);
+//   int docIteratorFrequency(DOC_ITERATOR* iterator);
+//
+//  Test case: TestDocIterator:1
+//  This test skips iterators over postings and over a document bitmap
+//  ahead across blocks, ANDs them, and calls lookUp() with AND and OR
+//  and with a resultLimit, which should keep only the best results
+//
+//  The following test cases (1) for functions:
+//
+//   INVERTED_INDEX* openIndexLazily(char* loadFile, INVERTED_INDEX* indexReload);
+//   WordNode* lookUpWordNode(INVERTED_INDEX* index, char* word);
+//
+//  Test case: TestLazyOpen:1
+//  This test saves a small text index, opens it lazily and checks that
+//  only the words that were looked up get decoded into the index
+//
+//  The following test cases (1) for functions:
+//
+//   void addWordNode(INVERTED_INDEX* index, WordNode* wordNode);
+//   WordNode* findWordNode(INVERTED_INDEX* index, char* word);
+//
+//  Test case: TestWordTable:1
+//  This test adds enough words to make the word table grow several
+//  times and checks that every word can still be found
+//
+//  The following test cases (1) for functions:
+//
+//   void* arenaAlloc(ARENA* arena, size_t size);
+//   char* arenaCopyString(ARENA* arena, const char* string, size_t length);
+//
+//  Test case: TestArena:1
+//  This test checks that strings are packed back to back, that
+//  allocations are aligned and that oversized requests still succeed
+//
+//  The following test cases (1) for functions:
+//
+//   WordNode* newWordNode(WordNode* wordNode, char* word, INVERTED_INDEX* index);
+//   void addPosting(WordNode* wordNode, int docId, int page_freq, INVERTED_INDEX* index);
+//   int advancePosting(POSTINGS_CURSOR* cursor, int documentId);
+//
+//  Test case: TestPostings:1
+//  This test adds postings to a word in order, out of order and
+//  repeatedly and checks that they stay sorted by document id, and that
+//  advancePosting() jumps over blocks and gallops through one
+//
+//  The following test cases (1) for functions:
+//
+//   int encodeVarint(unsigned char* out, uint32_t value);
+//   const unsigned char* decodeVarint(const unsigned char* in, uint32_t* value);
+//   int nextPosting(POSTINGS_CURSOR* cursor);
+//
+//  Test case: TestVarint:1
+//  This test encodes numbers around the varint byte boundaries and
+//  checks that a frequency can outgrow its byte in place
+//
+//  The following test cases (1) for functions:
+//
+//   int encodePostingsBlock(unsigned char* out, const uint32_t* gaps, const uint32_t* frequencies);
+//   const unsigned char* decodePostingsBlock(const unsigned char* in, int previousDocumentId,
+//       int* documentIds, int* frequencies);
+//
+//  Test case: TestBlockDecode:1
+//  This test encodes a block of numbers of every byte length and checks
+//  that the scalar and the SSSE3 decoders both get them back
+//
+//  The following test cases (1) for functions:
+//
+//   WordNode** sortedWordNodes(INVERTED_INDEX* index, int* numWords);
+//
+//  Test case: TestSortedWords:1
+//  This test adds enough words in a scrambled order for the sort to be
+//  split into parallel runs and checks that they come out in order
+//
+//  The following test cases (1) for functions:
+//
+//   void sanitize(char* loadedDocument);
+//
+//  Test case: TestSanitize:1
+//  This test sanitizes a line of HTML and every byte value, repeated at
+//  shifting offsets so that both the 16 character runs and the table are
+//  used, and checks the result against the filtering rules
+//
+//  The following test cases (1) for functions:
+//
+//   void mergeIndexes(INVERTED_INDEX* index, INVERTED_INDEX** partials, int numPartials,
+//       int numThreads);
+//
+//  Test case: TestMerge:1
+//  This test builds the same documents once into one index and once into
+//  3 partial indexes that are merged by 2 threads, and checks that every
+//  word ends up with the same postings, byte for byte
+//
+//  The following test cases (1) for functions:
+//
+//   DOCUMENT_READER* startDocumentReader(char* dir, int first, int last, int window);
+//   char* nextDocument(DOCUMENT_READER* reader, int* documentId);
+//
+//  Test case: TestDocumentReader:1
+//  This test writes a few pages to a directory and reads them back with a
+//  window smaller than the number of pages, checking that they come out
+//  whole and in document order
+//
+//  The following test cases (1) for functions:
+//
+//   void writeIndexRun(INVERTED_INDEX* index, char* runFile);
+//   void mergeIndexRuns(char** runFiles, int numRuns, char* targetFile, int format);
+//
+//  Test case: TestIndexRun:1
+//  This test spills 3 indexes of consecutive documents to runs, merges
+//  the runs in both formats and checks that the files are the same as
+//  those saved from one index of all the documents
+//
+//  The following test cases (1) for function:
+//
+//   void removeDocuments(INVERTED_INDEX* index, const char* removed, int lastDocumentId);
+//
+//  Test case: TestRemoveDocuments:1
+//  This test removes every even document and one odd one from an index,
+//  checking that the words found only in those are gone and that the
+//  other words have the postings of an index built without them
+//
+//  The following test cases (1) for functions:
+//
+//   int appendPage(PAGE_STORE* store, const char* url, int depth, const char* body,
+//     size_t bodyLength);
+//   char* readPage(PAGE_STORE* store, int documentId);
+//
+//  Test case: TestPageStore:1
+//  This test appends pages to a page store in two sessions, then reads
+//  them back by id, through countPages and through a document reader, and
+//  checks that a store cut off before its offset table still opens
+//
+//  The following test cases (1) for functions:
+//
+//   void saveDocTable(DOC_TABLE* docTable, char* path);
+//   DOC_TABLE* openDocTable(char* path);
+//
+//  Test case: TestDocTable:1
+//  This test records pages in a document table, some copied from another
+//  table, saves it and checks the URL, depth and length of every document
+//  in the mapped file, and that documents never recorded are unknown
+//
+//  The following test cases (1) for functions:
+//
+//   BM25_SCORER* newBM25Scorer(DOC_TABLE* docTable);
+//   double addDocumentScore(BM25_SCORER* scorer, float weight, int documentId, int frequency);
+//   void rankByScore(DocumentNode** saved, int num);
+//
+//  Test case: TestBM25:1
+//  This test looks up "dog OR cat" with a scorer over documents of
+//  different lengths, checks a score against the formula, that rarer
+//  words and shorter documents weigh more, the order rankByScore gives
+//  and that the scores are cleared. It then adds the score of one word
+//  to one document with addDocumentScore()
+//
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "../utils/hash.h"
 #include "../utils/header.h"
 #include "../utils/index.h"
+#include "../utils/indexfile.h"
 #include "../utils/file.h"
+#include "../utils/docreader.h"
+#include "../utils/indexrun.h"
+#include "../utils/pagestore.h"
+#include "../utils/doctable.h"
+#include "../utils/intersect.h"
+#include "../utils/docbitmap.h"
+#include "../utils/dociterator.h"
 #include "querylogic.h"
 
 // Useful MACROS for controlling the unit tests.
@@ -208,9 +424,7 @@ int TestArgs1() {
   sanitizeKeywords(queryList); 
   SHOULD_BE(strcmp(queryList[0], "andrew") == 0);
 
-  DocumentNode* saved[1000];
-  BZERO(saved, 1000);
-  lookUp(saved, queryList, indexReload);
+  DocumentNode** saved = lookUp(queryList, indexReload);
 
   lookUpResult = rankAndPrint(saved, "../crawler_dir/data"); 
 
@@ -222,78 +436,57 @@ int TestArgs1() {
   END_TEST_CASE;
 }
 
+// makes an AND iterator over the documents of two words of index
+static DOC_ITERATOR* andOfWords(INVERTED_INDEX* index, char* first, char* second){
+  DOC_ITERATOR* words[2];
+  words[0] = keywordIterator(first, index);
+  words[1] = keywordIterator(second, index);
+  return newAndIterator(words, 2);
+}
+
 // Test case: TestANDOp:1
-// This test case calls intersection() for the condition where one list is empty
-// and the other is not. The result should be that the intersection will be
-// an empty list
+// This test case ANDs two words for the condition where one word is in a
+// document and the other is in none. The AND should have no documents
 int TestANDOp1() {
   START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+  testIndex = initStructure(testIndex);
 
-  int resultSlot[1000];
-  DocumentNode* result[10000];
-  BZERO(result, 10000);
-  DocumentNode* list1[1000];
-  BZERO(list1, 1000);
-  DocumentNode* list2[1000];
-  BZERO(list2, 1000);
-
-  DocumentNode* docNode = NULL;
-  docNode = newDocNode(docNode, 15, 1);
-
-  list1[0] = docNode;
-
-  intersection(list1, list2, result, resultSlot);
-  SHOULD_BE(result[15] == NULL);
+  reconstructIndex("dog", 15, 1, testIndex);
 
-  free(docNode);
+  DOC_ITERATOR* both = andOfWords(testIndex, "dog", "cat");
+  SHOULD_BE(nextDocIterator(both) == DOC_ITERATOR_END);
+  freeDocIterator(both);
 
+  cleanUpIndex(testIndex);
   END_TEST_CASE;
 }
 
 // Test case: TestANDOp:2
-// This test case calls intersection() for the condition where both lists
-// are not empty. They have the same DocumentNode. The result should be that 
-// the intersection will NOT be an empty list (same DocumentNode)
+// This test case ANDs two words for the condition where both are in the
+// same document. The AND should be on that document (and no other) with
+// the sum of their frequencies
 int TestANDOp2() {
   START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+  testIndex = initStructure(testIndex);
 
-  int resultSlot[1000];
-  DocumentNode* result[10000];
-  BZERO(result, 10000);
-  DocumentNode* list1[1000];
-  BZERO(list1, 1000);
-  DocumentNode* list2[1000];
-  BZERO(list2, 1000);
-
-  DocumentNode* docNode = NULL;
-  docNode = newDocNode(docNode, 15, 1);
-
-  DocumentNode* docNode2 = NULL;
-  docNode2 = newDocNode(docNode2, 15, 1);
-
-  list1[0] = docNode;
-  list2[0] = docNode2;
-
-  intersection(list1, list2, result, resultSlot);
-  SHOULD_BE(result[15] != NULL);
-
-  int k = 0;
-  while (resultSlot[k]){
-    // freeing the matched DocNodes and putting them in tempHolder
-    free(result[resultSlot[k]]);
-    k++;
-  }
+  reconstructIndex("dog", 15, 1, testIndex);
+  reconstructIndex("cat", 15, 1, testIndex);
 
-  free(docNode);
-  free(docNode2);
+  DOC_ITERATOR* both = andOfWords(testIndex, "dog", "cat");
+  SHOULD_BE(nextDocIterator(both) == 15);
+  SHOULD_BE(docIteratorFrequency(both) == 2);
+  SHOULD_BE(nextDocIterator(both) == DOC_ITERATOR_END);
+  freeDocIterator(both);
 
+  cleanUpIndex(testIndex);
   END_TEST_CASE;
 }
 
 // Test case: TestANDOp:3
-// This test case calls intersection() for the condition where both lists
-// are not empty. They do not have the same DocumentNode. The intersection
-// and thus resultant list should be empty 
+// This test case ANDs two words for the condition where both are in a
+// document but not in the same one. The AND should have no documents
 int TestANDOp3() {
   START_TEST_CASE;
 
@@ -304,30 +497,135 @@ int TestANDOp3() {
   SHOULD_BE(indexResult != NULL);
   LOG("Reloading INVERTED INDEX structure");
 
-  int resultSlot[1000];
-  DocumentNode* result[10000];
-  BZERO(result, 10000);
-  DocumentNode* list1[1000];
-  BZERO(list1, 1000);
-  DocumentNode* list2[1000];
-  BZERO(list2, 1000);
+  INVERTED_INDEX* testIndex = NULL;
+  testIndex = initStructure(testIndex);
 
-  DocumentNode* docNode = NULL;
-  docNode = newDocNode(docNode, 15, 1);
+  reconstructIndex("dog", 15, 1, testIndex);
+  reconstructIndex("cat", 16, 1, testIndex);
 
-  DocumentNode* docNode2 = NULL;
-  docNode2 = newDocNode(docNode2, 16, 1);
+  DOC_ITERATOR* both = andOfWords(testIndex, "dog", "cat");
+  SHOULD_BE(nextDocIterator(both) == DOC_ITERATOR_END);
+  freeDocIterator(both);
 
-  list1[0] = docNode;
-  list2[0] = docNode2;
+  cleanUpIndex(testIndex);
+  cleanUpIndex(indexReload);
+  END_TEST_CASE;
+}
 
-  intersection(list1, list2, result, resultSlot);
-  SHOULD_BE(result[0] == NULL);
+// Test case: TestANDOp:4
+// This test case ANDs words of about the same length, whose blocks are
+// intersected with every kernel the CPU has, and a word much longer than
+// the other, whose iterator skips ahead. Both should find the common
+// documents in order with the sum of their frequencies
+int TestANDOp4() {
+  START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+  testIndex = initStructure(testIndex);
+  int kernels[3] = { INTERSECT_KERNEL_SCALAR, INTERSECT_KERNEL_SSE2, INTERSECT_KERNEL_AVX2 };
+
+  // 2, 4, ... 1000 and 3, 6, ... 900
+  for (int id = 1; id <= 1000; id++){
+    if (id % 2 == 0){
+      reconstructIndex("evens", id, 1, testIndex);
+    }
+    if (id % 3 == 0 && id <= 900){
+      reconstructIndex("triples", id, 2, testIndex);
+    }
+  }
+  reconstructIndex("few", 501, 5, testIndex);
+  reconstructIndex("few", 998, 5, testIndex);
+
+  DOC_ITERATOR* evens = keywordIterator("evens", testIndex);
+  SHOULD_BE(advanceDocIterator(evens, 1) == 2);
+  SHOULD_BE(advanceDocIterator(evens, 501) == 502);
+  SHOULD_BE(advanceDocIterator(evens, 502) == 502);
+  SHOULD_BE(advanceDocIterator(evens, 1001) == DOC_ITERATOR_END);
+  freeDocIterator(evens);
+
+  for (int k = 0; k < 3; k++){
+    // a kernel the CPU does not have is left out
+    if (selectIntersectKernel(kernels[k]) != kernels[k]){
+      continue;
+    }
+
+    // the multiples of 6 up to 900
+    DOC_ITERATOR* both = andOfWords(testIndex, "evens", "triples");
+    int numMatches = 0;
+    int inOrder = 1;
+    while (nextDocIterator(both) != DOC_ITERATOR_END){
+      if (both->documentId != 6 * (numMatches + 1) || docIteratorFrequency(both) != 3){
+        inOrder = 0;
+      }
+      numMatches++;
+    }
+    SHOULD_BE(numMatches == 150);
+    SHOULD_BE(inOrder);
+    freeDocIterator(both);
+  }
+  selectIntersectKernel(INTERSECT_KERNEL_AVX2);
 
-  free(docNode);
-  free(docNode2);
+  // only 998 is even (not 501), whichever word comes first
+  DOC_ITERATOR* both = andOfWords(testIndex, "evens", "few");
+  SHOULD_BE(nextDocIterator(both) == 998);
+  SHOULD_BE(docIteratorFrequency(both) == 6);
+  SHOULD_BE(nextDocIterator(both) == DOC_ITERATOR_END);
+  freeDocIterator(both);
+
+  both = andOfWords(testIndex, "few", "evens");
+  SHOULD_BE(nextDocIterator(both) == 998);
+  SHOULD_BE(nextDocIterator(both) == DOC_ITERATOR_END);
+  freeDocIterator(both);
+
+  cleanUpIndex(testIndex);
+  END_TEST_CASE;
+}
+
+// Test case: TestIntersectKernels:1
+// This test intersects arrays of ids with a few and with all ids in
+// common, and lengths that do not fill the last block, with every
+// kernel the CPU has, and checks the positions of the matches
+int TestIntersectKernels1() {
+  START_TEST_CASE;
+  int threes[203];
+  int fives[157];
+  int aMatches[203];
+  int bMatches[203];
+  int kernels[3] = { INTERSECT_KERNEL_SCALAR, INTERSECT_KERNEL_SSE2, INTERSECT_KERNEL_AVX2 };
+
+  // 3, 6, ... 609 and 5, 10, ... 785 have 15, 30, ... 600 in common
+  for (int i = 0; i < 203; i++){
+    threes[i] = 3 * (i + 1);
+  }
+  for (int i = 0; i < 157; i++){
+    fives[i] = 5 * (i + 1);
+  }
+
+  for (int k = 0; k < 3; k++){
+    // a kernel the CPU does not have is left out
+    if (selectIntersectKernel(kernels[k]) != kernels[k]){
+      continue;
+    }
+
+    int numMatches = intersectDocumentIds(threes, 203, fives, 157, aMatches, bMatches);
+    SHOULD_BE(numMatches == 40);
+
+    int matches = 0;
+    for (int n = 0; n < numMatches; n++){
+      if (aMatches[n] == 5 * n + 4 && bMatches[n] == 3 * n + 2){
+        matches++;
+      }
+    }
+    SHOULD_BE(matches == 40);
+
+    // every id in common, and none
+    SHOULD_BE(intersectDocumentIds(threes, 203, threes, 203, aMatches, bMatches) == 203);
+    SHOULD_BE(aMatches[202] == 202 && bMatches[202] == 202);
+    SHOULD_BE(intersectDocumentIds(threes, 203, fives, 0, aMatches, bMatches) == 0);
+  }
+
+  // back to the fastest kernel for the other tests
+  selectIntersectKernel(INTERSECT_KERNEL_AVX2);
 
-  cleanUpIndex(indexReload);
   END_TEST_CASE;
 }
 
@@ -417,27 +715,18 @@ int TestLookUp1() {
   START_TEST_CASE;
   INVERTED_INDEX* testIndex = NULL;
 
-  int wordHash;
-  int wordHash2;
   testIndex = initStructure(testIndex);
 
-  wordHash = hash1("dog") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode = NULL;
-  docNode = newDocNode(docNode, 15, 1);
-
   WordNode* wordNode = NULL;
-  wordNode = newWordNode(wordNode, docNode, "dog");
-  testIndex->hash[wordHash] = wordNode;
+  wordNode = newWordNode(wordNode, "dog", testIndex);
+  addWordNode(testIndex, wordNode);
+  addPosting(wordNode, 15, 1, testIndex);
 
 
-  wordHash2 = hash1("cat") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode2 = NULL;
-  docNode2 = newDocNode(docNode2, 20, 2);
-
   WordNode* wordNode2 = NULL;
-  wordNode2 = newWordNode(wordNode2, docNode2, "cat");
-
-  testIndex->hash[wordHash2] = wordNode2;
+  wordNode2 = newWordNode(wordNode2, "cat", testIndex);
+  addWordNode(testIndex, wordNode2);
+  addPosting(wordNode2, 20, 2, testIndex);
 
   char query[1000] = "dog OR cat";
   sanitize(query);
@@ -445,26 +734,23 @@ int TestLookUp1() {
   char* temp[1000];
   BZERO(temp, 1000);
 
-  char* queryList[2];
-  BZERO(queryList, 2);
+  char* queryList[1000];
+  BZERO(queryList, 1000);
 
   curateWords(queryList, query);
   SHOULD_BE(strcmp(queryList[0],"dog") == 0);
   SHOULD_BE(strcmp(queryList[1],"OR") == 0);
   SHOULD_BE(strcmp(queryList[2],"cat") == 0);
 
-  DocumentNode* saved[1000];
-  BZERO(saved, 1000);
-  lookUp(saved, queryList, testIndex);
+  DocumentNode** saved = lookUp(queryList, testIndex);
 
-  SHOULD_BE(saved[0]->document_id == docNode->document_id);
-  SHOULD_BE(saved[0]->page_word_frequency == docNode->page_word_frequency);
-  SHOULD_BE(saved[1]->document_id == docNode2->document_id);
-  SHOULD_BE(saved[1]->page_word_frequency == docNode2->page_word_frequency);
+  SHOULD_BE(saved[0]->document_id == 15);
+  SHOULD_BE(saved[0]->page_word_frequency == 1);
+  SHOULD_BE(saved[1]->document_id == 20);
+  SHOULD_BE(saved[1]->page_word_frequency == 2);
   
-  cleanUpList(saved);
+  cleanUpDocumentList(saved);
   cleanUpQueryList(queryList);
-  BZERO(saved, 1000);
 
   cleanUpIndex(testIndex);
 
@@ -479,27 +765,18 @@ int TestLookUp2() {
   START_TEST_CASE;
   INVERTED_INDEX* testIndex = NULL;
 
-  int wordHash;
-  int wordHash2;
   testIndex = initStructure(testIndex);
 
-  wordHash = hash1("dog") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode = NULL;
-  docNode = newDocNode(docNode, 15, 1);
-
   WordNode* wordNode = NULL;
-  wordNode = newWordNode(wordNode, docNode, "dog");
-  testIndex->hash[wordHash] = wordNode;
+  wordNode = newWordNode(wordNode, "dog", testIndex);
+  addWordNode(testIndex, wordNode);
+  addPosting(wordNode, 15, 1, testIndex);
 
 
-  wordHash2 = hash1("cat") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode2 = NULL;
-  docNode2 = newDocNode(docNode2, 15, 2);
-
   WordNode* wordNode2 = NULL;
-  wordNode2 = newWordNode(wordNode2, docNode2, "cat");
-
-  testIndex->hash[wordHash2] = wordNode2;
+  wordNode2 = newWordNode(wordNode2, "cat", testIndex);
+  addWordNode(testIndex, wordNode2);
+  addPosting(wordNode2, 15, 2, testIndex);
 
   char query[1000] = "dog AND cat";
   sanitize(query);
@@ -507,24 +784,21 @@ int TestLookUp2() {
   char* temp[1000];
   BZERO(temp, 1000);
 
-  char* queryList[2];
-  BZERO(queryList, 2);
+  char* queryList[1000];
+  BZERO(queryList, 1000);
 
   curateWords(queryList, query);
   SHOULD_BE(strcmp(queryList[0],"dog") == 0);
   SHOULD_BE(strcmp(queryList[1],"AND") == 0);
   SHOULD_BE(strcmp(queryList[2],"cat") == 0);
 
-  DocumentNode* saved[1000];
-  BZERO(saved, 1000);
-  lookUp(saved, queryList, testIndex);
+  DocumentNode** saved = lookUp(queryList, testIndex);
 
-  SHOULD_BE(saved[0]->document_id == docNode->document_id);
+  SHOULD_BE(saved[0]->document_id == 15);
   SHOULD_BE(saved[0]->page_word_frequency == 3);
   
-  cleanUpList(saved);
+  cleanUpDocumentList(saved);
   cleanUpQueryList(queryList);
-  BZERO(saved, 1000);
 
   cleanUpIndex(testIndex);
 
@@ -539,27 +813,18 @@ int TestLookUp3() {
   START_TEST_CASE;
   INVERTED_INDEX* testIndex = NULL;
 
-  int wordHash;
-  int wordHash2;
   testIndex = initStructure(testIndex);
 
-  wordHash = hash1("dog") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode = NULL;
-  docNode = newDocNode(docNode, 15, 1);
-
   WordNode* wordNode = NULL;
-  wordNode = newWordNode(wordNode, docNode, "dog");
-  testIndex->hash[wordHash] = wordNode;
-
+  wordNode = newWordNode(wordNode, "dog", testIndex);
+  addWordNode(testIndex, wordNode);
+  addPosting(wordNode, 15, 1, testIndex);
 
-  wordHash2 = hash1("cat") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode2 = NULL;
-  docNode2 = newDocNode(docNode2, 15, 2);
 
   WordNode* wordNode2 = NULL;
-  wordNode2 = newWordNode(wordNode2, docNode2, "cat");
-
-  testIndex->hash[wordHash2] = wordNode2;
+  wordNode2 = newWordNode(wordNode2, "cat", testIndex);
+  addWordNode(testIndex, wordNode2);
+  addPosting(wordNode2, 15, 2, testIndex);
 
   char query[1000] = "dog cat";
   sanitize(query);
@@ -574,16 +839,13 @@ int TestLookUp3() {
   SHOULD_BE(strcmp(queryList[0],"dog") == 0);
   SHOULD_BE(strcmp(queryList[1],"cat") == 0);
 
-  DocumentNode* saved[1000];
-  BZERO(saved, 1000);
-  lookUp(saved, queryList, testIndex);
+  DocumentNode** saved = lookUp(queryList, testIndex);
 
-  SHOULD_BE(saved[0]->document_id == docNode->document_id);
+  SHOULD_BE(saved[0]->document_id == 15);
   SHOULD_BE(saved[0]->page_word_frequency == 3);
   
-  cleanUpList(saved);
+  cleanUpDocumentList(saved);
   cleanUpQueryList(queryList);
-  BZERO(saved, 1000);
 
   cleanUpIndex(testIndex);
 
@@ -597,27 +859,18 @@ int TestLookUp4() {
   START_TEST_CASE;
   INVERTED_INDEX* testIndex = NULL;
 
-  int wordHash;
-  int wordHash2;
   testIndex = initStructure(testIndex);
 
-  wordHash = hash1("dog") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode = NULL;
-  docNode = newDocNode(docNode, 15, 1);
-
   WordNode* wordNode = NULL;
-  wordNode = newWordNode(wordNode, docNode, "dog");
-  testIndex->hash[wordHash] = wordNode;
+  wordNode = newWordNode(wordNode, "dog", testIndex);
+  addWordNode(testIndex, wordNode);
+  addPosting(wordNode, 15, 1, testIndex);
 
 
-  wordHash2 = hash1("cat") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode2 = NULL;
-  docNode2 = newDocNode(docNode2, 15, 2);
-
   WordNode* wordNode2 = NULL;
-  wordNode2 = newWordNode(wordNode2, docNode2, "cat");
-
-  testIndex->hash[wordHash2] = wordNode2;
+  wordNode2 = newWordNode(wordNode2, "cat", testIndex);
+  addWordNode(testIndex, wordNode2);
+  addPosting(wordNode2, 15, 2, testIndex);
 
   char query[1000] = "AND OR dog cat AND OR AND";
   sanitize(query);
@@ -630,16 +883,13 @@ int TestLookUp4() {
 
   curateWords(queryList, query);
 
-  DocumentNode* saved[1000];
-  BZERO(saved, 1000);
-  lookUp(saved, queryList, testIndex);
+  DocumentNode** saved = lookUp(queryList, testIndex);
 
-  SHOULD_BE(saved[0]->document_id == docNode->document_id);
+  SHOULD_BE(saved[0]->document_id == 15);
   SHOULD_BE(saved[0]->page_word_frequency == 3);
   
-  cleanUpList(saved);
+  cleanUpDocumentList(saved);
   cleanUpQueryList(queryList);
-  BZERO(saved, 1000);
 
   cleanUpIndex(testIndex);
 
@@ -653,47 +903,28 @@ int TestLookUp5() {
   START_TEST_CASE;
   INVERTED_INDEX* testIndex = NULL;
 
-  int wordHash;
-  int wordHash2;
-  int wordHash3;
-  int wordHash4;
   testIndex = initStructure(testIndex);
 
-  wordHash = hash1("dog") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode = NULL;
-  docNode = newDocNode(docNode, 15, 1);
-
   WordNode* wordNode = NULL;
-  wordNode = newWordNode(wordNode, docNode, "dog");
-  testIndex->hash[wordHash] = wordNode;
-
+  wordNode = newWordNode(wordNode, "dog", testIndex);
+  addWordNode(testIndex, wordNode);
+  addPosting(wordNode, 15, 1, testIndex);
 
-  wordHash2 = hash1("cat") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode2 = NULL;
-  docNode2 = newDocNode(docNode2, 15, 2);
 
   WordNode* wordNode2 = NULL;
-  wordNode2 = newWordNode(wordNode2, docNode2, "cat");
-
-  testIndex->hash[wordHash2] = wordNode2;
-
-  wordHash3 = hash1("mouse") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode3 = NULL;
-  docNode3 = newDocNode(docNode3, 23, 2);
+  wordNode2 = newWordNode(wordNode2, "cat", testIndex);
+  addWordNode(testIndex, wordNode2);
+  addPosting(wordNode2, 15, 2, testIndex);
 
   WordNode* wordNode3 = NULL;
-  wordNode3 = newWordNode(wordNode3, docNode3, "mouse");
-
-  testIndex->hash[wordHash3] = wordNode3;
-
-  wordHash4 = hash1("lion") % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode4 = NULL;
-  docNode4 = newDocNode(docNode4, 23, 2);
+  wordNode3 = newWordNode(wordNode3, "mouse", testIndex);
+  addWordNode(testIndex, wordNode3);
+  addPosting(wordNode3, 23, 2, testIndex);
 
   WordNode* wordNode4 = NULL;
-  wordNode4 = newWordNode(wordNode4, docNode4, "lion");
-
-  testIndex->hash[wordHash4] = wordNode4;
+  wordNode4 = newWordNode(wordNode4, "lion", testIndex);
+  addWordNode(testIndex, wordNode4);
+  addPosting(wordNode4, 23, 2, testIndex);
 
   char query[1000] = "dog cat OR mouse lion";
   sanitize(query);
@@ -706,20 +937,1412 @@ int TestLookUp5() {
 
   curateWords(queryList, query);
 
-  DocumentNode* saved[1000];
-  BZERO(saved, 1000);
-  lookUp(saved, queryList, testIndex);
+  DocumentNode** saved = lookUp(queryList, testIndex);
 
-  SHOULD_BE(saved[0]->document_id == docNode->document_id);
+  SHOULD_BE(saved[0]->document_id == 15);
   SHOULD_BE(saved[0]->page_word_frequency == 3);
-  SHOULD_BE(saved[1]->document_id == docNode3->document_id);
+  SHOULD_BE(saved[1]->document_id == 23);
   SHOULD_BE(saved[1]->page_word_frequency == 4);
   
-  cleanUpList(saved);
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
+
+  cleanUpIndex(testIndex);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestLookUp:6
+// This test calls lookUp() for the condition where the keywords are in
+// thousands of documents with ids far past 10000. The results should
+// all be there, in document order, with a document in both sides of
+// an OR only once
+int TestLookUp6() {
+  START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+
+  testIndex = initStructure(testIndex);
+
+  // "wide" is in 5, 10, ... 15000 and "deep" in 3, 6, ... 60000
+  WordNode* wide = NULL;
+  wide = newWordNode(wide, "wide", testIndex);
+  addWordNode(testIndex, wide);
+  for (int k = 1; k <= 3000; k++){
+    addPosting(wide, 5 * k, 1, testIndex);
+  }
+
+  WordNode* deep = NULL;
+  deep = newWordNode(deep, "deep", testIndex);
+  addWordNode(testIndex, deep);
+  for (int k = 1; k <= 20000; k++){
+    addPosting(deep, 3 * k, 2, testIndex);
+  }
+
+  WordNode* tail = NULL;
+  tail = newWordNode(tail, "tail", testIndex);
+  addWordNode(testIndex, tail);
+  addPosting(tail, 1000000, 3, testIndex);
+
+  // the multiples of 15 up to 15000
+  char query[1000] = "wide deep";
+  char* queryList[1000];
+  BZERO(queryList, 1000);
+  curateWords(queryList, query);
+
+  DocumentNode** saved = lookUp(queryList, testIndex);
+
+  int num = 0;
+  int right = 0;
+  while (saved[num] != NULL){
+    if (saved[num]->document_id == 15 * (num + 1) && saved[num]->page_word_frequency == 3){
+      right++;
+    }
+    num++;
+  }
+  SHOULD_BE(num == 1000);
+  SHOULD_BE(right == 1000);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
+
+  // 3000 + 20000 documents, 1000 of them in both (3, 5, 6, 9, 10, 12, 15, ...)
+  char query2[1000] = "wide OR deep";
+  BZERO(queryList, 1000);
+  curateWords(queryList, query2);
+
+  saved = lookUp(queryList, testIndex);
+
+  num = 0;
+  int ordered = 1;
+  while (saved[num] != NULL){
+    if (num > 0 && saved[num]->document_id <= saved[num - 1]->document_id){
+      ordered = 0;
+    }
+    num++;
+  }
+  SHOULD_BE(num == 22000);
+  SHOULD_BE(ordered);
+  SHOULD_BE(saved[6]->document_id == 15 && saved[6]->page_word_frequency == 3);
+  SHOULD_BE(saved[num - 1]->document_id == 60000);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
+
+  // a document far past the others ORed with the AND of both
+  char query3[1000] = "tail OR wide deep";
+  BZERO(queryList, 1000);
+  curateWords(queryList, query3);
+
+  saved = lookUp(queryList, testIndex);
+
+  SHOULD_BE(saved[999] != NULL && saved[999]->document_id == 15000);
+  SHOULD_BE(saved[1000] != NULL && saved[1000]->document_id == 1000000);
+  SHOULD_BE(saved[1000] != NULL && saved[1000]->page_word_frequency == 3);
+  SHOULD_BE(saved[1001] == NULL);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
+
+  cleanUpIndex(testIndex);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestIndexFile:1
+// This test saves a small index in the binary format, maps it and
+// calls lookUp() on the mapped file with an AND and an OR query
+int TestIndexFile1() {
+  START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+  INVERTED_INDEX* fileIndex = NULL;
+  testIndex = initStructure(testIndex);
+
+  reconstructIndex("dog", 15, 1, testIndex);
+  reconstructIndex("dog", 23, 4, testIndex);
+  reconstructIndex("cat", 15, 2, testIndex);
+  reconstructIndex("mouse", 7, 5, testIndex);
+
+  saveIndexToFile(testIndex, "index_test.bin", INDEX_FORMAT_BINARY);
+  cleanUpIndex(testIndex);
+  SHOULD_BE(isIndexFile("index_test.bin") == 1);
+
+  fileIndex = initStructure(fileIndex);
+  fileIndex->file = openIndexFile("index_test.bin");
+  SHOULD_BE(fileIndex->file != NULL);
+  SHOULD_BE(fileIndex->file->header->numWords == 3);
+  SHOULD_BE(findIndexFileTerm(fileIndex->file, "horse") == NULL);
+
+  char query[1000] = "dog cat";
+  char* queryList[1000];
+  BZERO(queryList, 1000);
+  curateWords(queryList, query);
+
+  DocumentNode** saved = lookUp(queryList, fileIndex);
+
+  SHOULD_BE(saved[0] != NULL && saved[0]->document_id == 15);
+  SHOULD_BE(saved[0] != NULL && saved[0]->page_word_frequency == 3);
+  SHOULD_BE(saved[1] == NULL);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
+
+  char query2[1000] = "mouse OR dog";
+  char* queryList2[1000];
+  BZERO(queryList2, 1000);
+  curateWords(queryList2, query2);
+  saved = lookUp(queryList2, fileIndex);
+
+  SHOULD_BE(saved[0] != NULL && saved[0]->document_id == 7);
+  SHOULD_BE(saved[1] != NULL && saved[1]->document_id == 15);
+  SHOULD_BE(saved[2] != NULL && saved[2]->document_id == 23);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList2);
+
+  cleanUpIndex(fileIndex);
+  remove("index_test.bin");
+
+  END_TEST_CASE;
+}
+
+// ids of the bitmaps of TestDocBitmap1: a run, an array of two ids
+// and every other id of the third chunk
+static int inFirstBitmap(int id){
+  return id < 5000 || id == 70000 || id == 70002
+    || (id >= 2 * DOC_BITMAP_CHUNK_SIZE && id < 3 * DOC_BITMAP_CHUNK_SIZE && id % 2 == 0);
+}
+
+// multiples of 3
+static int inSecondBitmap(int id){
+  return id % 3 == 0 && id < 200000;
+}
+
+// Reads the ids of bitmap and checks that they are increasing and are
+// the ids in the set that inSet() gives. Returns how many were right
+static int checkDocBitmapIds(const DOC_BITMAP* bitmap, int (*inSet)(int)){
+  DOC_BITMAP_ITERATOR iterator;
+  int ids[100];
+  int numIds;
+  int numRight = 0;
+  int last = -1;
+
+  startDocBitmapIds(&iterator);
+  while ((numIds = readDocBitmapIds(bitmap, &iterator, ids, 100)) > 0){
+    for (int k = 0; k < numIds; k++){
+      if (ids[k] > last && inSet(ids[k])){
+        numRight++;
+      }
+      last = ids[k];
+    }
+  }
+
+  return numRight;
+}
+
+static int inBothBitmaps(int id){
+  return inFirstBitmap(id) && inSecondBitmap(id);
+}
+
+static int inEitherBitmap(int id){
+  return inFirstBitmap(id) || inSecondBitmap(id);
+}
+
+static int inFirstBitmapOnly(int id){
+  return inFirstBitmap(id) && !inSecondBitmap(id);
+}
+
+// Test case: TestDocBitmap:1
+// This test builds bitmaps with run, array and bitmap containers,
+// combines them and checks every id read back against the sets. It
+// then saves an index with a dense word, checks that it is stored as a
+// bitmap and calls lookUp() ANDing it with itself and other words
+int TestDocBitmap1() {
+  START_TEST_CASE;
+  DOC_BITMAP_BUILDER* builder = newDocBitmapBuilder();
+  int sizes[4] = { 0, 0, 0, 0 };
+
+  for (int id = 0; id < 3 * DOC_BITMAP_CHUNK_SIZE; id++){
+    if (inFirstBitmap(id)){
+      addToDocBitmap(builder, id);
+    }
+  }
+  DOC_BITMAP* first = finishDocBitmap(builder);
+
+  builder = newDocBitmapBuilder();
+  for (int id = 0; id < 200000; id += 3){
+    addToDocBitmap(builder, id);
+  }
+  DOC_BITMAP* second = finishDocBitmap(builder);
+
+  // each chunk is kept in the smallest container
+  SHOULD_BE(first->header->numContainers == 3);
+  SHOULD_BE(first->containers[0].type == DOC_BITMAP_RUN);
+  SHOULD_BE(first->containers[1].type == DOC_BITMAP_ARRAY);
+  SHOULD_BE(first->containers[2].type == DOC_BITMAP_BITMAP);
+  SHOULD_BE(docBitmapCardinality(first) == 5000 + 2 + DOC_BITMAP_CHUNK_SIZE / 2);
+
+  SHOULD_BE(docBitmapRank(first, 0) == 0);
+  SHOULD_BE(docBitmapRank(first, 4999) == 4999);
+  SHOULD_BE(docBitmapRank(first, 5000) == -1);
+  SHOULD_BE(docBitmapRank(first, 70002) == 5001);
+  SHOULD_BE(docBitmapRank(first, 2 * DOC_BITMAP_CHUNK_SIZE + 2) == 5003);
+  SHOULD_BE(docBitmapRank(first, 2 * DOC_BITMAP_CHUNK_SIZE + 3) == -1);
+  SHOULD_BE(docBitmapRank(first, 5 * DOC_BITMAP_CHUNK_SIZE) == -1);
+
+  DOC_BITMAP* both = docBitmapAnd(first, second);
+  DOC_BITMAP* either = docBitmapOr(first, second);
+  DOC_BITMAP* firstOnly = docBitmapAndNot(first, second);
+
+  for (int id = 0; id < 200000; id++){
+    sizes[0] += inFirstBitmap(id);
+    sizes[1] += inBothBitmaps(id);
+    sizes[2] += inEitherBitmap(id);
+    sizes[3] += inFirstBitmapOnly(id);
+  }
+
+  SHOULD_BE(checkDocBitmapIds(first, inFirstBitmap) == sizes[0]);
+  SHOULD_BE(docBitmapCardinality(both) == sizes[1]);
+  SHOULD_BE(checkDocBitmapIds(both, inBothBitmaps) == sizes[1]);
+  SHOULD_BE(docBitmapCardinality(either) == sizes[2]);
+  SHOULD_BE(checkDocBitmapIds(either, inEitherBitmap) == sizes[2]);
+  SHOULD_BE(docBitmapCardinality(firstOnly) == sizes[3]);
+  SHOULD_BE(checkDocBitmapIds(firstOnly, inFirstBitmapOnly) == sizes[3]);
+
+  // a stored bitmap is used in place, but only at a multiple of 8
+  DOC_BITMAP opened;
+  unsigned char* bytes = (unsigned char*) malloc(first->length + 8);
+  MALLOC_CHECK(bytes);
+  memcpy(bytes, first->data, first->length);
+  SHOULD_BE(openDocBitmap(&opened, bytes, first->length) == 1);
+  SHOULD_BE(docBitmapRank(&opened, 70002) == 5001);
+  SHOULD_BE(checkDocBitmapIds(&opened, inFirstBitmap) == sizes[0]);
+  SHOULD_BE(openDocBitmap(&opened, bytes, first->length - 1) == 0);
+  memmove(bytes + 4, bytes, first->length);
+  SHOULD_BE(openDocBitmap(&opened, bytes + 4, first->length) == 0);
+  free(bytes);
+
+  freeDocBitmap(first);
+  freeDocBitmap(second);
+  freeDocBitmap(both);
+  freeDocBitmap(either);
+  freeDocBitmap(firstOnly);
+
+  // "the" is in documents 1 to 100, so it is kept as a bitmap
+  INVERTED_INDEX* testIndex = NULL;
+  INVERTED_INDEX* fileIndex = NULL;
+  testIndex = initStructure(testIndex);
+
+  for (int id = 1; id <= 100; id++){
+    reconstructIndex("the", id, id % 3 + 1, testIndex);
+    reconstructIndex("and", id, 2, testIndex);
+  }
+  reconstructIndex("dog", 10, 1, testIndex);
+  reconstructIndex("dog", 50, 4, testIndex);
+  reconstructIndex("dog", 150, 1, testIndex);
+
+  saveIndexToFile(testIndex, "index_test.bin", INDEX_FORMAT_BINARY);
+  cleanUpIndex(testIndex);
+
+  fileIndex = initStructure(fileIndex);
+  fileIndex->file = openIndexFile("index_test.bin");
+  SHOULD_BE(fileIndex->file != NULL);
+
+  const INDEX_FILE_TERM* term = findIndexFileTerm(fileIndex->file, "the");
+  SHOULD_BE(term != NULL && term->postingsFormat == INDEX_FILE_POSTINGS_BITMAP);
+  DOC_ITERATOR* the = keywordIterator("the", fileIndex);
+  DOC_ITERATOR* dog = keywordIterator("dog", fileIndex);
+  SHOULD_BE(isDenseIterator(the));
+  SHOULD_BE(!isDenseIterator(dog));
+  freeDocIterator(the);
+  freeDocIterator(dog);
+
+  // a cursor reads the bitmap like any postings
+  POSTINGS_CURSOR cursor;
+  int numRight = 0;
+  startIndexFilePostings(&cursor, fileIndex->file, term);
+  for (int id = 1; nextPosting(&cursor); id++){
+    if (cursor.documentId == id && cursor.frequency == id % 3 + 1){
+      numRight++;
+    }
+  }
+  SHOULD_BE(numRight == 100);
+
+  DocumentNode** saved = NULL;
+  char* queryList[1000];
+
+  // two dense words, then a sparse one
+  char query[1000] = "the and dog";
+  BZERO(queryList, 1000);
+  curateWords(queryList, query);
+  saved = lookUp(queryList, fileIndex);
+
+  SHOULD_BE(saved[0] != NULL && saved[0]->document_id == 10);
+  SHOULD_BE(saved[0] != NULL && saved[0]->page_word_frequency == 2 + 2 + 1);
+  SHOULD_BE(saved[1] != NULL && saved[1]->document_id == 50);
+  SHOULD_BE(saved[1] != NULL && saved[1]->page_word_frequency == 3 + 2 + 4);
+  SHOULD_BE(saved[2] == NULL);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
+
+  // a sparse word, then a dense one, ORed with a dense one: documents
+  // 10 and 50 are in both and are kept once
+  char query2[1000] = "dog the OR and";
+  BZERO(queryList, 1000);
+  curateWords(queryList, query2);
+  saved = lookUp(queryList, fileIndex);
+
+  SHOULD_BE(saved[0] != NULL && saved[0]->document_id == 1);
+  SHOULD_BE(saved[0] != NULL && saved[0]->page_word_frequency == 2);
+  SHOULD_BE(saved[9] != NULL && saved[9]->document_id == 10);
+  SHOULD_BE(saved[9] != NULL && saved[9]->page_word_frequency == 1 + 2 + 2);
+  SHOULD_BE(saved[49] != NULL && saved[49]->document_id == 50);
+  SHOULD_BE(saved[49] != NULL && saved[49]->page_word_frequency == 4 + 3 + 2);
+  SHOULD_BE(saved[99] != NULL && saved[99]->document_id == 100);
+  SHOULD_BE(saved[100] == NULL);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
+
+  cleanUpIndex(fileIndex);
+  remove("index_test.bin");
+
+  END_TEST_CASE;
+}
+
+// Test case: TestDocIterator:1
+// This test skips iterators over postings and over a document bitmap
+// ahead across blocks, ANDs them, and calls lookUp() with AND and OR
+// and with a resultLimit, which should keep only the best results
+int TestDocIterator1() {
+  START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+  testIndex = initStructure(testIndex);
+
+  // "wide" is in documents 1 to 1000, "deep" in every 7th, "tail" in two
+  for (int id = 1; id <= 1000; id++){
+    reconstructIndex("wide", id, 1, testIndex);
+    if (id % 7 == 0){
+      reconstructIndex("deep", id, 2, testIndex);
+    }
+  }
+  reconstructIndex("tail", 500, 1, testIndex);
+  reconstructIndex("tail", 999, 1, testIndex);
+
+  DOC_ITERATOR* wide = keywordIterator("wide", testIndex);
+  SHOULD_BE(advanceDocIterator(wide, 300) == 300);
+  SHOULD_BE(docIteratorFrequency(wide) == 1);
+  SHOULD_BE(advanceDocIterator(wide, 300) == 300);
+  SHOULD_BE(nextDocIterator(wide) == 301);
+  SHOULD_BE(advanceDocIterator(wide, 1001) == DOC_ITERATOR_END);
+  SHOULD_BE(nextDocIterator(wide) == DOC_ITERATOR_END);
+  freeDocIterator(wide);
+
+  DOC_ITERATOR* missing = keywordIterator("missing", testIndex);
+  SHOULD_BE(nextDocIterator(missing) == DOC_ITERATOR_END);
+  freeDocIterator(missing);
+
+  // the AND is led by "deep", the shorter one
+  DOC_ITERATOR* words[2];
+  words[0] = keywordIterator("wide", testIndex);
+  words[1] = keywordIterator("deep", testIndex);
+  DOC_ITERATOR* both = newAndIterator(words, 2);
+  SHOULD_BE(both->cost == 142);
+  SHOULD_BE(nextDocIterator(both) == 7);
+  SHOULD_BE(docIteratorFrequency(both) == 3);
+  SHOULD_BE(advanceDocIterator(both, 500) == 504);
+
+  int numMatches = 1;
+  while (nextDocIterator(both) != DOC_ITERATOR_END){
+    numMatches++;
+  }
+  SHOULD_BE(numMatches == 142 - 504 / 7 + 1);
+  freeDocIterator(both);
+
+  DocumentNode** saved = NULL;
+  char* queryList[1000];
+
+  // only the words that matched add to the frequency
+  char query[1000] = "wide deep OR tail";
+  BZERO(queryList, 1000);
+  curateWords(queryList, query);
+  saved = lookUp(queryList, testIndex);
+
+  int num = 0;
+  int inOrder = 1;
+  while (saved[num] != NULL){
+    if (num > 0 && saved[num - 1]->document_id >= saved[num]->document_id){
+      inOrder = 0;
+    }
+    if (saved[num]->document_id == 500){
+      SHOULD_BE(saved[num]->page_word_frequency == 1);
+    }
+    if (saved[num]->document_id == 504){
+      SHOULD_BE(saved[num]->page_word_frequency == 3);
+    }
+    num++;
+  }
+  SHOULD_BE(num == 142 + 2);
+  SHOULD_BE(inOrder);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
+
+  // the best 3 by frequency (ties by document id) are in both words
+  char query2[1000] = "wide OR deep";
+  BZERO(queryList, 1000);
+  curateWords(queryList, query2);
+  resultLimit = 3;
+  saved = lookUp(queryList, testIndex);
+  resultLimit = 0;
+
+  num = 0;
+  int best = 0;
+  while (saved[num] != NULL){
+    if (saved[num]->page_word_frequency == 3 && saved[num]->document_id <= 21){
+      best++;
+    }
+    num++;
+  }
+  SHOULD_BE(num == 3);
+  SHOULD_BE(best == 3);
+
+  cleanUpDocumentList(saved);
   cleanUpQueryList(queryList);
-  BZERO(saved, 1000);
+  cleanUpIndex(testIndex);
+
+  // "the" and "and" are in documents 1 to 300, so they are kept as bitmaps
+  INVERTED_INDEX* fileIndex = NULL;
+  testIndex = NULL;
+  testIndex = initStructure(testIndex);
+
+  for (int id = 1; id <= 300; id++){
+    reconstructIndex("the", id, id % 3 + 1, testIndex);
+    reconstructIndex("and", id, 2, testIndex);
+  }
+  reconstructIndex("dog", 10, 1, testIndex);
+  reconstructIndex("dog", 150, 4, testIndex);
+  reconstructIndex("dog", 290, 1, testIndex);
+
+  saveIndexToFile(testIndex, "index_test.bin", INDEX_FORMAT_BINARY);
+  cleanUpIndex(testIndex);
+
+  fileIndex = initStructure(fileIndex);
+  fileIndex->file = openIndexFile("index_test.bin");
+  SHOULD_BE(fileIndex->file != NULL);
+
+  // a dense word seeks in its bitmap and finds its frequency by rank
+  DOC_ITERATOR* the = keywordIterator("the", fileIndex);
+  SHOULD_BE(isDenseIterator(the));
+  SHOULD_BE(advanceDocIterator(the, 200) == 200);
+  SHOULD_BE(docIteratorFrequency(the) == 200 % 3 + 1);
+  SHOULD_BE(nextDocIterator(the) == 201);
+  SHOULD_BE(docIteratorFrequency(the) == 201 % 3 + 1);
+  freeDocIterator(the);
+
+  words[0] = keywordIterator("the", fileIndex);
+  words[1] = keywordIterator("and", fileIndex);
+  DOC_ITERATOR* dense = newBitmapIterator(words, 2);
+  SHOULD_BE(dense->cost == 300);
+  SHOULD_BE(advanceDocIterator(dense, 130) == 130);
+  SHOULD_BE(docIteratorFrequency(dense) == 130 % 3 + 1 + 2);
+  SHOULD_BE(advanceDocIterator(dense, 250) == 250);
+  SHOULD_BE(docIteratorFrequency(dense) == 250 % 3 + 1 + 2);
+  SHOULD_BE(advanceDocIterator(dense, 301) == DOC_ITERATOR_END);
+  freeDocIterator(dense);
+
+  char query3[1000] = "the dog and";
+  BZERO(queryList, 1000);
+  curateWords(queryList, query3);
+  saved = lookUp(queryList, fileIndex);
+
+  SHOULD_BE(saved[0] != NULL && saved[0]->document_id == 10);
+  SHOULD_BE(saved[0] != NULL && saved[0]->page_word_frequency == 2 + 1 + 2);
+  SHOULD_BE(saved[1] != NULL && saved[1]->document_id == 150);
+  SHOULD_BE(saved[1] != NULL && saved[1]->page_word_frequency == 1 + 4 + 2);
+  SHOULD_BE(saved[2] != NULL && saved[2]->document_id == 290);
+  SHOULD_BE(saved[2] != NULL && saved[2]->page_word_frequency == 3 + 1 + 2);
+  SHOULD_BE(saved[2] != NULL && saved[3] == NULL);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
+
+  cleanUpIndex(fileIndex);
+  remove("index_test.bin");
+
+  END_TEST_CASE;
+}
+
+// Test case: TestLazyOpen:1
+// This test saves a small text index, opens it lazily and checks that
+// only the words that were looked up get decoded into the index
+int TestLazyOpen1() {
+  START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+  INVERTED_INDEX* lazyIndex = NULL;
+  testIndex = initStructure(testIndex);
+
+  reconstructIndex("dog", 15, 1, testIndex);
+  reconstructIndex("dog", 23, 4, testIndex);
+  reconstructIndex("cat", 15, 2, testIndex);
+
+  saveIndexToFile(testIndex, "index_test.dat", INDEX_FORMAT_TEXT);
+  cleanUpIndex(testIndex);
+
+  lazyIndex = initStructure(lazyIndex);
+  SHOULD_BE(openIndexLazily("index_test.dat", lazyIndex) != NULL);
+  SHOULD_BE(lazyIndex->lexicon != NULL && lazyIndex->lexicon->numWords == 2);
+
+  // nothing is decoded until it is looked up
+  SHOULD_BE(findWordNode(lazyIndex, "dog") == NULL);
+
+  WordNode* dog = lookUpWordNode(lazyIndex, "dog");
+  SHOULD_BE(dog != NULL);
+  SHOULD_BE(dog != NULL && dog->numPages == 2);
+  SHOULD_BE(dog != NULL && dog->lastDocumentId == 23);
+  SHOULD_BE(dog != NULL && dog->lastFrequency == 4);
+  SHOULD_BE(lookUpWordNode(lazyIndex, "dog") == dog);
+  SHOULD_BE(findWordNode(lazyIndex, "cat") == NULL);
+
+  SHOULD_BE(lookUpWordNode(lazyIndex, "horse") == NULL);
+  SHOULD_BE(lookUpWordNode(lazyIndex, "ca") == NULL);
+
+  cleanUpIndex(lazyIndex);
+  remove("index_test.dat");
+
+  END_TEST_CASE;
+}
+
+// Test case: TestWordTable:1
+// This test adds enough words to make the word table grow several
+// times and checks that every word can still be found
+int TestWordTable1() {
+  START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+  char word[WORD_LENGTH];
+  int numWords = 20 * INDEX_INITIAL_SLOTS;
+
+  testIndex = initStructure(testIndex);
+
+  for (int i = 0; i < numWords; i++){
+    WordNode* wordNode = NULL;
+    sprintf(word, "word%d", i);
+    wordNode = newWordNode(wordNode, word, testIndex);
+    addWordNode(testIndex, wordNode);
+    addPosting(wordNode, i + 1, 1, testIndex);
+  }
+
+  SHOULD_BE(testIndex->numWords == numWords);
+  SHOULD_BE(testIndex->numSlots >= numWords);
+  SHOULD_BE((long) testIndex->numWords * 100 <= (long) testIndex->numSlots * INDEX_MAX_LOAD_PERCENT);
+
+  int found = 0;
+  for (int i = 0; i < numWords; i++){
+    sprintf(word, "word%d", i);
+    WordNode* wordNode = findWordNode(testIndex, word);
+    if (wordNode != NULL && wordNode->lastDocumentId == i + 1){
+      found++;
+    }
+  }
+  SHOULD_BE(found == numWords);
+  SHOULD_BE(findWordNode(testIndex, "word") == NULL);
+
+  cleanUpIndex(testIndex);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestArena:1
+// This test checks that strings are packed back to back, that
+// allocations are aligned and that oversized requests still succeed
+int TestArena1() {
+  START_TEST_CASE;
+  ARENA* arena = newArena(64);
+
+  char* dog = arenaCopyString(arena, "dog", 3);
+  char* cat = arenaCopyString(arena, "cats", 3);
+  SHOULD_BE(strcmp(dog, "dog") == 0);
+  SHOULD_BE(strcmp(cat, "cat") == 0);
+  SHOULD_BE(cat == dog + 4);
+
+  char* odd = arenaCopyString(arena, "x", 1);
+  long* aligned = (long*) arenaAlloc(arena, sizeof(long));
+  SHOULD_BE(((size_t) aligned) % 8 == 0);
+  SHOULD_BE((char*) aligned > odd);
+
+  char* big = (char*) arenaAlloc(arena, 1000);
+  BZERO(big, 1000);
+  char* after = arenaCopyString(arena, "mouse", 5);
+  SHOULD_BE(strcmp(after, "mouse") == 0);
+  SHOULD_BE(arena->bytesUsed == 4 + 4 + 2 + sizeof(long) + 1000 + 6);
+
+  freeArena(arena);
+  END_TEST_CASE;
+}
 
+// Test case: TestPostings:1
+// This test adds postings to a word in order, out of order and
+// repeatedly and checks that they stay sorted by document id
+int TestPostings1() {
+  START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+  WordNode* wordNode = NULL;
+  int numPages = 1000;
+
+  testIndex = initStructure(testIndex);
+
+  wordNode = newWordNode(wordNode, "dog", testIndex);
+  addWordNode(testIndex, wordNode);
+
+  // even documents in order, then the odd ones backwards
+  for (int i = 2; i <= numPages; i += 2){
+    addPosting(wordNode, i, 2, testIndex);
+  }
+  for (int i = numPages - 1; i >= 1; i -= 2){
+    addPosting(wordNode, i, 1, testIndex);
+  }
+
+  // the same documents again only add up the occurrences
+  addPosting(wordNode, numPages, 3, testIndex);
+  addPosting(wordNode, 1, 3, testIndex);
+
+  SHOULD_BE(wordNode->numPages == numPages);
+  SHOULD_BE(wordNode->lastDocumentId == numPages);
+  SHOULD_BE(wordNode->lastFrequency == 5);
+
+  // every gap is 1 and every frequency below 128: a block takes a byte
+  // per number and a control byte per 4 after a header of 2 two byte
+  // varints (its span of 128 ids and its length), the tail 2 bytes a
+  // posting
+  int blocks = (numPages - 1) / POSTINGS_BLOCK_SIZE;
+  SHOULD_BE(wordNode->postingsLength
+    == blocks * (4 + POSTINGS_BLOCK_SIZE / 2 + 2 * POSTINGS_BLOCK_SIZE)
+    + 2 * (numPages - blocks * POSTINGS_BLOCK_SIZE));
+
+  POSTINGS_CURSOR cursor;
+  int sorted = 1;
+  int frequencies[3];
+  startWordPostings(&cursor, wordNode);
+  for (int i = 0; nextPosting(&cursor); i++){
+    if (cursor.documentId != i + 1){
+      sorted = 0;
+    }
+    if (i < 3){
+      frequencies[i] = cursor.frequency;
+    }
+  }
+  SHOULD_BE(sorted);
+  SHOULD_BE(frequencies[0] == 4);
+  SHOULD_BE(frequencies[1] == 2);
+  SHOULD_BE(frequencies[2] == 1);
+
+  // 700 is in the 6th block: the first 5 are jumped over by their
+  // headers, and the 6th is decoded and galloped through
+  startWordPostings(&cursor, wordNode);
+  SHOULD_BE(advancePosting(&cursor, 700) == 1);
+  SHOULD_BE(cursor.documentId == 700 && cursor.frequency == 2);
+  SHOULD_BE(cursor.blocks == blocks - 6);
+  SHOULD_BE(cursor.buffered == 6 * POSTINGS_BLOCK_SIZE - 700);
+  SHOULD_BE(advancePosting(&cursor, 750) == 1 && cursor.documentId == 750);
+  SHOULD_BE(nextPosting(&cursor) == 1 && cursor.documentId == 751);
+  SHOULD_BE(advancePosting(&cursor, 999) == 1 && cursor.documentId == 999);
+  SHOULD_BE(advancePosting(&cursor, numPages + 1) == 0);
+
+  cleanUpIndex(testIndex);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestVarint:1
+// This test encodes numbers around the varint byte boundaries and
+// checks that a frequency can outgrow its byte in place
+int TestVarint1() {
+  START_TEST_CASE;
+  unsigned char buffer[POSTINGS_MAX_VARINT_BYTES];
+  uint32_t values[6] = { 0, 127, 128, 16383, 16384, 4294967295u };
+  int lengths[6] = { 1, 1, 2, 2, 3, 5 };
+  uint32_t decoded;
+
+  for (int i = 0; i < 6; i++){
+    int length = encodeVarint(buffer, values[i]);
+    SHOULD_BE(length == lengths[i]);
+    SHOULD_BE(decodeVarint(buffer, &decoded) == buffer + length);
+    SHOULD_BE(decoded == values[i]);
+  }
+
+  INVERTED_INDEX* testIndex = NULL;
+  WordNode* wordNode = NULL;
+  POSTINGS_CURSOR cursor;
+
+  testIndex = initStructure(testIndex);
+  wordNode = newWordNode(wordNode, "dog", testIndex);
+  addWordNode(testIndex, wordNode);
+
+  addPosting(wordNode, 300, 127, testIndex);
+  SHOULD_BE(wordNode->postingsLength == 3);
+  addPosting(wordNode, 300, 1, testIndex);
+  SHOULD_BE(wordNode->postingsLength == 4);
+  addPosting(wordNode, 301, 1, testIndex);
+  SHOULD_BE(wordNode->postingsLength == 6);
+
+  startWordPostings(&cursor, wordNode);
+  SHOULD_BE(nextPosting(&cursor) && cursor.documentId == 300 && cursor.frequency == 128);
+  SHOULD_BE(nextPosting(&cursor) && cursor.documentId == 301 && cursor.frequency == 1);
+  SHOULD_BE(!nextPosting(&cursor));
+
+  cleanUpIndex(testIndex);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestBlockDecode:1
+// This test encodes a block of numbers of every byte length and checks
+// that the scalar and the SSSE3 decoders both get them back
+int TestBlockDecode1() {
+  START_TEST_CASE;
+  uint32_t gaps[POSTINGS_BLOCK_SIZE];
+  uint32_t frequencies[POSTINGS_BLOCK_SIZE];
+  int documentIds[POSTINGS_BLOCK_SIZE];
+  int decodedFrequencies[POSTINGS_BLOCK_SIZE];
+  unsigned char block[POSTINGS_MAX_BLOCK_BYTES];
+  int decoders[2] = { POSTINGS_DECODER_SCALAR, POSTINGS_DECODER_SSSE3 };
+
+  uint32_t sizes[4] = { 1, 300, 70000, 20000000 };
+  for (int i = 0; i < POSTINGS_BLOCK_SIZE; i++){
+    gaps[i] = sizes[(i * 7) % 4] + i;
+    frequencies[i] = sizes[(i * 3) % 4] + 1;
+  }
+
+  int length = encodePostingsBlock(block, gaps, frequencies);
+  SHOULD_BE(length > POSTINGS_BLOCK_SIZE / 2 + 2 * POSTINGS_BLOCK_SIZE);
+  SHOULD_BE(length <= POSTINGS_MAX_BLOCK_BYTES);
+
+  for (int d = 0; d < 2; d++){
+    selectPostingsDecoder(decoders[d]);
+    BZERO(documentIds, sizeof(documentIds));
+    BZERO(decodedFrequencies, sizeof(decodedFrequencies));
+
+    const unsigned char* end = decodePostingsBlock(block, 5, documentIds, decodedFrequencies);
+    SHOULD_BE(end == block + length);
+
+    int matches = 0;
+    uint32_t documentId = 5;
+    for (int i = 0; i < POSTINGS_BLOCK_SIZE; i++){
+      documentId += gaps[i];
+      if ((uint32_t) documentIds[i] == documentId
+        && (uint32_t) decodedFrequencies[i] == frequencies[i]){
+        matches++;
+      }
+    }
+    SHOULD_BE(matches == POSTINGS_BLOCK_SIZE);
+  }
+
+  // back to the fastest decoder for the other tests
+  selectPostingsDecoder(POSTINGS_DECODER_SSSE3);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestSortedWords:1
+// This test adds enough words in a scrambled order for the sort to be
+// split into parallel runs and checks that they come out in order
+int TestSortedWords1() {
+  START_TEST_CASE;
+  INVERTED_INDEX* testIndex = NULL;
+  WordNode* wordNode;
+  char word[WORD_LENGTH];
+  int numWords = INDEX_PARALLEL_SORT_MIN + 1000;
+  int sortedCount;
+
+  testIndex = initStructure(testIndex);
+
+  for (int i = 0; i < numWords; i++){
+    wordNode = NULL;
+    // 7919 is prime, so this visits every number below numWords once
+    sprintf(word, "w%d", (int) (((long) i * 7919) % numWords));
+    wordNode = newWordNode(wordNode, word, testIndex);
+    addWordNode(testIndex, wordNode);
+  }
+
+  WordNode** words = sortedWordNodes(testIndex, &sortedCount);
+  SHOULD_BE(sortedCount == numWords);
+
+  int inOrder = 1;
+  for (int i = 1; i < sortedCount; i++){
+    if (strcmp(words[i - 1]->word, words[i]->word) >= 0){
+      inOrder = 0;
+    }
+  }
+  SHOULD_BE(inOrder);
+  SHOULD_BE(strcmp(words[0]->word, "w0") == 0);
+  SHOULD_BE(strcmp(words[sortedCount - 1]->word, "w9999") == 0);
+
+  free(words);
+  cleanUpIndex(testIndex);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestSanitize:1
+// This test sanitizes a line of HTML and every byte value, repeated at
+// shifting offsets so that both the 16 character runs and the table are
+// used, and checks the result against the filtering rules
+int TestSanitize1() {
+  START_TEST_CASE;
+  char html[] = "The Quick, brown fox's <a href=\"x.html\">jumps</a> over 12 "
+    "lazy_dogs!\n\tThe end: ~{[@#$%&-/]}";
+  char allBytes[4 * 255 + 1];
+  char once[255 + 1];
+
+  sanitize(html);
+  SHOULD_BE(strcmp(html, "The Quick brown foxs <a hrefxhtml>jumps</a> over 12 "
+    "lazydogsThe end: &-/") == 0);
+
+  // every byte from 1 to 255, 4 times over
+  for (int i = 0; i < 4 * 255; i++){
+    allBytes[i] = (char) (i % 255 + 1);
+  }
+  allBytes[4 * 255] = '\0';
+  memcpy(once, allBytes, 255);
+  once[255] = '\0';
+
+  sanitize(once);
+  sanitize(allBytes);
+
+  // 14 to 32, & - / 0-9 : < > A-Z a-z
+  SHOULD_BE(strlen(once) == 87);
+  SHOULD_BE(once[0] == 14 && once[18] == ' ' && once[19] == '&');
+  SHOULD_BE(strchr(once, '.') == NULL && strchr(once, '=') == NULL);
+  SHOULD_BE(strcmp(once + 61, "abcdefghijklmnopqrstuvwxyz") == 0);
+
+  int repeated = strlen(allBytes) == 4 * 87;
+  for (int i = 0; repeated && i < 4; i++){
+    repeated = memcmp(allBytes + i * 87, once, 87) == 0;
+  }
+  SHOULD_BE(repeated);
+
+  END_TEST_CASE;
+}
+
+// Adds the words of document documentId to index: "common" in every
+// document, "half" in the even ones and a word of its own
+static void addMergeDocument(INVERTED_INDEX* index, int documentId){
+  char word[WORD_LENGTH];
+  WordNode* wordNode;
+
+  sprintf(word, "only%d", documentId);
+  char* words[3] = { "common", documentId % 2 ? NULL : "half", word };
+
+  for (int w = 0; w < 3; w++){
+    if (words[w] == NULL){
+      continue;
+    }
+
+    wordNode = findWordNode(index, words[w]);
+    if (wordNode == NULL){
+      wordNode = newWordNode(wordNode, words[w], index);
+      addWordNode(index, wordNode);
+    }
+    addPosting(wordNode, documentId, documentId % 5 + 1, index);
+  }
+}
+
+// Test case: TestMerge:1
+// This test builds the same documents once into one index and once into
+// 3 partial indexes that are merged by 2 threads, and checks that every
+// word ends up with the same postings, byte for byte
+int TestMerge1() {
+  START_TEST_CASE;
+  INVERTED_INDEX* whole = NULL;
+  INVERTED_INDEX* merged = NULL;
+  INVERTED_INDEX* partials[3];
+  int numDocuments = 1000;
+
+  whole = initStructure(whole);
+  merged = initStructure(merged);
+
+  for (int p = 0; p < 3; p++){
+    partials[p] = NULL;
+    partials[p] = initStructure(partials[p]);
+  }
+
+  // runs of consecutive documents, the middle one cutting through a block
+  for (int i = 1; i <= numDocuments; i++){
+    addMergeDocument(whole, i);
+    addMergeDocument(partials[i <= 100 ? 0 : (i <= 700 ? 1 : 2)], i);
+  }
+
+  mergeIndexes(merged, partials, 3, 2);
+
+  SHOULD_BE(merged->numWords == whole->numWords);
+  SHOULD_BE(merged->numWords == numDocuments + 2);
+
+  int same = 1;
+  for (int i = 0; i < whole->numSlots; i++){
+    WordNode* expected = whole->slots[i].wordNode;
+    if (expected == NULL){
+      continue;
+    }
+
+    WordNode* wordNode = findWordNode(merged, expected->word);
+    if (wordNode == NULL || wordNode->numPages != expected->numPages
+        || wordNode->postingsLength != expected->postingsLength
+        || memcmp(wordNode->postings, expected->postings, expected->postingsLength)){
+      same = 0;
+    }
+  }
+  SHOULD_BE(same);
+
+  // the merged index keeps growing like any other
+  addMergeDocument(merged, numDocuments + 1);
+  SHOULD_BE(findWordNode(merged, "common")->numPages == numDocuments + 1);
+
+  cleanUpIndex(whole);
+  cleanUpIndex(merged);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestDocumentReader:1
+// This test writes a few pages to a directory and reads them back with a
+// window smaller than the number of pages, checking that they come out
+// whole and in document order
+int TestDocumentReader1() {
+  START_TEST_CASE;
+  char dir[] = "docreader_test";
+  char filepath[100];
+  char expected[100];
+  int numDocuments = 7;
+  int documentId;
+
+  mkdir(dir, 0700);
+  for (int i = 1; i <= numDocuments; i++){
+    sprintf(filepath, "%s/%d", dir, i);
+    FILE* fp = fopen(filepath, "w");
+    fprintf(fp, "http://page%d.html\n%d\n<html>page %d</html>\n", i, i, i);
+    fclose(fp);
+  }
+
+  // documents 2 to 6, at most 2 of them in flight
+  DOCUMENT_READER* reader = startDocumentReader(dir, 2, 6, 2);
+
+  int inOrder = 1;
+  int numRead = 0;
+  char* html;
+  while ((html = nextDocument(reader, &documentId)) != NULL){
+    sprintf(expected, "http://page%d.html\n%d\n<html>page %d</html>\n",
+        documentId, documentId, documentId);
+
+    if (documentId != 2 + numRead || strcmp(html, expected) != 0){
+      inOrder = 0;
+    }
+    numRead++;
+    free(html);
+  }
+  SHOULD_BE(inOrder);
+  SHOULD_BE(numRead == 5);
+
+  stopDocumentReader(reader);
+
+  for (int i = 1; i <= numDocuments; i++){
+    sprintf(filepath, "%s/%d", dir, i);
+    unlink(filepath);
+  }
+  rmdir(dir);
+
+  END_TEST_CASE;
+}
+
+// returns 1 if the two files hold the same bytes
+static int sameFileContents(char* pathA, char* pathB){
+  char bufferA[4096];
+  char bufferB[4096];
+  FILE* a = fopen(pathA, "r");
+  FILE* b = fopen(pathB, "r");
+  int same = a != NULL && b != NULL;
+
+  while (same){
+    size_t lengthA = fread(bufferA, 1, sizeof(bufferA), a);
+    size_t lengthB = fread(bufferB, 1, sizeof(bufferB), b);
+
+    same = lengthA == lengthB && !memcmp(bufferA, bufferB, lengthA);
+    if (lengthA == 0){
+      break;
+    }
+  }
+
+  if (a != NULL){
+    fclose(a);
+  }
+  if (b != NULL){
+    fclose(b);
+  }
+  return same;
+}
+
+// Test case: TestIndexRun:1
+// This test spills 3 indexes of consecutive documents to runs, merges
+// the runs in both formats and checks that the files are the same as
+// those saved from one index of all the documents
+int TestIndexRun1() {
+  START_TEST_CASE;
+  INVERTED_INDEX* whole = NULL;
+  INVERTED_INDEX* run = NULL;
+  char* runFiles[3] = { "indexrun_test.run0", "indexrun_test.run1", "indexrun_test.run2" };
+  int numDocuments = 1000;
+
+  whole = initStructure(whole);
+  run = initStructure(run);
+
+  // the middle run cuts through a block of postings
+  for (int i = 1; i <= numDocuments; i++){
+    addMergeDocument(whole, i);
+    addMergeDocument(run, i);
+
+    if (i == 100 || i == 700 || i == numDocuments){
+      writeIndexRun(run, runFiles[i == 100 ? 0 : (i == 700 ? 1 : 2)]);
+      emptyIndex(run);
+    }
+  }
+  SHOULD_BE(run->numWords == 0);
+
+  saveIndexToFile(whole, "indexrun_test.expected", INDEX_FORMAT_TEXT);
+  mergeIndexRuns(runFiles, 3, "indexrun_test.merged", INDEX_FORMAT_TEXT);
+  SHOULD_BE(sameFileContents("indexrun_test.expected", "indexrun_test.merged"));
+
+  saveIndexToFile(whole, "indexrun_test.expected", INDEX_FORMAT_BINARY);
+  mergeIndexRuns(runFiles, 3, "indexrun_test.merged", INDEX_FORMAT_BINARY);
+  SHOULD_BE(sameFileContents("indexrun_test.expected", "indexrun_test.merged"));
+
+  for (int r = 0; r < 3; r++){
+    unlink(runFiles[r]);
+  }
+  unlink("indexrun_test.expected");
+  unlink("indexrun_test.merged");
+
+  cleanUpIndex(whole);
+  cleanUpIndex(run);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestRemoveDocuments:1
+// This test removes every even document and one odd one from an index,
+// checking that the words found only in those are gone and that the
+// other words have the postings of an index built without them
+int TestRemoveDocuments1() {
+  START_TEST_CASE;
+  INVERTED_INDEX* index = NULL;
+  INVERTED_INDEX* expected = NULL;
+  int numDocuments = 300;
+  char removed[301];
+
+  index = initStructure(index);
+  expected = initStructure(expected);
+
+  for (int i = 1; i <= numDocuments; i++){
+    removed[i] = i % 2 == 0 || i == 7;
+
+    addMergeDocument(index, i);
+    if (!removed[i]){
+      addMergeDocument(expected, i);
+    }
+  }
+
+  removeDocuments(index, removed, numDocuments);
+
+  // "half" is only in even documents
+  SHOULD_BE(findWordNode(index, "half") == NULL);
+  SHOULD_BE(findWordNode(index, "only7") == NULL);
+  SHOULD_BE(findWordNode(index, "only9") != NULL);
+  SHOULD_BE(index->numWords == expected->numWords);
+
+  int same = 1;
+  for (int i = 0; i < expected->numSlots; i++){
+    WordNode* wordNode = expected->slots[i].wordNode;
+    if (wordNode == NULL){
+      continue;
+    }
+
+    WordNode* left = findWordNode(index, wordNode->word);
+    if (left == NULL || left->numPages != wordNode->numPages
+        || left->postingsLength != wordNode->postingsLength
+        || memcmp(left->postings, wordNode->postings, wordNode->postingsLength)){
+      same = 0;
+    }
+  }
+  SHOULD_BE(same);
+
+  cleanUpIndex(index);
+  cleanUpIndex(expected);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestPageStore:1
+// This test appends pages to a page store in two sessions, then reads
+// them back by id, through countPages and through a document reader, and
+// checks that a store cut off before its offset table still opens
+int TestPageStore1() {
+  START_TEST_CASE;
+  char dir[] = "pagestore_test";
+  char body[100];
+  char expected[200];
+  char url[100];
+  int numDocuments = 7;
+  int documentId;
+
+  mkdir(dir, 0700);
+
+  // 5 pages, then 2 more after the store was closed once
+  PAGE_STORE* store = createPageStore(dir);
+  for (int i = 1; i <= numDocuments; i++){
+    if (i == 6){
+      closePageStore(store);
+      store = createPageStore(dir);
+    }
+
+    sprintf(url, "http://page%d.html", i);
+    sprintf(body, "<html>page %d</html>\n", i);
+    SHOULD_BE(appendPage(store, url, i % 3, body, strlen(body)) == i);
+  }
+  closePageStore(store);
+
+  SHOULD_BE(countPages(dir) == numDocuments);
+
+  store = openPageStore(dir);
+  SHOULD_BE(store != NULL);
+  SHOULD_BE(store->numPages == numDocuments);
+
+  char* html = readPage(store, 3);
+  SHOULD_BE(html != NULL && !strcmp(html, "http://page3.html\n0\n<html>page 3</html>\n"));
+  free(html);
+
+  SHOULD_BE(readPageURL(store, 7, url, sizeof(url)) && !strcmp(url, "http://page7.html"));
+  SHOULD_BE(readPageURL(store, 7, url, 5) && !strcmp(url, "http"));
+  SHOULD_BE(readPage(store, 0) == NULL);
+  SHOULD_BE(readPage(store, numDocuments + 1) == NULL);
+
+  uint64_t end = store->end;
+  closePageStore(store);
+
+  // documents 2 to 6 come out of the store as their files would
+  DOCUMENT_READER* reader = startDocumentReader(dir, 2, 6, 2);
+
+  int inOrder = 1;
+  int numRead = 0;
+  while ((html = nextDocument(reader, &documentId)) != NULL){
+    sprintf(expected, "http://page%d.html\n%d\n<html>page %d</html>\n",
+        documentId, documentId % 3, documentId);
+
+    if (documentId != 2 + numRead || strcmp(html, expected) != 0){
+      inOrder = 0;
+    }
+    numRead++;
+    free(html);
+  }
+  SHOULD_BE(inOrder);
+  SHOULD_BE(numRead == 5);
+
+  stopDocumentReader(reader);
+
+  // without the offset table and trailer the records are walked instead
+  char* path = pageStorePath(dir);
+  char* records = (char*) malloc(end);
+  FILE* fp = fopen(path, "r");
+  SHOULD_BE(fp != NULL && fread(records, 1, end, fp) == end);
+  fclose(fp);
+
+  fp = fopen(path, "w");
+  SHOULD_BE(fwrite(records, 1, end, fp) == end);
+  fclose(fp);
+  free(records);
+
+  store = openPageStore(dir);
+  SHOULD_BE(store != NULL && store->numPages == numDocuments);
+
+  html = store != NULL ? readPage(store, numDocuments) : NULL;
+  SHOULD_BE(html != NULL && !strcmp(html, "http://page7.html\n1\n<html>page 7</html>\n"));
+  free(html);
+  closePageStore(store);
+
+  unlink(path);
+  free(path);
+  rmdir(dir);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestDocTable:1
+// This test records pages in a document table, some copied from another
+// table, saves it and checks the URL, depth and length of every document
+// in the mapped file, and that documents never recorded are unknown
+int TestDocTable1() {
+  START_TEST_CASE;
+  char path[] = "doctable_test.docs";
+  char page[200];
+  char url[100];
+  int numDocuments = 9;
+
+  // documents 1 to 3 are copied over from an earlier table
+  DOC_TABLE* before = newDocTable(3);
+  DOC_TABLE* docTable = newDocTable(numDocuments);
+
+  for (int i = 1; i <= numDocuments; i++){
+    if (i == 5){
+      continue;
+    }
+
+    sprintf(page, "http://page%d.html\n%d\n<html>page %d</html>\n", i, i % 4, i);
+    if (i <= 3){
+      recordDocument(before, i, page);
+      recordDocumentWords(before, i, 10 * i);
+      copyDocument(docTable, before, i);
+    } else {
+      recordDocument(docTable, i, page);
+      recordDocumentWords(docTable, i, 10 * i);
+    }
+  }
+  freeDocTable(before);
+
+  saveDocTable(docTable, path);
+  freeDocTable(docTable);
+
+  docTable = openDocTable(path);
+  SHOULD_BE(docTable != NULL);
+  SHOULD_BE(docTable->numDocuments == numDocuments);
+  SHOULD_BE(docTable->numIndexed == numDocuments - 1);
+  SHOULD_BE(getAverageDocumentWords(docTable) == 50);
+
+  int same = 1;
+  for (int i = 1; i <= numDocuments; i++){
+    if (i == 5){
+      continue;
+    }
+
+    sprintf(url, "http://page%d.html", i);
+    const char* tableURL = getDocumentURL(docTable, i);
+
+    if (tableURL == NULL || strcmp(tableURL, url) != 0
+        || getDocumentDepth(docTable, i) != i % 4 || getDocumentWords(docTable, i) != 10 * i){
+      same = 0;
+    }
+  }
+  SHOULD_BE(same);
+
+  SHOULD_BE(getDocumentURL(docTable, 5) == NULL);
+  SHOULD_BE(getDocumentDepth(docTable, 5) == -1);
+  SHOULD_BE(getDocumentURL(docTable, 0) == NULL);
+  SHOULD_BE(getDocumentURL(docTable, numDocuments + 1) == NULL);
+
+  freeDocTable(docTable);
+  unlink(path);
+
+  // a missing table is not an error, just unknown
+  SHOULD_BE(openDocTable(path) == NULL);
+
+  END_TEST_CASE;
+}
+
+// Test case: TestBM25:1
+// This test looks up "dog OR cat" with a scorer over documents of
+// different lengths, checks a score against the formula, that rarer
+// words and shorter documents weigh more, the order rankByScore gives
+// and that the scores are cleared. It then adds the score of one word
+// to one document with addDocumentScore()
+int TestBM25_1() {
+  START_TEST_CASE;
+  char path[] = "bm25_test.docs";
+  char page[100];
+  int lengths[5] = { 0, 100, 100, 400, 100 };
+  INVERTED_INDEX* testIndex = NULL;
+
+  // 4 documents of 175 words on average
+  DOC_TABLE* docTable = newDocTable(4);
+  for (int i = 1; i <= 4; i++){
+    sprintf(page, "http://page%d.html\n0\n", i);
+    recordDocument(docTable, i, page);
+    recordDocumentWords(docTable, i, lengths[i]);
+  }
+  saveDocTable(docTable, path);
+  freeDocTable(docTable);
+  docTable = openDocTable(path);
+  SHOULD_BE(docTable != NULL);
+
+  // dog is in documents 1, 2 and 3, cat in 2 and 4
+  testIndex = initStructure(testIndex);
+  WordNode* dog = NULL;
+  dog = newWordNode(dog, "dog", testIndex);
+  addWordNode(testIndex, dog);
+  addPosting(dog, 1, 2, testIndex);
+  addPosting(dog, 2, 1, testIndex);
+  addPosting(dog, 3, 2, testIndex);
+
+  WordNode* cat = NULL;
+  cat = newWordNode(cat, "cat", testIndex);
+  addWordNode(testIndex, cat);
+  addPosting(cat, 2, 1, testIndex);
+  addPosting(cat, 4, 1, testIndex);
+
+  resultScorer = newBM25Scorer(docTable);
+  SHOULD_BE(bm25IDF(resultScorer, 2) > bm25IDF(resultScorer, 3));
+  SHOULD_BE(bm25IDF(resultScorer, 4) > 0);
+
+  char query[1000] = "dog OR cat";
+  char* queryList[1000];
+  BZERO(queryList, 1000);
+  curateWords(queryList, query);
+
+  DocumentNode** saved = lookUp(queryList, testIndex);
+
+  // document 1: dog twice, in 100 of 175 words
+  double norm = BM25_K1 * (1 - BM25_B + BM25_B * 100 / 175.0);
+  double expected = bm25IDF(resultScorer, 3) * 2 * (BM25_K1 + 1) / (2 + norm);
+  SHOULD_BE(getScore(resultScorer, 1) > expected - 1e-4
+      && getScore(resultScorer, 1) < expected + 1e-4);
+
+  // the same words in a longer document, and a rarer word
+  SHOULD_BE(getScore(resultScorer, 1) > getScore(resultScorer, 3));
+  SHOULD_BE(getScore(resultScorer, 4) > 0);
+  SHOULD_BE(getScore(resultScorer, 2) > getScore(resultScorer, 4));
+
+  int num = 0;
+  while (saved[num] != NULL){
+    num++;
+  }
+  rankByScore(saved, num);
+
+  int ordered = num > 0;
+  for (int i = 1; i < num; i++){
+    if (getScore(resultScorer, saved[i - 1]->document_id)
+        < getScore(resultScorer, saved[i]->document_id)){
+      ordered = 0;
+    }
+  }
+  SHOULD_BE(ordered);
+  SHOULD_BE(saved[num - 1]->document_id == 3);
+
+  clearScores(resultScorer);
+  SHOULD_BE(getScore(resultScorer, 1) == 0 && getScore(resultScorer, 2) == 0);
+  SHOULD_BE(resultScorer->numScored == 0);
+
+  // one word added to one document gives the same score, and documents
+  // past the table are left out
+  float weight = bm25Weight(resultScorer, 3);
+  double score = addDocumentScore(resultScorer, weight, 1, 2);
+  SHOULD_BE(score > expected - 1e-4 && score < expected + 1e-4);
+  SHOULD_BE(resultScorer->numScored == 1);
+  SHOULD_BE(addDocumentScore(resultScorer, weight, 5, 2) == 0);
+  SHOULD_BE(resultScorer->numScored == 1);
+  clearScores(resultScorer);
+
+  cleanUpDocumentList(saved);
+  cleanUpQueryList(queryList);
   cleanUpIndex(testIndex);
+  freeBM25Scorer(resultScorer);
+  resultScorer = NULL;
+  freeDocTable(docTable);
+  unlink(path);
 
   END_TEST_CASE;
 }
@@ -738,10 +2361,10 @@ int TestLookUp5() {
 //  It tests the following functions:
 //
 //   INVERTED_INDEX* initStructure(INVERTED_INDEX* index);
-//   DocumentNode** intersection(DocumentNode** final, DocumentNode** list,
+//   DOC_ITERATOR* newAndIterator(DOC_ITERATOR** children, int numChildren);
 //   char** curateWords(char** queryList, char* query);
 //   void rankByFrequency(DocumentNode** saved, int l, int r);
-//   DocumentNode** lookUp(DocumentNode** saved, char** queryList, INVERTED_INDEX* indexReload);
+//   DocumentNode** lookUp(char** queryList, INVERTED_INDEX* indexReload);
 //
 
 int main(int argc, char** argv) {
@@ -752,6 +2375,8 @@ int main(int argc, char** argv) {
   RUN_TEST(TestANDOp1, "AND operator Test case 1");
   RUN_TEST(TestANDOp2, "AND operator Test case 2");
   RUN_TEST(TestANDOp3, "AND operator Test case 3");
+  RUN_TEST(TestANDOp4, "AND operator Test case 4");
+  RUN_TEST(TestIntersectKernels1, "Intersect Kernels Test case 1");
   RUN_TEST(TestCurate1, "Curate Keywords Test case 1");
   RUN_TEST(TestCurate2, "Curate Keywords Test case 2");
   RUN_TEST(TestRanking1, "Quicksort Ranking Test case 1");
@@ -760,6 +2385,25 @@ int main(int argc, char** argv) {
   RUN_TEST(TestLookUp3, "Look Up Test case 3");
   RUN_TEST(TestLookUp4, "Look Up Test case 4");
   RUN_TEST(TestLookUp5, "Look Up Test case 5");
+  RUN_TEST(TestLookUp6, "Look Up Test case 6");
+  RUN_TEST(TestIndexFile1, "Binary Index File Test case 1");
+  RUN_TEST(TestDocBitmap1, "Document Bitmap Test case 1");
+  RUN_TEST(TestDocIterator1, "Document Iterator Test case 1");
+  RUN_TEST(TestLazyOpen1, "Lazy Open Test case 1");
+  RUN_TEST(TestWordTable1, "Word Table Test case 1");
+  RUN_TEST(TestArena1, "Arena Test case 1");
+  RUN_TEST(TestPostings1, "Postings Test case 1");
+  RUN_TEST(TestVarint1, "Varint Test case 1");
+  RUN_TEST(TestBlockDecode1, "Block Decode Test case 1");
+  RUN_TEST(TestSortedWords1, "Sorted Words Test case 1");
+  RUN_TEST(TestSanitize1, "Sanitize Test case 1");
+  RUN_TEST(TestMerge1, "Merge Test case 1");
+  RUN_TEST(TestDocumentReader1, "Document Reader Test case 1");
+  RUN_TEST(TestIndexRun1, "Index Run Test case 1");
+  RUN_TEST(TestRemoveDocuments1, "Remove Documents Test case 1");
+  RUN_TEST(TestPageStore1, "Page Store Test case 1");
+  RUN_TEST(TestDocTable1, "Document Table Test case 1");
+  RUN_TEST(TestBM25_1, "BM25 Test case 1");
 
   if (!cnt) {
     printf("All passed!\n Passed: %d \n", cnt); return 0;
@@ -20,17 +20,33 @@ Design Spec:
 The query is parsed by curateWords which puts the keywords in the queryList. It goes through
 each keyword and checks if that WordNode exists in the inverted index (via hashing).
 
-searchForKeyword then goes through each keyword and finds if the WordNode
-exists in the inverted index. If so, it grabs all the DocumentNodes and 
-puts them in the list.
-
-lookUp does the heavy lifting for the AND and OR. It uses the intersection()
-method to find any intersection between two sets. lookUp also implements
-a union method if an OR is detected as a keyword.
+lookUp does the heavy lifting for the AND and OR. It makes a document
+iterator (../utils/dociterator.h) over the postings of each keyword, ANDs
+the iterators of the keywords between two ORs and ORs those together. The
+iterators walk the documents that match one at a time, in document order,
+straight out of the postings: the shortest list of an AND leads and the
+others skip ahead to its documents, a block of postings at a time. A
+DocumentNode is only made for a document that matches the whole query,
+so the results are the only list a query allocates. With a resultLimit
+only the best that many are kept.
+
+A binary index file keeps the documents of dense words as document
+bitmaps (../utils/docbitmap.h). Dense words ANDed together are ANDed as
+bitmaps, 64 documents at a time, and the other words of the AND skip to
+the documents that are left.
+
+Whenever an AND lands on a document, the decoded blocks of its two
+shortest lists are intersected with SSE2 or AVX2 when the CPU has them
+(../utils/intersect.h), and only the documents both blocks have are
+tried next.
 
 rankByFrequency using a quicksort method with the 
 DocumentNodes to sort them by frequency
 
+If the index has a document table, every result also gets the BM25 scores
+of the keywords it matched (see ../utils/bm25.h) as it is found, and the
+results are ranked by score instead of by frequency
+
 Implementation Spec Pseudocode: 
 
  */
@@ -41,13 +57,29 @@ Implementation Spec Pseudocode:
 
 #include "../utils/header.h"
 #include "../utils/index.h"
+#include "../utils/indexfile.h"
 #include "../utils/hash.h"
 #include "../utils/file.h"
+#include "../utils/pagestore.h"
+#include "../utils/doctable.h"
+#include "../utils/bm25.h"
+#include "../utils/dociterator.h"
 #include "querylogic.h"
  
-int resultSlot[1000]; // stores the document_id of matches
-int nextFreeSlot = 0; // stores the position of the next free slot in results array
-int next_free = 0; // stores the position of the next free slot in results array
+// the document table of the index, which results are printed from
+// (NULL if the index has none; the pages are read instead)
+DOC_TABLE* resultDocTable = NULL;
+
+// scores the results with BM25 (NULL to rank them by frequency)
+BM25_SCORER* resultScorer = NULL;
+
+// the page store the results are printed from, opened with the first
+// result (NULL if the pages of resultDir are in a file each)
+PAGE_STORE* resultStore = NULL;
+char* resultDir = NULL;
+
+// the most results a query keeps, the best ones (0 to keep them all)
+int resultLimit = 0;
 
 // converts the raw query from the command line processing into
 // a list of words to be cross-referenced with the index
@@ -62,6 +94,7 @@ char** curateWords(char** queryList, char* query){
   keyword = strtok(copy, " ");
 
   int num = 0;
+  int numKeywords = 0;
   if ( keyword != NULL){
     // index for the word in the list
     queryList[num] = (char*) malloc(sizeof(char) * 1000);
@@ -69,6 +102,7 @@ char** curateWords(char** queryList, char* query){
 
     // move keyword in 
     strcpy(queryList[num], keyword);
+    numKeywords++;
   } else {
     printf("No keywords were valid in your query \n");
   }
@@ -81,6 +115,13 @@ char** curateWords(char** queryList, char* query){
 
     // move keyword in 
     strcpy(queryList[num], keyword);
+    numKeywords++;
+  }
+
+  // the list ends with a NULL, however many keywords there are (it is
+  // left alone if there are none)
+  if (numKeywords > 0){
+    queryList[numKeywords] = NULL;
   }
 
   return queryList;
@@ -115,6 +156,22 @@ void cleanUpList(DocumentNode** usedList){
   }
 }
 
+// creates an empty (NULL terminated) list with room for maxLength
+// DocumentNodes
+DocumentNode** newDocumentList(int maxLength){
+  DocumentNode** list = (DocumentNode**) malloc(sizeof(DocumentNode*) * (maxLength + 1));
+  MALLOC_CHECK(list);
+  list[0] = NULL;
+
+  return list;
+}
+
+// frees the DocumentNodes of a list made by newDocumentList and the list
+void cleanUpDocumentList(DocumentNode** list){
+  cleanUpList(list);
+  free(list);
+}
+
 // Implementation of Quicksort in descending order
 // using page frequencies 
 int rankSplit(DocumentNode** saved, int l, int r){
@@ -156,6 +213,33 @@ void rankByFrequency(DocumentNode** saved, int l, int r){
   }
 }
 
+// orders results by descending score (with a scorer), then by descending
+// frequency and ascending document id so that ties always come out the
+// same way
+static int compareResults(const DocumentNode* left, const DocumentNode* right){
+  if (resultScorer != NULL){
+    double leftScore = getScore(resultScorer, left->document_id);
+    double rightScore = getScore(resultScorer, right->document_id);
+
+    if (leftScore != rightScore){
+      return leftScore < rightScore ? 1 : -1;
+    }
+  }
+  if (left->page_word_frequency != right->page_word_frequency){
+    return right->page_word_frequency - left->page_word_frequency;
+  }
+  return left->document_id - right->document_id;
+}
+
+static int compareScores(const void* a, const void* b){
+  return compareResults(*(DocumentNode* const*) a, *(DocumentNode* const*) b);
+}
+
+// sorts the results by the BM25 scores the keywords added up
+void rankByScore(DocumentNode** saved, int num){
+  qsort(saved, num, sizeof(DocumentNode*), compareScores);
+}
+
 int rankAndPrint(DocumentNode** saved, char* urlDir){
   if (saved[0] != NULL){
     // count length 
@@ -164,8 +248,13 @@ int rankAndPrint(DocumentNode** saved, char* urlDir){
       num++;
     }
 
-    // Simple ranking algorithm by page frequency
-    rankByFrequency(saved, 0, num - 1);
+    // BM25 if the index has the document lengths, otherwise the simple
+    // ranking algorithm by page frequency
+    if (resultScorer != NULL){
+      rankByScore(saved, num);
+    } else {
+      rankByFrequency(saved, 0, num - 1);
+    }
 
     num = 0;
     while (saved[num] != NULL){
@@ -178,78 +267,44 @@ int rankAndPrint(DocumentNode** saved, char* urlDir){
   }
 
   // final clean up
-  cleanUpList(saved);
-  BZERO(saved, 1000);
+  cleanUpDocumentList(saved);
   
   return 1;
 }
 
-// Duplicates the Document nodes
-DocumentNode* copyDocNode(DocumentNode* docNode, DocumentNode* orig){
-  docNode = newDocNode(docNode, orig->document_id, orig->page_word_frequency);
-  return docNode;
-}
-
-// given a word to search for, this function will return a list of 
-// DocumentNodes with the word in it
-DocumentNode** searchForKeyword(DocumentNode** list, char* keyword, INVERTED_INDEX* indexReload){
-  DocumentNode* docNode = NULL;
-  // look for the keyword in the inverted index
-  int wordHash = hash1(keyword) % MAX_NUMBER_OF_SLOTS;
-
-  WordNode* checkWordNode = NULL; 
-  checkWordNode = indexReload->hash[wordHash];
+void printOutput(DocumentNode* matchedDocNode, char* urlDir){
+  char* filepath = NULL;
+  char* document_id;
+  int document_id_int;
+  FILE* fp;
+  char* docURL;
 
-  // Word could not be found in indexer
-  if (checkWordNode == NULL){
-    // move on to next word
-    return NULL;
+  // the document table has every URL without touching the pages
+  const char* tableURL = getDocumentURL(resultDocTable, matchedDocNode->document_id);
+  if (tableURL != NULL){
+    printf("Document ID:%d URL:%s\n", matchedDocNode->document_id, tableURL);
+    return;
   }
 
-  // hash slot wasn't empty
-  WordNode* matchedWordNode = NULL;
-
-  // loop through each wordNode
-  for (checkWordNode = indexReload->hash[wordHash];
-      checkWordNode != NULL; checkWordNode = checkWordNode->next){
-    if (!strncmp(checkWordNode->word, keyword, WORD_LENGTH)){
-      // found a match that wasn't the first in the list
-      matchedWordNode = checkWordNode;
-      break;
-    } 
+  // pages kept in a page store are looked up by id, not opened one by one
+  if (resultDir != urlDir){
+    closePageStore(resultStore);
+    resultStore = openPageStore(urlDir);
+    resultDir = urlDir;
   }
 
-  // check if the match was found
-  if (matchedWordNode != NULL){
-
-    // loop through the URL docs
-    DocumentNode* matchedDocNode = matchedWordNode->page;
-    int num = 0;
-    while(matchedDocNode != NULL){
-      // save into the list and return
-      docNode = NULL;
-      docNode = copyDocNode(docNode, matchedDocNode);
-
-      list[num] = docNode;
+  if (resultStore != NULL){
+    char url[MAX_URL_LENGTH];
 
-      matchedDocNode = matchedDocNode->next;
-      num++;
+    if (!readPageURL(resultStore, matchedDocNode->document_id, url, MAX_URL_LENGTH)){
+      fprintf(stderr, "Error opening the document! \n");
+      exit(1);
     }
-    return list;
 
-  } else {
-    return NULL;
+    printf("Document ID:%d URL:%s\n", matchedDocNode->document_id, url);
+    return;
   }
 
-}
-
-void printOutput(DocumentNode* matchedDocNode, char* urlDir){
-  char* filepath = NULL;
-  char* document_id;
-  int document_id_int;
-  FILE* fp;
-  char* docURL;
-
   // make the ID from an int into a char
   document_id_int = matchedDocNode->document_id;
   document_id = malloc(sizeof(char) * 1000);
@@ -287,97 +342,163 @@ void printOutput(DocumentNode* matchedDocNode, char* urlDir){
   free(filepath);
 }
 
-// returns the intersection of the two lists (final and list)
-DocumentNode** intersection(DocumentNode** final, DocumentNode** list,
-    DocumentNode** result, int* resultSlot){
-  DocumentNode* docNode = NULL;
+// makes an iterator over the postings of keyword (with no documents if
+// it is not in the index), weighted for BM25 if results are scored
+DOC_ITERATOR* keywordIterator(char* keyword, INVERTED_INDEX* indexReload){
+  POSTINGS_CURSOR cursor;
+  int documentCount = 0;
 
-  int i = 0; 
-  int j = 0;
+  // binary index files are read in place
+  if (indexReload->file != NULL){
+    const INDEX_FILE_TERM* term = findIndexFileTerm(indexReload->file, keyword);
 
-  int nextFreeSlot = 0;
+    if (term != NULL){
+      startIndexFilePostings(&cursor, indexReload->file, term);
+      documentCount = (int) term->documentCount;
+    }
+  } else {
+    // (a lazily opened index decodes the word's postings here)
+    WordNode* matchedWordNode = lookUpWordNode(indexReload, keyword);
 
-  while ( (final[i] != NULL) ){
-    while ( (list[j] != NULL) ) {
+    if (matchedWordNode != NULL){
+      startWordPostings(&cursor, matchedWordNode);
+      documentCount = matchedWordNode->numPages;
+    }
+  }
 
-      // check if the doc ID's match
-      if ( (final[i]->document_id == list[j]->document_id) ){
-        // check if the DocNode has been added already
-        // since DocIDs are unique, there cannot be collisions
-        if ( result[final[i]->document_id] != NULL){
-          // should not happen
-          fprintf(stderr, "Warning: Doc Id: %d is colliding (multiple docs of the same id). Skipping.\n", final[i]->document_id);
+  if (documentCount == 0){
+    startPostings(&cursor, NULL, 0);
+  }
 
+  float weight = resultScorer != NULL ? bm25Weight(resultScorer, documentCount) : 0;
+  return newPostingsIterator(&cursor, documentCount, weight);
+}
 
-        } else {
-          // DocNode doesn't exist already
-          docNode = NULL;
-          docNode = newDocNode(docNode, final[i]->document_id, 
-            final[i]->page_word_frequency + list[j]->page_word_frequency);
+// ANDs the iterators of the words between two ORs. The dense words are
+// ANDed as document bitmaps first, e.g. "computer science", and the other
+// words are then only advanced to the documents those have in common
+static DOC_ITERATOR* andWords(DOC_ITERATOR** words, int numWords){
+  DOC_ITERATOR** denseWords = (DOC_ITERATOR**) malloc(sizeof(DOC_ITERATOR*) * numWords);
+  MALLOC_CHECK(denseWords);
+  int numDense = 0;
+  int numOthers = 0;
+
+  for (int i = 0; i < numWords; i++){
+    if (isDenseIterator(words[i])){
+      denseWords[numDense++] = words[i];
+    } else {
+      words[numOthers++] = words[i];
+    }
+  }
 
-          // add docNode into the result list
-          result[final[i]->document_id] = docNode;
+  if (numDense > 1){
+    words[numOthers++] = newBitmapIterator(denseWords, numDense);
+  } else if (numDense == 1){
+    words[numOthers++] = denseWords[0];
+  }
+  free(denseWords);
 
-          // store the valid document ID into resultSlot for looping
-          resultSlot[nextFreeSlot] = final[i]->document_id;
-          nextFreeSlot++;
-        }
-        break;
-      }
-      j++;
+  if (numOthers == 1){
+    return words[0];
+  }
+  return newAndIterator(words, numOthers);
+}
+
+// puts the worst of the results kept so far at the top of the heap
+static void siftUp(DocumentNode** heap, int i){
+  while (i > 0 && compareResults(heap[i], heap[(i - 1) / 2]) > 0){
+    DocumentNode* t = heap[i];
+    heap[i] = heap[(i - 1) / 2];
+    heap[(i - 1) / 2] = t;
+    i = (i - 1) / 2;
+  }
+}
+
+static void siftDown(DocumentNode** heap, int i, int num){
+  while (2 * i + 1 < num){
+    int worst = 2 * i + 1;
+    if (worst + 1 < num && compareResults(heap[worst + 1], heap[worst]) > 0){
+      worst++;
+    }
+    if (compareResults(heap[worst], heap[i]) <= 0){
+      break;
     }
 
-    i++;
-    j = 0; // start from beginning of other list again
+    DocumentNode* t = heap[i];
+    heap[i] = heap[worst];
+    heap[worst] = t;
+    i = worst;
   }
-  return result;
 }
 
-// copies the two Document Node lists by copying the DocNode
-// lists over
-void copyList(DocumentNode** result, DocumentNode** orig){
-  DocumentNode* docNode = NULL;
-  int i = 0;
+// Walks the documents that match the query and makes a DocumentNode for
+// each of them, in document order. With a resultLimit, only the best
+// that many are kept, in a heap with the worst of them on top whose
+// DocumentNodes are reused
+static DocumentNode** collectResults(DOC_ITERATOR* query){
+  int maxResults = query->cost;
+  if (resultLimit > 0 && resultLimit < maxResults){
+    maxResults = resultLimit;
+  }
 
-  while (orig[i] != NULL){
-    docNode = NULL;
-    docNode = copyDocNode(docNode, orig[i]);
-    result[i] = docNode;
+  DocumentNode** saved = newDocumentList(maxResults);
+  int num = 0;
 
-    i++;
+  while (nextDocIterator(query) != DOC_ITERATOR_END){
+    DocumentNode match;
+    match.next = NULL;
+    match.document_id = query->documentId;
+    match.page_word_frequency = docIteratorFrequency(query);
+
+    if (resultScorer != NULL){
+      scoreDocIterator(query, resultScorer);
+    }
+
+    if (num < maxResults){
+      saved[num] = newDocNode(NULL, match.document_id, match.page_word_frequency);
+      num++;
+      if (resultLimit > 0){
+        siftUp(saved, num - 1);
+      }
+    } else if (compareResults(&match, saved[0]) < 0){
+      saved[0]->document_id = match.document_id;
+      saved[0]->page_word_frequency = match.page_word_frequency;
+      siftDown(saved, 0, num);
+    }
   }
+  saved[num] = NULL;
+
+  return saved;
 }
 
 // This function looks up each of the keywords in queryList and cross-
-// references them with the index in memory. 
-// It will take AND or OR operators. If there is an "AND", it will
-// take the intersection of the sets. If there is an "OR", it will take
-// the union of the sets
-
-// returns 1 if the lookup was successful 
-DocumentNode** lookUp(DocumentNode** saved, char** queryList, INVERTED_INDEX* indexReload){
-  int firstRunFlag = 1;
+// references them with the index in memory.
+// It will take AND or OR operators. The iterators of the keywords
+// between two ORs are ANDed (dense words as bitmaps, see andWords) and
+// those groups are ORed; collectResults then walks the documents of
+// the query, keeping the best resultLimit of them in a heap
+
+// returns the matching DocumentNodes in a list made by newDocumentList
+DocumentNode** lookUp(char** queryList, INVERTED_INDEX* indexReload){
   int orFlag = 0;
 
-  // loop through each keyword
-  DocumentNode* temp[1000];
-  BZERO(temp, 1000);
-
-  DocumentNode* tempHolder[1000]; 
-  BZERO(tempHolder, 1000);
-
-  // Results holds the resultant DocNodes from the "AND" or "OR" operators.
-  // It will save these DocNodes by their ID i.e. for doc #47, result[47]. 
-  // So the number of files in DIR (i.e. the ID's) will determine how big
-  // results should be 
-  DocumentNode* result[10000]; 
-  BZERO(result, 10000);
-
-  // list used to be returned at end
-  DocumentNode* list[1000];
-  BZERO(list, 1000);
+  int numKeywords = 0;
+  while (queryList[numKeywords]){
+    numKeywords++;
+  }
 
-  DocumentNode* docNode = NULL;
+  // the words ANDed since the last OR, and what the ORs join
+  DOC_ITERATOR** words = (DOC_ITERATOR**) malloc(sizeof(DOC_ITERATOR*) * (numKeywords + 1));
+  MALLOC_CHECK(words);
+  DOC_ITERATOR** groups = (DOC_ITERATOR**) malloc(sizeof(DOC_ITERATOR*) * (numKeywords + 1));
+  MALLOC_CHECK(groups);
+  int numWords = 0;
+  int numGroups = 0;
+
+  // the scores of the last query are not carried over
+  if (resultScorer != NULL){
+    clearScores(resultScorer);
+  }
 
   // if there is a 'space', it will default to AND'ing with orFlag = 0;
   for (int i=0; queryList[i]; i++){
@@ -393,116 +514,33 @@ DocumentNode** lookUp(DocumentNode** saved, char** queryList, INVERTED_INDEX* in
       continue;
     }
 
-    BZERO(list, 1000);
-
-    searchForKeyword(list, queryList[i], indexReload);
-
-    // if nothing is in tempHolder yet
-    if ( tempHolder[0] == NULL && firstRunFlag){
-      // save the list to the tempHolder list
-      copyList(tempHolder, list);
-      cleanUpList(list);
-
-      firstRunFlag = 0;
-      orFlag = 0; // negate extraneous OR's in beginning
-    } else {
-      if (orFlag == 1 ){
-        // OR'ing
-
-        // bank the "tempHolder" list and start a new tempHolder list
-        // start where last left off using next_free
-        int index = 0;
-        while (tempHolder[index]){
-          saved[next_free] = tempHolder[index];
-          index++;
-          next_free++;
-        }
-
-        BZERO(tempHolder, 1000); // clear out the "tempHolder" list because it was banked
-
-        // move current results into the "tempHolder" list
-        copyList(tempHolder, list);
-        cleanUpList(list);
-
-        orFlag = 0;
-      } else {
-        // AND'ing (default)
-        // AND list and tempHolder together
-
-        if (list[0] != NULL){
-          // e.g. "dog cat"
-          // dog --> stored in tempHolder
-          // cat --> stored in list 
-          intersection(tempHolder, list, result, resultSlot);
-          // intersection will be stored in result
-          // result needs to be indexed by matching document id
-
-          // free helper lists 
-          cleanUpList(tempHolder); 
-          BZERO(tempHolder, 1000);
-
-          cleanUpList(list); 
-          BZERO(list, 1000);
-
-          // copy result back
-          int k = 0;
-          if (resultSlot[k] != '\0'){
-            while (resultSlot[k]){
-              // move the docNodes into tempHolder
-              docNode = NULL;
-              docNode = copyDocNode(docNode, result[resultSlot[k]]);
-              tempHolder[k] = docNode;
-
-              // freeing the matched DocNodes and putting them in tempHolder
-              free(result[resultSlot[k]]);
-              k++;
-            }
-
-          }
-
-        } else {
-          // edge case where no results were found
-          // e.g. "alskdfjsalkdfjk asdflkjsldf"
-          cleanUpList(tempHolder);
-          BZERO(tempHolder, 1000);
-
-          BZERO(temp, 1000);
-          firstRunFlag = 0;
-        }
-
-        BZERO(result, 10000);
-        BZERO(resultSlot, 1000);
-        nextFreeSlot = 0;
-      }
+    // an OR ends the words being ANDed (extraneous OR's in the beginning
+    // are ignored)
+    if (orFlag == 1 && numWords > 0){
+      groups[numGroups++] = andWords(words, numWords);
+      numWords = 0;
     }
+    orFlag = 0;
+
+    words[numWords++] = keywordIterator(queryList[i], indexReload);
   }
   //////// end of for loop ////////
-  if (tempHolder[0] != NULL ){
-    int index = 0;
-    while (tempHolder[index]){
-      docNode = NULL;
-      docNode = copyDocNode(docNode, tempHolder[index]);
-      saved[next_free] = docNode;
-
-      index++;
-      next_free++;
-    }
-
-    cleanUpList(tempHolder);
+  if (numWords > 0){
+    groups[numGroups++] = andWords(words, numWords);
   }
+  free(words);
 
-  // reset
-  BZERO(resultSlot, 1000);
-  nextFreeSlot = 0;
-  next_free = 0;  // for saved, reset for the new search
-
-  BZERO(result, 10000);
-
-  /*cleanUpList(saved);*/
-  /*BZERO(saved, 1000);*/
+  DocumentNode** saved;
+  if (numGroups == 0){
+    saved = newDocumentList(0);
+  } else {
+    DOC_ITERATOR* query = numGroups == 1 ? groups[0] : newOrIterator(groups, numGroups);
+    saved = collectResults(query);
+    freeDocIterator(query);
+  }
 
+  free(groups);
   return saved;
-  /*return 1;*/
 }
 
 // frees up the query list keywords that
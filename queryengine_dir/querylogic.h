@@ -5,6 +5,24 @@
 // File: querylogic.c
 // Author: Delos Chang
 
+#include "../utils/doctable.h"
+#include "../utils/bm25.h"
+#include "../utils/dociterator.h"
+
+// DEFINES
+
+// the document table results are printed from, set by the query engine
+// (NULL to read the URLs from the crawled pages)
+extern DOC_TABLE* resultDocTable;
+
+// the scorer results are ranked with, set by the query engine (NULL to
+// rank them by frequency)
+extern BM25_SCORER* resultScorer;
+
+// the most results lookUp keeps, the best ones first in ranking order,
+// set by the query engine (0 to keep them all)
+extern int resultLimit;
+
 // function PROTOTYPES used by querylogic.c 
 char** curateWords(char** queryList, char* query);
 
@@ -12,24 +30,23 @@ void sanitizeKeywords(char** queryList);
 
 void cleanUpList(DocumentNode** usedList);
 
+DocumentNode** newDocumentList(int maxLength);
+
+void cleanUpDocumentList(DocumentNode** list);
+
 int rankSplit(DocumentNode** saved, int l, int r);
 
 int rankAndPrint(DocumentNode** saved, char* urlDir);
 
 void rankByFrequency(DocumentNode** saved, int l, int r);
 
-DocumentNode* copyDocNode(DocumentNode* docNode, DocumentNode* orig);
-
-DocumentNode** intersection(DocumentNode** final, DocumentNode** list,
-    DocumentNode** result, int* resultSlot);
-
-DocumentNode** searchForKeyword(DocumentNode** list, char* keyword, INVERTED_INDEX* indexReload);
+void rankByScore(DocumentNode** saved, int num);
 
 void printOutput(DocumentNode* matchedDocNode, char* urlDir);
 
-void copyList(DocumentNode** result, DocumentNode** orig);
+DOC_ITERATOR* keywordIterator(char* keyword, INVERTED_INDEX* indexReload);
 
-DocumentNode** lookUp(DocumentNode** saved, char** queryList, INVERTED_INDEX* indexReload);
+DocumentNode** lookUp(char** queryList, INVERTED_INDEX* indexReload);
 //int lookUp(char** queryList, char* urlDir, INVERTED_INDEX* indexReload);
 
 void cleanUpQueryList(char** queryList);
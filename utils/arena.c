@@ -0,0 +1,148 @@
+/*
+
+FILE: arena.c
+Description: A simple arena (bump) allocator. Such as:
+
+0. Creating and freeing an arena
+1. Allocating aligned memory from the arena
+2. Copying strings into the arena, packed back to back
+3. Merging one arena into another
+4. Reporting the peak memory of the process
+
+By: Delos Chang
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "../utils/header.h"
+#include "arena.h"
+
+// every allocation from arenaAlloc is aligned to this
+#define ARENA_ALIGNMENT 8
+
+// Creates the arena. Blocks are only allocated when first needed
+ARENA* newArena(size_t blockSize){
+  ARENA* arena = (ARENA*) malloc(sizeof(ARENA));
+  MALLOC_CHECK(arena);
+
+  arena->current = NULL;
+  arena->blockSize = blockSize;
+  arena->bytesUsed = 0;
+
+  return arena;
+}
+
+// Returns a block with room for size more bytes once its used count has
+// been padded to alignment. Starts a new block when the current one is full
+static ARENA_BLOCK* reserveArenaBlock(ARENA* arena, size_t size, size_t alignment){
+  ARENA_BLOCK* block = arena->current;
+
+  if (block != NULL){
+    size_t padding = (alignment - (block->used % alignment)) % alignment;
+    if (block->used + padding + size <= block->size){
+      block->used += padding;
+      return block;
+    }
+  }
+
+  size_t capacity = size > arena->blockSize ? size : arena->blockSize;
+  block = (ARENA_BLOCK*) malloc(sizeof(ARENA_BLOCK) + capacity);
+  if (block == NULL){
+    fprintf(stderr, "Out of memory for indexing! Aborting. \n");
+    exit(1);
+  }
+
+  block->used = 0;
+  block->size = capacity;
+
+  // an oversized request gets its own block behind the current one so
+  // the rest of the current block can still be filled
+  if (size > arena->blockSize && arena->current != NULL){
+    block->next = arena->current->next;
+    arena->current->next = block;
+  } else {
+    block->next = arena->current;
+    arena->current = block;
+  }
+
+  return block;
+}
+
+// Hands out aligned memory from the current block
+void* arenaAlloc(ARENA* arena, size_t size){
+  ARENA_BLOCK* block = reserveArenaBlock(arena, size, ARENA_ALIGNMENT);
+
+  void* memory = block->data + block->used;
+  block->used += size;
+  arena->bytesUsed += size;
+
+  return memory;
+}
+
+// Copies the string without padding so words sit next to each other
+char* arenaCopyString(ARENA* arena, const char* string, size_t length){
+  ARENA_BLOCK* block = reserveArenaBlock(arena, length + 1, 1);
+
+  char* copy = block->data + block->used;
+  memcpy(copy, string, length);
+  copy[length] = '\0';
+
+  block->used += length + 1;
+  arena->bytesUsed += length + 1;
+
+  return copy;
+}
+
+// Links the blocks of from behind the current block of arena, so that
+// arena keeps filling its own block first
+void mergeArena(ARENA* arena, ARENA* from){
+  ARENA_BLOCK* last = from->current;
+
+  if (last != NULL){
+    while (last->next != NULL){
+      last = last->next;
+    }
+
+    if (arena->current == NULL){
+      arena->current = from->current;
+    } else {
+      last->next = arena->current->next;
+      arena->current->next = from->current;
+    }
+  }
+
+  arena->bytesUsed += from->bytesUsed;
+  free(from);
+}
+
+// Frees every block in one pass
+void freeArena(ARENA* arena){
+  if (arena == NULL){
+    return;
+  }
+
+  ARENA_BLOCK* block = arena->current;
+  while (block != NULL){
+    ARENA_BLOCK* toFreedom = block;
+    block = block->next;
+    free(toFreedom);
+  }
+
+  free(arena);
+}
+
+// Prints the peak resident set size as reported by getrusage
+void printPeakMemory(char* label){
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0){
+    // ru_maxrss is in kilobytes on Linux
+    printf("%s: peak resident memory %ld KB\n", label, usage.ru_maxrss);
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+// *****************Impementation Spec********************************
+// File: arena.c
+// Author: Delos Chang
+// This file contains useful information for the arena allocator:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// An arena hands out memory from large blocks by bumping a pointer.
+// Nothing is freed on its own: the whole arena is released at once
+// with freeArena. The index uses one to store its words back to back
+// instead of giving every WordNode its own WORD_LENGTH buffer.
+
+#include <stddef.h>
+
+// DEFINES
+
+// default size of each block the arena grabs with malloc
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// DATA STRUCTURES
+
+typedef struct _ARENA_BLOCK {
+  struct _ARENA_BLOCK *next;        // previously filled block
+  size_t used;                      // bytes handed out from data
+  size_t size;                      // capacity of data
+  char data[];                      // the memory itself
+} ARENA_BLOCK;
+
+typedef struct _ARENA {
+  ARENA_BLOCK *current;             // block being filled (head of the list)
+  size_t blockSize;                 // capacity of new blocks
+  size_t bytesUsed;                 // bytes handed out over all blocks
+} ARENA;
+
+// function PROTOTYPES
+
+// newArena: creates an empty arena whose blocks hold blockSize bytes
+ARENA* newArena(size_t blockSize);
+
+// arenaAlloc: returns size bytes aligned for any type. Requests larger
+// than a block get a block of their own
+void* arenaAlloc(ARENA* arena, size_t size);
+
+// arenaCopyString: copies length bytes of string into the arena, packed
+// with no alignment padding, followed by a NUL
+char* arenaCopyString(ARENA* arena, const char* string, size_t length);
+
+// mergeArena: hands every block of from over to arena and frees from.
+// What was allocated from from stays valid until arena is freed
+void mergeArena(ARENA* arena, ARENA* from);
+
+// freeArena: releases every block and the arena itself
+void freeArena(ARENA* arena);
+
+// printPeakMemory: prints the peak resident set size of the process
+void printPeakMemory(char* label);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+
+FILE: bm25.c
+Description: Scores documents against a query with BM25. Such as:
+
+0. Working out the length normalization of every document once
+1. Adding the score of a word to one document at a time
+2. Clearing only the scores a query touched
+
+By: Delos Chang
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../utils/header.h"
+#include "bm25.h"
+
+// A document the table has no length for is scored as an average one
+BM25_SCORER* newBM25Scorer(DOC_TABLE* docTable){
+  double averageWords = getAverageDocumentWords(docTable);
+
+  BM25_SCORER* scorer = (BM25_SCORER*) malloc(sizeof(BM25_SCORER));
+  MALLOC_CHECK(scorer);
+
+  scorer->numDocuments = docTable->numDocuments;
+  scorer->collectionSize = docTable->numIndexed;
+  scorer->norms = (float*) malloc(sizeof(float) * (scorer->numDocuments + 1));
+  scorer->scores = (float*) calloc(scorer->numDocuments + 1, sizeof(float));
+  scorer->scored = (int*) malloc(sizeof(int) * (scorer->numDocuments + 1));
+  MALLOC_CHECK(scorer->norms);
+  MALLOC_CHECK(scorer->scores);
+  MALLOC_CHECK(scorer->scored);
+  scorer->numScored = 0;
+
+  for (int id = 0; id <= scorer->numDocuments; id++){
+    double ratio = 1;
+
+    if (averageWords > 0 && getDocumentURL(docTable, id) != NULL){
+      ratio = getDocumentWords(docTable, id) / averageWords;
+    }
+
+    scorer->norms[id] = (float) (BM25_K1 * (1 - BM25_B + BM25_B * ratio));
+  }
+
+  return scorer;
+}
+
+// Never negative, even for a word in more than half the documents
+double bm25IDF(BM25_SCORER* scorer, int documentCount){
+  double n = documentCount;
+  double collectionSize = scorer->collectionSize > documentCount
+    ? scorer->collectionSize : documentCount;
+
+  return log(1 + (collectionSize - n + 0.5) / (n + 0.5));
+}
+
+float bm25Weight(BM25_SCORER* scorer, int documentCount){
+  return (float) (bm25IDF(scorer, documentCount) * (BM25_K1 + 1));
+}
+
+// Documents past the end of the table (the index is newer than it) are
+// left out
+double addDocumentScore(BM25_SCORER* scorer, float weight, int documentId, int frequency){
+  if (documentId < 1 || documentId > scorer->numDocuments){
+    return 0;
+  }
+
+  float* scores = scorer->scores;
+  float documentFrequency = (float) frequency;
+
+  if (scores[documentId] == 0){
+    scorer->scored[scorer->numScored++] = documentId;
+  }
+  scores[documentId] += weight * documentFrequency / (documentFrequency + scorer->norms[documentId]);
+
+  return scores[documentId];
+}
+
+double getScore(BM25_SCORER* scorer, int documentId){
+  if (documentId < 1 || documentId > scorer->numDocuments){
+    return 0;
+  }
+  return scorer->scores[documentId];
+}
+
+void clearScores(BM25_SCORER* scorer){
+  for (int i = 0; i < scorer->numScored; i++){
+    scorer->scores[scorer->scored[i]] = 0;
+  }
+  scorer->numScored = 0;
+}
+
+void freeBM25Scorer(BM25_SCORER* scorer){
+  if (scorer == NULL){
+    return;
+  }
+
+  free(scorer->norms);
+  free(scorer->scores);
+  free(scorer->scored);
+  free(scorer);
+}
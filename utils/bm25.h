@@ -0,0 +1,74 @@
+#ifndef _BM25_H_
+#define _BM25_H_
+
+// *****************Impementation Spec********************************
+// File: bm25.c
+// Author: Delos Chang
+// This file contains useful information for ranking with BM25:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// A document d scores, for every query word w it contains f times,
+//
+//   idf(w) * f * (k1 + 1) / (f + k1 * (1 - b + b * |d| / avgdl))
+//
+// where |d| is the number of words indexed from d and avgdl the average
+// over the collection (both from the document table, see doctable.h), and
+// idf(w) = ln(1 + (N - n + 0.5) / (n + 0.5)) for the N documents of the
+// collection, n of which contain w.
+//
+// The part of the denominator that only depends on the document is worked
+// out once per document when the scorer is created. Queries are evaluated
+// a document at a time (see dociterator.h), so the score of a word is
+// added to each document it matches as the document is found, into an
+// array of scores indexed by document id; nothing is allocated per
+// document.
+
+#include "doctable.h"
+
+// DEFINES
+
+// how quickly more occurrences of a word stop adding to the score
+#define BM25_K1 1.2
+
+// how much the score is normalized by the length of the document
+#define BM25_B 0.75
+
+// DATA STRUCTURES
+
+typedef struct _BM25_SCORER {
+  int numDocuments;                 // highest document id
+  int collectionSize;               // N: documents that were indexed
+  float *norms;                     // norms[id]: k1 * (1 - b + b * |d| / avgdl)
+  float *scores;                    // scores[id]: score of the query so far
+  int *scored;                      // ids with a score, in the order they got one
+  int numScored;
+} BM25_SCORER;
+
+// function PROTOTYPES
+
+// newBM25Scorer: creates a scorer for the documents of docTable
+BM25_SCORER* newBM25Scorer(DOC_TABLE* docTable);
+
+// bm25IDF: returns the idf of a word found in documentCount documents
+double bm25IDF(BM25_SCORER* scorer, int documentCount);
+
+// bm25Weight: returns idf * (k1 + 1) for a word found in documentCount
+// documents, which addDocumentScore takes
+float bm25Weight(BM25_SCORER* scorer, int documentCount);
+
+// addDocumentScore: adds the score of a word of the given weight that is
+// frequency times in documentId, and returns the score of the document
+double addDocumentScore(BM25_SCORER* scorer, float weight, int documentId, int frequency);
+
+// getScore: returns the score of documentId so far, 0 if it has none
+double getScore(BM25_SCORER* scorer, int documentId);
+
+// clearScores: sets the score of every document back to 0
+void clearScores(BM25_SCORER* scorer);
+
+// freeBM25Scorer: frees the scorer
+void freeBM25Scorer(BM25_SCORER* scorer);
+
+#endif
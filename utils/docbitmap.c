@@ -0,0 +1,644 @@
+/*
+
+FILE: docbitmap.c
+Description: Compressed bitmaps of document ids. Such as:
+
+0. Building a bitmap from ids in increasing order
+1. Picking the smallest container for every chunk of ids
+2. Using a stored bitmap in place
+3. Looking up whether (and where) an id is in a bitmap
+4. AND, OR and ANDNOT of two bitmaps a 64 bit word at a time
+5. Reading the ids of a bitmap in order
+6. Skipping ahead to an id while reading them
+
+By: Delos Chang
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../utils/header.h"
+#include "docbitmap.h"
+
+// rounds x up to the next multiple of 8
+#define ALIGN_UP8(x) (((x) + 7) & ~((size_t) 7))
+
+// the operations combineBitmaps can do
+#define BITMAP_AND 0
+#define BITMAP_OR 1
+#define BITMAP_ANDNOT 2
+
+DOC_BITMAP_BUILDER* newDocBitmapBuilder(){
+  DOC_BITMAP_BUILDER* builder = (DOC_BITMAP_BUILDER*) malloc(sizeof(DOC_BITMAP_BUILDER));
+  MALLOC_CHECK(builder);
+  BZERO(builder, sizeof(DOC_BITMAP_BUILDER));
+
+  builder->key = -1;
+  return builder;
+}
+
+// returns the first bit from on that is set, DOC_BITMAP_CHUNK_SIZE if none
+static int nextSetBit(const uint64_t* words, int from){
+  int w = from >> 6;
+  if (w >= DOC_BITMAP_WORDS){
+    return DOC_BITMAP_CHUNK_SIZE;
+  }
+
+  uint64_t word = words[w] & (~(uint64_t) 0 << (from & 63));
+  while (word == 0){
+    if (++w == DOC_BITMAP_WORDS){
+      return DOC_BITMAP_CHUNK_SIZE;
+    }
+    word = words[w];
+  }
+
+  return w * 64 + __builtin_ctzll(word);
+}
+
+// returns the first bit from on that is clear, DOC_BITMAP_CHUNK_SIZE if none
+static int nextClearBit(const uint64_t* words, int from){
+  int w = from >> 6;
+  if (w >= DOC_BITMAP_WORDS){
+    return DOC_BITMAP_CHUNK_SIZE;
+  }
+
+  uint64_t word = ~words[w] & (~(uint64_t) 0 << (from & 63));
+  while (word == 0){
+    if (++w == DOC_BITMAP_WORDS){
+      return DOC_BITMAP_CHUNK_SIZE;
+    }
+    word = ~words[w];
+  }
+
+  return w * 64 + __builtin_ctzll(word);
+}
+
+// sets the bits from from up to (not including) to
+static void setBits(uint64_t* words, int from, int to){
+  if (to > DOC_BITMAP_CHUNK_SIZE){
+    to = DOC_BITMAP_CHUNK_SIZE;
+  }
+
+  while (from < to){
+    int bit = from & 63;
+    int count = to - from < 64 - bit ? to - from : 64 - bit;
+    uint64_t mask = count == 64 ? ~(uint64_t) 0 : (((uint64_t) 1 << count) - 1) << bit;
+
+    words[from >> 6] |= mask;
+    from += count;
+  }
+}
+
+// Makes room for bytes more payload at the next multiple of 8. Returns
+// its offset in the payloads
+static size_t reservePayload(DOC_BITMAP_BUILDER* builder, size_t bytes){
+  size_t offset = ALIGN_UP8(builder->payloadsLength);
+
+  if (offset + bytes > builder->maxPayloads){
+    size_t maxPayloads = builder->maxPayloads > 0 ? builder->maxPayloads : 1024;
+    while (maxPayloads < offset + bytes){
+      maxPayloads *= 2;
+    }
+
+    builder->payloads = (unsigned char*) realloc(builder->payloads, maxPayloads);
+    MALLOC_CHECK(builder->payloads);
+    builder->maxPayloads = maxPayloads;
+  }
+
+  // the padding is zeroed so that equal bitmaps have equal bytes
+  memset(builder->payloads + builder->payloadsLength, 0, offset - builder->payloadsLength);
+  builder->payloadsLength = offset + bytes;
+
+  return offset;
+}
+
+// Stores the ids of chunk key, given as a bitmap, in whichever container
+// takes the fewest bytes
+static void addChunk(DOC_BITMAP_BUILDER* builder, int key, const uint64_t* words){
+  uint32_t cardinality = 0;
+  uint32_t numRuns = 0;
+  uint64_t previousTop = 0;
+
+  for (int w = 0; w < DOC_BITMAP_WORDS; w++){
+    uint64_t word = words[w];
+    cardinality += (uint32_t) __builtin_popcountll(word);
+
+    // a run starts at every set bit whose bit below is clear
+    numRuns += (uint32_t) __builtin_popcountll(word & ~((word << 1) | previousTop));
+    previousTop = word >> 63;
+  }
+
+  if (cardinality == 0){
+    return;
+  }
+
+  if (builder->numContainers == builder->maxContainers){
+    builder->maxContainers = builder->maxContainers > 0 ? 2 * builder->maxContainers : 4;
+    builder->containers = (DOC_BITMAP_CONTAINER*) realloc(builder->containers,
+        sizeof(DOC_BITMAP_CONTAINER) * builder->maxContainers);
+    MALLOC_CHECK(builder->containers);
+  }
+
+  DOC_BITMAP_CONTAINER* container = &(builder->containers[builder->numContainers++]);
+  BZERO(container, sizeof(DOC_BITMAP_CONTAINER));
+  container->key = (uint16_t) key;
+  container->cardinality = cardinality;
+  container->rank = builder->cardinality;
+
+  size_t arrayBytes = cardinality <= DOC_BITMAP_MAX_ARRAY ? 2 * cardinality : SIZE_MAX;
+  size_t runBytes = 4 * (size_t) numRuns;
+  size_t bitmapBytes = sizeof(uint64_t) * DOC_BITMAP_WORDS;
+
+  if (runBytes < arrayBytes && runBytes < bitmapBytes){
+    container->type = DOC_BITMAP_RUN;
+    container->size = numRuns;
+    container->offset = reservePayload(builder, runBytes);
+
+    uint16_t* runs = (uint16_t*) (builder->payloads + container->offset);
+    int start = nextSetBit(words, 0);
+    for (uint32_t r = 0; r < numRuns; r++){
+      int end = nextClearBit(words, start);
+      runs[2 * r] = (uint16_t) start;
+      runs[2 * r + 1] = (uint16_t) (end - start - 1);
+      start = nextSetBit(words, end);
+    }
+  } else if (arrayBytes <= bitmapBytes){
+    container->type = DOC_BITMAP_ARRAY;
+    container->size = cardinality;
+    container->offset = reservePayload(builder, arrayBytes);
+
+    uint16_t* values = (uint16_t*) (builder->payloads + container->offset);
+    int count = 0;
+    for (int w = 0; w < DOC_BITMAP_WORDS; w++){
+      uint64_t word = words[w];
+      while (word){
+        values[count++] = (uint16_t) (w * 64 + __builtin_ctzll(word));
+        word &= word - 1;
+      }
+    }
+  } else {
+    container->type = DOC_BITMAP_BITMAP;
+    container->offset = reservePayload(builder, bitmapBytes);
+    memcpy(builder->payloads + container->offset, words, bitmapBytes);
+  }
+
+  builder->cardinality += cardinality;
+}
+
+void addToDocBitmap(DOC_BITMAP_BUILDER* builder, int documentId){
+  int key = documentId >> 16;
+  int low = documentId & 0xFFFF;
+
+  if (key != builder->key){
+    if (builder->key >= 0){
+      addChunk(builder, builder->key, builder->words);
+      BZERO(builder->words, sizeof(builder->words));
+    }
+    builder->key = key;
+  }
+
+  builder->words[low >> 6] |= (uint64_t) 1 << (low & 63);
+}
+
+// The containers come first, so the offsets of the payloads are moved
+// past them
+DOC_BITMAP* finishDocBitmap(DOC_BITMAP_BUILDER* builder){
+  DOC_BITMAP_HEADER header;
+
+  if (builder->key >= 0){
+    addChunk(builder, builder->key, builder->words);
+  }
+
+  size_t base = sizeof(DOC_BITMAP_HEADER)
+    + sizeof(DOC_BITMAP_CONTAINER) * (size_t) builder->numContainers;
+  for (int c = 0; c < builder->numContainers; c++){
+    builder->containers[c].offset += base;
+  }
+
+  DOC_BITMAP* bitmap = (DOC_BITMAP*) malloc(sizeof(DOC_BITMAP));
+  MALLOC_CHECK(bitmap);
+
+  bitmap->length = base + builder->payloadsLength;
+  bitmap->owned = (unsigned char*) malloc(bitmap->length);
+  MALLOC_CHECK(bitmap->owned);
+
+  header.numContainers = (uint32_t) builder->numContainers;
+  header.cardinality = builder->cardinality;
+  memcpy(bitmap->owned, &header, sizeof(DOC_BITMAP_HEADER));
+  if (builder->numContainers > 0){
+    memcpy(bitmap->owned + sizeof(DOC_BITMAP_HEADER), builder->containers,
+        sizeof(DOC_BITMAP_CONTAINER) * builder->numContainers);
+  }
+  if (builder->payloadsLength > 0){
+    memcpy(bitmap->owned + base, builder->payloads, builder->payloadsLength);
+  }
+
+  bitmap->data = bitmap->owned;
+  bitmap->header = (const DOC_BITMAP_HEADER*) bitmap->data;
+  bitmap->containers = (const DOC_BITMAP_CONTAINER*) (bitmap->data + sizeof(DOC_BITMAP_HEADER));
+
+  free(builder->containers);
+  free(builder->payloads);
+  free(builder);
+
+  return bitmap;
+}
+
+// Checks that every container and its payload lie inside the bytes
+int openDocBitmap(DOC_BITMAP* bitmap, const unsigned char* data, size_t length){
+  const DOC_BITMAP_HEADER* header = (const DOC_BITMAP_HEADER*) data;
+  const DOC_BITMAP_CONTAINER* containers = (const DOC_BITMAP_CONTAINER*) (data + sizeof(DOC_BITMAP_HEADER));
+  uint32_t rank = 0;
+  int previousKey = -1;
+
+  if ((uintptr_t) data % 8 != 0 || length < sizeof(DOC_BITMAP_HEADER)
+      || (length - sizeof(DOC_BITMAP_HEADER)) / sizeof(DOC_BITMAP_CONTAINER) < header->numContainers){
+    return 0;
+  }
+
+  size_t base = sizeof(DOC_BITMAP_HEADER) + sizeof(DOC_BITMAP_CONTAINER) * (size_t) header->numContainers;
+
+  for (uint32_t c = 0; c < header->numContainers; c++){
+    const DOC_BITMAP_CONTAINER* container = &(containers[c]);
+    size_t bytes;
+
+    if (container->type == DOC_BITMAP_ARRAY){
+      bytes = 2 * (size_t) container->size;
+      if (container->size != container->cardinality || container->size > DOC_BITMAP_MAX_ARRAY){
+        return 0;
+      }
+    } else if (container->type == DOC_BITMAP_BITMAP){
+      bytes = sizeof(uint64_t) * DOC_BITMAP_WORDS;
+    } else if (container->type == DOC_BITMAP_RUN){
+      bytes = 4 * (size_t) container->size;
+      if (container->size > DOC_BITMAP_CHUNK_SIZE / 2){
+        return 0;
+      }
+    } else {
+      return 0;
+    }
+
+    if ((int) container->key <= previousKey
+        || container->rank != rank
+        || container->cardinality == 0 || container->cardinality > DOC_BITMAP_CHUNK_SIZE
+        || container->offset % 8 != 0 || container->offset < base
+        || container->offset > length || bytes > length - container->offset){
+      return 0;
+    }
+
+    previousKey = container->key;
+    rank += container->cardinality;
+  }
+
+  if (rank != header->cardinality){
+    return 0;
+  }
+
+  bitmap->header = header;
+  bitmap->containers = containers;
+  bitmap->data = data;
+  bitmap->length = length;
+  bitmap->owned = NULL;
+
+  return 1;
+}
+
+void freeDocBitmap(DOC_BITMAP* bitmap){
+  if (bitmap == NULL){
+    return;
+  }
+
+  free(bitmap->owned);
+  free(bitmap);
+}
+
+int docBitmapCardinality(const DOC_BITMAP* bitmap){
+  return (int) bitmap->header->cardinality;
+}
+
+// Binary search for the container of key, -1 if there is none
+static int findContainer(const DOC_BITMAP* bitmap, int key){
+  int low = 0;
+  int high = (int) bitmap->header->numContainers - 1;
+
+  while (low <= high){
+    int middle = low + (high - low) / 2;
+    int middleKey = bitmap->containers[middle].key;
+
+    if (middleKey == key){
+      return middle;
+    } else if (middleKey < key){
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  return -1;
+}
+
+int docBitmapRank(const DOC_BITMAP* bitmap, int documentId){
+  if (documentId < 0 || (documentId >> 16) > 0xFFFF){
+    return -1;
+  }
+
+  int c = findContainer(bitmap, documentId >> 16);
+  if (c < 0){
+    return -1;
+  }
+
+  const DOC_BITMAP_CONTAINER* container = &(bitmap->containers[c]);
+  const unsigned char* payload = bitmap->data + container->offset;
+  int low = documentId & 0xFFFF;
+
+  if (container->type == DOC_BITMAP_ARRAY){
+    const uint16_t* values = (const uint16_t*) payload;
+    int first = 0;
+    int last = (int) container->size - 1;
+
+    while (first <= last){
+      int middle = first + (last - first) / 2;
+
+      if (values[middle] == low){
+        return (int) container->rank + middle;
+      } else if (values[middle] < low){
+        first = middle + 1;
+      } else {
+        last = middle - 1;
+      }
+    }
+    return -1;
+  }
+
+  if (container->type == DOC_BITMAP_BITMAP){
+    const uint64_t* words = (const uint64_t*) payload;
+    uint64_t bit = (uint64_t) 1 << (low & 63);
+
+    if (!(words[low >> 6] & bit)){
+      return -1;
+    }
+
+    int count = __builtin_popcountll(words[low >> 6] & (bit - 1));
+    for (int w = 0; w < (low >> 6); w++){
+      count += __builtin_popcountll(words[w]);
+    }
+    return (int) container->rank + count;
+  }
+
+  const uint16_t* runs = (const uint16_t*) payload;
+  int count = 0;
+  for (uint32_t r = 0; r < container->size; r++){
+    int start = runs[2 * r];
+    int length = runs[2 * r + 1] + 1;
+
+    if (low < start){
+      return -1;
+    }
+    if (low < start + length){
+      return (int) container->rank + count + (low - start);
+    }
+    count += length;
+  }
+
+  return -1;
+}
+
+// Sets words to the bits of a container
+static void containerWords(const DOC_BITMAP* bitmap, const DOC_BITMAP_CONTAINER* container,
+    uint64_t* words){
+  const unsigned char* payload = bitmap->data + container->offset;
+
+  if (container->type == DOC_BITMAP_BITMAP){
+    memcpy(words, payload, sizeof(uint64_t) * DOC_BITMAP_WORDS);
+    return;
+  }
+
+  BZERO(words, sizeof(uint64_t) * DOC_BITMAP_WORDS);
+
+  if (container->type == DOC_BITMAP_ARRAY){
+    const uint16_t* values = (const uint16_t*) payload;
+    for (uint32_t i = 0; i < container->size; i++){
+      words[values[i] >> 6] |= (uint64_t) 1 << (values[i] & 63);
+    }
+  } else {
+    const uint16_t* runs = (const uint16_t*) payload;
+    for (uint32_t r = 0; r < container->size; r++){
+      setBits(words, runs[2 * r], runs[2 * r] + runs[2 * r + 1] + 1);
+    }
+  }
+}
+
+// Walks the containers of both bitmaps in key order and combines the
+// chunks they have with operation, one word at a time
+static DOC_BITMAP* combineBitmaps(const DOC_BITMAP* a, const DOC_BITMAP* b, int operation){
+  DOC_BITMAP_BUILDER* builder = newDocBitmapBuilder();
+  int numA = (int) a->header->numContainers;
+  int numB = (int) b->header->numContainers;
+  int i = 0;
+  int j = 0;
+
+  uint64_t* left = (uint64_t*) malloc(2 * sizeof(uint64_t) * DOC_BITMAP_WORDS);
+  MALLOC_CHECK(left);
+  uint64_t* right = left + DOC_BITMAP_WORDS;
+
+  while (i < numA || j < numB){
+    int keyA = i < numA ? a->containers[i].key : DOC_BITMAP_CHUNK_SIZE;
+    int keyB = j < numB ? b->containers[j].key : DOC_BITMAP_CHUNK_SIZE;
+    int key = keyA < keyB ? keyA : keyB;
+    int inA = keyA == key;
+    int inB = keyB == key;
+
+    // chunks that cannot have any ids in the result are skipped
+    if ((operation == BITMAP_AND && !(inA && inB)) || (operation == BITMAP_ANDNOT && !inA)){
+      i += inA;
+      j += inB;
+      continue;
+    }
+
+    if (inA){
+      containerWords(a, &(a->containers[i]), left);
+    } else {
+      BZERO(left, sizeof(uint64_t) * DOC_BITMAP_WORDS);
+    }
+
+    if (inB){
+      containerWords(b, &(b->containers[j]), right);
+    } else {
+      BZERO(right, sizeof(uint64_t) * DOC_BITMAP_WORDS);
+    }
+
+    if (operation == BITMAP_AND){
+      for (int w = 0; w < DOC_BITMAP_WORDS; w++){
+        left[w] &= right[w];
+      }
+    } else if (operation == BITMAP_OR){
+      for (int w = 0; w < DOC_BITMAP_WORDS; w++){
+        left[w] |= right[w];
+      }
+    } else {
+      for (int w = 0; w < DOC_BITMAP_WORDS; w++){
+        left[w] &= ~right[w];
+      }
+    }
+
+    addChunk(builder, key, left);
+    i += inA;
+    j += inB;
+  }
+
+  free(left);
+  return finishDocBitmap(builder);
+}
+
+DOC_BITMAP* docBitmapAnd(const DOC_BITMAP* a, const DOC_BITMAP* b){
+  return combineBitmaps(a, b, BITMAP_AND);
+}
+
+DOC_BITMAP* docBitmapOr(const DOC_BITMAP* a, const DOC_BITMAP* b){
+  return combineBitmaps(a, b, BITMAP_OR);
+}
+
+DOC_BITMAP* docBitmapAndNot(const DOC_BITMAP* a, const DOC_BITMAP* b){
+  return combineBitmaps(a, b, BITMAP_ANDNOT);
+}
+
+void startDocBitmapIds(DOC_BITMAP_ITERATOR* iterator){
+  iterator->container = 0;
+  iterator->position = 0;
+  iterator->offset = 0;
+}
+
+// Carries on in the current container, and moves on to the next one once
+// every id of it was read
+int readDocBitmapIds(const DOC_BITMAP* bitmap, DOC_BITMAP_ITERATOR* iterator,
+    int* ids, int maxIds){
+  int numIds = 0;
+
+  while (numIds < maxIds && iterator->container < (int) bitmap->header->numContainers){
+    const DOC_BITMAP_CONTAINER* container = &(bitmap->containers[iterator->container]);
+    const unsigned char* payload = bitmap->data + container->offset;
+    int base = (int) container->key << 16;
+    int done = 0;
+
+    if (container->type == DOC_BITMAP_ARRAY){
+      const uint16_t* values = (const uint16_t*) payload;
+
+      while (iterator->position < (int) container->size && numIds < maxIds){
+        ids[numIds++] = base + values[iterator->position++];
+      }
+      done = iterator->position >= (int) container->size;
+    } else if (container->type == DOC_BITMAP_BITMAP){
+      const uint64_t* words = (const uint64_t*) payload;
+
+      while (numIds < maxIds){
+        int bit = nextSetBit(words, iterator->position);
+        if (bit >= DOC_BITMAP_CHUNK_SIZE){
+          done = 1;
+          break;
+        }
+        ids[numIds++] = base + bit;
+        iterator->position = bit + 1;
+      }
+    } else {
+      const uint16_t* runs = (const uint16_t*) payload;
+
+      while (iterator->position < (int) container->size && numIds < maxIds){
+        int start = runs[2 * iterator->position];
+        int length = runs[2 * iterator->position + 1] + 1;
+
+        while (iterator->offset < length && numIds < maxIds){
+          ids[numIds++] = base + start + iterator->offset++;
+        }
+        if (iterator->offset >= length){
+          iterator->position++;
+          iterator->offset = 0;
+        }
+      }
+      done = iterator->position >= (int) container->size;
+    }
+
+    if (done){
+      iterator->container++;
+      iterator->position = 0;
+      iterator->offset = 0;
+    }
+  }
+
+  return numIds;
+}
+
+// Skips the containers that end before documentId (a binary search from
+// the current one), then the ids before it in its container
+void seekDocBitmapIds(const DOC_BITMAP* bitmap, DOC_BITMAP_ITERATOR* iterator, int documentId){
+  int numContainers = (int) bitmap->header->numContainers;
+  int key = documentId >> 16;
+  int low = documentId & 0xFFFF;
+
+  if (iterator->container >= numContainers || bitmap->containers[iterator->container].key > key){
+    return;
+  }
+
+  if (bitmap->containers[iterator->container].key < key){
+    int first = iterator->container + 1;
+    int last = numContainers;
+
+    while (first < last){
+      int middle = first + (last - first) / 2;
+      if (bitmap->containers[middle].key < key){
+        first = middle + 1;
+      } else {
+        last = middle;
+      }
+    }
+
+    iterator->container = first;
+    iterator->position = 0;
+    iterator->offset = 0;
+
+    if (first >= numContainers || bitmap->containers[first].key > key){
+      return;
+    }
+  }
+
+  const DOC_BITMAP_CONTAINER* container = &(bitmap->containers[iterator->container]);
+  const unsigned char* payload = bitmap->data + container->offset;
+
+  if (container->type == DOC_BITMAP_ARRAY){
+    const uint16_t* values = (const uint16_t*) payload;
+    int first = iterator->position;
+    int last = (int) container->size;
+
+    while (first < last){
+      int middle = first + (last - first) / 2;
+      if (values[middle] < low){
+        first = middle + 1;
+      } else {
+        last = middle;
+      }
+    }
+    iterator->position = first;
+  } else if (container->type == DOC_BITMAP_BITMAP){
+    if (iterator->position < low){
+      iterator->position = low;
+    }
+  } else {
+    const uint16_t* runs = (const uint16_t*) payload;
+
+    while (iterator->position < (int) container->size){
+      int start = runs[2 * iterator->position];
+      int length = runs[2 * iterator->position + 1] + 1;
+
+      if (start + length > low){
+        if (start + iterator->offset < low){
+          iterator->offset = low - start;
+        }
+        break;
+      }
+      iterator->position++;
+      iterator->offset = 0;
+    }
+  }
+}
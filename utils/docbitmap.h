@@ -0,0 +1,140 @@
+#ifndef _DOCBITMAP_H_
+#define _DOCBITMAP_H_
+
+// *****************Impementation Spec********************************
+// File: docbitmap.c
+// Author: Delos Chang
+// This file contains useful information for document bitmaps:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// A document bitmap is a compressed set of document ids (a roaring
+// bitmap). The ids are split into chunks of DOC_BITMAP_CHUNK_SIZE by
+// their high 16 bits, and each chunk with an id in it is kept in the
+// smallest of three containers:
+//
+//   array    the low 16 bits of its ids, sorted (a few ids)
+//   bitmap   one bit for each of the 65536 ids of the chunk (many ids)
+//   run      (start, length - 1) of each run of consecutive ids
+//
+// AND, OR and ANDNOT work a chunk at a time on 64 bit words, so a chunk
+// costs the same however many ids it has.
+//
+// A bitmap is built and stored as one run of bytes, in host byte order:
+//
+//   DOC_BITMAP_HEADER
+//   DOC_BITMAP_CONTAINER[numContainers]   sorted by key
+//   payloads                              each at an offset that is a multiple of 8
+//
+// so it can be used in place wherever it is, e.g. in a mapped index
+// file (see indexfile.h), as long as it starts at a multiple of 8.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// DEFINES
+
+// ids a container covers, and the 64 bit words of a bitmap container
+#define DOC_BITMAP_CHUNK_SIZE 65536
+#define DOC_BITMAP_WORDS (DOC_BITMAP_CHUNK_SIZE / 64)
+
+// an array container never has more ids than this (it would be larger
+// than a bitmap container)
+#define DOC_BITMAP_MAX_ARRAY 4096
+
+// container types
+#define DOC_BITMAP_ARRAY 0
+#define DOC_BITMAP_BITMAP 1
+#define DOC_BITMAP_RUN 2
+
+// DATA STRUCTURES
+
+typedef struct _DOC_BITMAP_HEADER {
+  uint32_t numContainers;
+  uint32_t cardinality;                 // ids in the bitmap
+} DOC_BITMAP_HEADER;
+
+typedef struct _DOC_BITMAP_CONTAINER {
+  uint16_t key;                         // high 16 bits of its ids
+  uint16_t type;                        // DOC_BITMAP_ARRAY, _BITMAP or _RUN
+  uint32_t cardinality;                 // ids in the container
+  uint32_t rank;                        // ids in the containers before it
+  uint32_t size;                        // ids of an array, runs of a run container
+  uint64_t offset;                      // of the payload from the start of the bitmap
+} DOC_BITMAP_CONTAINER;
+
+// a bitmap, built in memory or used in place
+typedef struct _DOC_BITMAP {
+  const DOC_BITMAP_HEADER *header;
+  const DOC_BITMAP_CONTAINER *containers;
+  const unsigned char *data;            // the bytes of the bitmap
+  size_t length;
+  unsigned char *owned;                 // data, if the bitmap was built in memory
+} DOC_BITMAP;
+
+// builds a bitmap from ids added in increasing order
+typedef struct _DOC_BITMAP_BUILDER {
+  DOC_BITMAP_CONTAINER *containers;
+  int numContainers;
+  int maxContainers;
+  unsigned char *payloads;
+  size_t payloadsLength;
+  size_t maxPayloads;
+  uint32_t cardinality;
+  int key;                              // chunk being filled, -1 if none
+  uint64_t words[DOC_BITMAP_WORDS];     // ids of that chunk
+} DOC_BITMAP_BUILDER;
+
+// where reading the ids of a bitmap in order is up to
+typedef struct _DOC_BITMAP_ITERATOR {
+  int container;                        // current container
+  int position;                         // id (array), bit (bitmap) or run (run) in it
+  int offset;                           // ids of the current run already read
+} DOC_BITMAP_ITERATOR;
+
+// function PROTOTYPES
+
+// newDocBitmapBuilder: creates a builder for an empty bitmap
+DOC_BITMAP_BUILDER* newDocBitmapBuilder();
+
+// addToDocBitmap: adds documentId, which is larger than every id added so far
+void addToDocBitmap(DOC_BITMAP_BUILDER* builder, int documentId);
+
+// finishDocBitmap: frees the builder and returns the (malloc'ed) bitmap
+DOC_BITMAP* finishDocBitmap(DOC_BITMAP_BUILDER* builder);
+
+// openDocBitmap: points bitmap at the length bytes of a stored bitmap,
+// which are used in place. Returns 0 if they are not a valid bitmap
+// starting at a multiple of 8
+int openDocBitmap(DOC_BITMAP* bitmap, const unsigned char* data, size_t length);
+
+// freeDocBitmap: frees a bitmap built in memory (not one that was opened)
+void freeDocBitmap(DOC_BITMAP* bitmap);
+
+// docBitmapCardinality: returns the number of ids in the bitmap
+int docBitmapCardinality(const DOC_BITMAP* bitmap);
+
+// docBitmapRank: returns how many ids of the bitmap are smaller than
+// documentId if it is in the bitmap, -1 if it is not
+int docBitmapRank(const DOC_BITMAP* bitmap, int documentId);
+
+// docBitmapAnd, docBitmapOr, docBitmapAndNot: return (malloc'ed) the
+// ids in both bitmaps, in either, or in a but not in b
+DOC_BITMAP* docBitmapAnd(const DOC_BITMAP* a, const DOC_BITMAP* b);
+DOC_BITMAP* docBitmapOr(const DOC_BITMAP* a, const DOC_BITMAP* b);
+DOC_BITMAP* docBitmapAndNot(const DOC_BITMAP* a, const DOC_BITMAP* b);
+
+// startDocBitmapIds: points the iterator before the first id
+void startDocBitmapIds(DOC_BITMAP_ITERATOR* iterator);
+
+// readDocBitmapIds: reads up to maxIds of the next ids of the bitmap, in
+// increasing order, into ids. Returns how many were read (0 at the end)
+int readDocBitmapIds(const DOC_BITMAP* bitmap, DOC_BITMAP_ITERATOR* iterator,
+    int* ids, int maxIds);
+
+// seekDocBitmapIds: moves the iterator on so that the next id read is the
+// first one that is at least documentId. It never moves back
+void seekDocBitmapIds(const DOC_BITMAP* bitmap, DOC_BITMAP_ITERATOR* iterator, int documentId);
+
+#endif
@@ -0,0 +1,367 @@
+/*
+
+FILE: dociterator.c
+Description: Walks the documents that match a query one at a time. Such as:
+
+0. Walking the postings of a word, skipping to a document
+1. Walking the documents dense words have in common from their bitmaps
+2. ANDing iterators by leapfrogging them to the same document, trying
+   the documents the blocks of the two shortest postings have in common
+3. ORing iterators by moving on the ones on the smallest document
+4. Adding up the frequencies and BM25 scores of the current document
+
+By: Delos Chang
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../utils/header.h"
+#include "intersect.h"
+#include "dociterator.h"
+
+// Creates an iterator of the given type, before its first document
+static DOC_ITERATOR* newDocIterator(int type, int cost){
+  DOC_ITERATOR* iterator = (DOC_ITERATOR*) malloc(sizeof(DOC_ITERATOR));
+  MALLOC_CHECK(iterator);
+  BZERO(iterator, sizeof(DOC_ITERATOR));
+
+  iterator->type = type;
+  iterator->documentId = -1;
+  iterator->cost = cost;
+
+  return iterator;
+}
+
+// Keeps its own copy of the array of children
+static void adoptChildren(DOC_ITERATOR* iterator, DOC_ITERATOR** children, int numChildren){
+  iterator->children = (DOC_ITERATOR**) malloc(sizeof(DOC_ITERATOR*) * numChildren);
+  MALLOC_CHECK(iterator->children);
+  memcpy(iterator->children, children, sizeof(DOC_ITERATOR*) * numChildren);
+  iterator->numChildren = numChildren;
+}
+
+DOC_ITERATOR* newPostingsIterator(const POSTINGS_CURSOR* cursor, int documentCount, float weight){
+  DOC_ITERATOR* iterator = newDocIterator(DOC_ITERATOR_POSTINGS, documentCount);
+
+  iterator->cursor = *cursor;
+  iterator->weight = weight;
+
+  return iterator;
+}
+
+// The words are ANDed a bitmap at a time, 64 documents to a word
+DOC_ITERATOR* newBitmapIterator(DOC_ITERATOR** words, int numWords){
+  DOC_BITMAP* documents = docBitmapAnd(&(words[0]->cursor.bitmap), &(words[1]->cursor.bitmap));
+
+  for (int i = 2; i < numWords; i++){
+    DOC_BITMAP* anded = docBitmapAnd(documents, &(words[i]->cursor.bitmap));
+    freeDocBitmap(documents);
+    documents = anded;
+  }
+
+  DOC_ITERATOR* iterator = newDocIterator(DOC_ITERATOR_BITMAP, docBitmapCardinality(documents));
+  iterator->bitmap = documents;
+  startDocBitmapIds(&(iterator->bitmapIds));
+  adoptChildren(iterator, words, numWords);
+
+  return iterator;
+}
+
+// The shortest child leads: the others are only advanced to its documents
+DOC_ITERATOR* newAndIterator(DOC_ITERATOR** children, int numChildren){
+  if (numChildren < 1){
+    fprintf(stderr, "Error: an AND iterator needs at least one child! \n");
+    exit(1);
+  }
+
+  DOC_ITERATOR* iterator = newDocIterator(DOC_ITERATOR_AND, 0);
+  adoptChildren(iterator, children, numChildren);
+
+  iterator->order = (int*) malloc(sizeof(int) * numChildren);
+  MALLOC_CHECK(iterator->order);
+
+  // insertion sort by cost: there are only as many children as words
+  for (int i = 0; i < numChildren; i++){
+    int j = i;
+    while (j > 0 && children[iterator->order[j - 1]]->cost > children[i]->cost){
+      iterator->order[j] = iterator->order[j - 1];
+      j--;
+    }
+    iterator->order[j] = i;
+  }
+  iterator->cost = children[iterator->order[0]]->cost;
+
+  // the two shortest postings children, whose blocks are intersected
+  int numPair = 0;
+  iterator->pair[0] = -1;
+  iterator->pair[1] = -1;
+  for (int i = 0; i < numChildren && numPair < 2; i++){
+    if (children[iterator->order[i]]->type == DOC_ITERATOR_POSTINGS){
+      iterator->pair[numPair++] = iterator->order[i];
+    }
+  }
+  if (numPair < 2){
+    iterator->pair[0] = -1;
+  }
+  iterator->checkedTo = -1;
+
+  return iterator;
+}
+
+DOC_ITERATOR* newOrIterator(DOC_ITERATOR** children, int numChildren){
+  DOC_ITERATOR* iterator = newDocIterator(DOC_ITERATOR_OR, 0);
+  adoptChildren(iterator, children, numChildren);
+
+  for (int i = 0; i < numChildren; i++){
+    iterator->cost += children[i]->cost;
+  }
+
+  return iterator;
+}
+
+// Advances the children of an AND in turn to the largest document one of
+// them is on, until they all agree on one. The leading child is already
+// on documentId
+static int leapfrog(DOC_ITERATOR* iterator, int documentId){
+  int agreed = 1;
+  int i = 1 % iterator->numChildren;
+
+  while (documentId != DOC_ITERATOR_END && agreed < iterator->numChildren){
+    int found = advanceDocIterator(iterator->children[iterator->order[i]], documentId);
+
+    if (found == documentId){
+      agreed++;
+    } else {
+      documentId = found;
+      agreed = 1;
+    }
+    i = (i + 1) % iterator->numChildren;
+  }
+
+  iterator->documentId = documentId;
+  return documentId;
+}
+
+// Intersects what is left of the decoded blocks of the pair of an AND,
+// which are both on its document, with the intersect kernel. The
+// documents after it that both have up to the end of the shorter block
+// are all in ids, so the AND only has to try those before checkedTo
+static void intersectPairBlocks(DOC_ITERATOR* iterator){
+  int aMatches[POSTINGS_BLOCK_SIZE];
+  int bMatches[POSTINGS_BLOCK_SIZE];
+
+  iterator->numIds = 0;
+  iterator->nextId = 0;
+  iterator->checkedTo = iterator->documentId;
+
+  if (iterator->pair[0] < 0){
+    return;
+  }
+
+  const POSTINGS_CURSOR* a = &(iterator->children[iterator->pair[0]]->cursor);
+  const POSTINGS_CURSOR* b = &(iterator->children[iterator->pair[1]]->cursor);
+
+  // (nothing is left of a block, or the postings are in a tail of varints)
+  if (a->buffered == 0 || b->buffered == 0){
+    return;
+  }
+
+  const int* aIds = a->blockDocumentIds + POSTINGS_BLOCK_SIZE - a->buffered;
+  const int* bIds = b->blockDocumentIds + POSTINGS_BLOCK_SIZE - b->buffered;
+  int numMatches = intersectDocumentIds(aIds, a->buffered, bIds, b->buffered,
+      aMatches, bMatches);
+
+  for (int k = 0; k < numMatches; k++){
+    iterator->ids[k] = aIds[aMatches[k]];
+  }
+  iterator->numIds = numMatches;
+
+  int aLast = aIds[a->buffered - 1];
+  int bLast = bIds[b->buffered - 1];
+  iterator->checkedTo = aLast < bLast ? aLast : bLast;
+}
+
+// Moves an AND to its first document that is at least documentId. The
+// documents both blocks of the pair have are tried first; once they run
+// out, none is left before checkedTo, so the leading child skips past it
+static int nextAndDocument(DOC_ITERATOR* iterator, int documentId){
+  int target = documentId > iterator->checkedTo ? documentId : iterator->checkedTo + 1;
+
+  while (iterator->nextId < iterator->numIds && iterator->ids[iterator->nextId] < documentId){
+    iterator->nextId++;
+  }
+  if (iterator->nextId < iterator->numIds){
+    target = iterator->ids[iterator->nextId++];
+  }
+
+  leapfrog(iterator, advanceDocIterator(iterator->children[iterator->order[0]], target));
+
+  // every child is on the document: the blocks are intersected again
+  // once what was found in them is used up
+  if (iterator->documentId != DOC_ITERATOR_END
+      && (iterator->nextId == iterator->numIds || iterator->documentId >= iterator->checkedTo)){
+    intersectPairBlocks(iterator);
+  }
+
+  return iterator->documentId;
+}
+
+// The smallest document any child of an OR is on
+static int smallestChild(DOC_ITERATOR* iterator){
+  int documentId = DOC_ITERATOR_END;
+
+  for (int i = 0; i < iterator->numChildren; i++){
+    if (iterator->children[i]->documentId < documentId){
+      documentId = iterator->children[i]->documentId;
+    }
+  }
+
+  iterator->documentId = documentId;
+  return documentId;
+}
+
+// Returns the next id of the bitmap, reading them a block at a time
+static int nextBitmapDocument(DOC_ITERATOR* iterator){
+  if (iterator->nextId == iterator->numIds){
+    iterator->numIds = readDocBitmapIds(iterator->bitmap, &(iterator->bitmapIds),
+        iterator->ids, POSTINGS_BLOCK_SIZE);
+    iterator->nextId = 0;
+
+    if (iterator->numIds == 0){
+      return DOC_ITERATOR_END;
+    }
+  }
+
+  return iterator->ids[iterator->nextId++];
+}
+
+int nextDocIterator(DOC_ITERATOR* iterator){
+  if (iterator->documentId == DOC_ITERATOR_END){
+    return DOC_ITERATOR_END;
+  }
+
+  switch (iterator->type){
+    case DOC_ITERATOR_POSTINGS:
+      iterator->documentId = nextPosting(&(iterator->cursor))
+        ? iterator->cursor.documentId : DOC_ITERATOR_END;
+      return iterator->documentId;
+
+    case DOC_ITERATOR_BITMAP:
+      iterator->documentId = nextBitmapDocument(iterator);
+      return iterator->documentId;
+
+    case DOC_ITERATOR_AND:
+      return nextAndDocument(iterator, iterator->documentId + 1);
+
+    default:
+      // the children on the current document (all of them before the
+      // first) move on
+      for (int i = 0; i < iterator->numChildren; i++){
+        if (iterator->children[i]->documentId == iterator->documentId){
+          nextDocIterator(iterator->children[i]);
+        }
+      }
+      return smallestChild(iterator);
+  }
+}
+
+int advanceDocIterator(DOC_ITERATOR* iterator, int documentId){
+  if (iterator->documentId >= documentId){
+    return iterator->documentId;
+  }
+
+  switch (iterator->type){
+    case DOC_ITERATOR_POSTINGS:
+      iterator->documentId = advancePosting(&(iterator->cursor), documentId)
+        ? iterator->cursor.documentId : DOC_ITERATOR_END;
+      return iterator->documentId;
+
+    case DOC_ITERATOR_BITMAP:
+      // ids read already are skipped; past them the bitmap seeks
+      if (iterator->nextId < iterator->numIds && iterator->ids[iterator->numIds - 1] >= documentId){
+        while (iterator->ids[iterator->nextId] < documentId){
+          iterator->nextId++;
+        }
+      } else {
+        seekDocBitmapIds(iterator->bitmap, &(iterator->bitmapIds), documentId);
+        iterator->numIds = 0;
+        iterator->nextId = 0;
+      }
+      iterator->documentId = nextBitmapDocument(iterator);
+      return iterator->documentId;
+
+    case DOC_ITERATOR_AND:
+      return nextAndDocument(iterator, documentId);
+
+    default:
+      for (int i = 0; i < iterator->numChildren; i++){
+        advanceDocIterator(iterator->children[i], documentId);
+      }
+      return smallestChild(iterator);
+  }
+}
+
+// Adds the frequencies (and the scores, with a scorer) of the words whose
+// postings are on documentId. The children of an AND that is not on it
+// may be, but it did not match
+static int addDocument(DOC_ITERATOR* iterator, int documentId, BM25_SCORER* scorer){
+  if (iterator->documentId != documentId){
+    return 0;
+  }
+
+  if (iterator->type == DOC_ITERATOR_POSTINGS){
+    if (scorer != NULL){
+      addDocumentScore(scorer, iterator->weight, documentId, iterator->cursor.frequency);
+    }
+    return iterator->cursor.frequency;
+  }
+
+  int frequency = 0;
+  for (int i = 0; i < iterator->numChildren; i++){
+    DOC_ITERATOR* child = iterator->children[i];
+
+    // the words of a bitmap are only brought to its documents now
+    if (iterator->type == DOC_ITERATOR_BITMAP){
+      advanceDocIterator(child, documentId);
+    }
+    frequency += addDocument(child, documentId, scorer);
+  }
+
+  return frequency;
+}
+
+int docIteratorFrequency(DOC_ITERATOR* iterator){
+  if (iterator->documentId < 0 || iterator->documentId == DOC_ITERATOR_END){
+    return 0;
+  }
+  return addDocument(iterator, iterator->documentId, NULL);
+}
+
+double scoreDocIterator(DOC_ITERATOR* iterator, BM25_SCORER* scorer){
+  if (iterator->documentId < 0 || iterator->documentId == DOC_ITERATOR_END){
+    return 0;
+  }
+  addDocument(iterator, iterator->documentId, scorer);
+  return getScore(scorer, iterator->documentId);
+}
+
+int isDenseIterator(const DOC_ITERATOR* iterator){
+  return iterator->type == DOC_ITERATOR_POSTINGS && iterator->cursor.bitmap.header != NULL;
+}
+
+void freeDocIterator(DOC_ITERATOR* iterator){
+  if (iterator == NULL){
+    return;
+  }
+
+  for (int i = 0; i < iterator->numChildren; i++){
+    freeDocIterator(iterator->children[i]);
+  }
+  free(iterator->children);
+  free(iterator->order);
+  freeDocBitmap(iterator->bitmap);
+  free(iterator);
+}
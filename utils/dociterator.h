@@ -0,0 +1,118 @@
+#ifndef _DOCITERATOR_H_
+#define _DOCITERATOR_H_
+
+// *****************Impementation Spec********************************
+// File: dociterator.c
+// Author: Delos Chang
+// This file contains useful information for document iterators:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// A document iterator walks the documents that match (part of) a query
+// in increasing order, one document at a time:
+//
+//   postings   the documents of one word, straight out of its postings
+//   bitmap     the documents of dense words ANDed as document bitmaps
+//   and        the documents every child iterator is on
+//   or         the documents any child iterator is on
+//
+// nextDocIterator moves on to the next document and advanceDocIterator to
+// the first one at or past a given id, which lets an AND skip the
+// documents of its longer children that its shortest child does not
+// have. The frequency and the BM25 score of the current document are
+// those of the words whose iterators are on it.
+//
+// An AND with two or more postings children also intersects the decoded
+// blocks of the two shortest ones with the vector kernels of intersect.h
+// whenever it lands on a document, and then only tries the documents
+// both blocks have.
+//
+// Nothing is allocated while iterating: a query only makes the
+// iterators and whatever it keeps of the documents they find.
+
+#include <limits.h>
+
+#include "postings.h"
+#include "docbitmap.h"
+#include "bm25.h"
+
+// DEFINES
+
+// the document of an iterator that has none left
+#define DOC_ITERATOR_END INT_MAX
+
+// iterator types
+#define DOC_ITERATOR_POSTINGS 0
+#define DOC_ITERATOR_BITMAP 1
+#define DOC_ITERATOR_AND 2
+#define DOC_ITERATOR_OR 3
+
+// DATA STRUCTURES
+
+typedef struct _DOC_ITERATOR {
+  int type;
+  int documentId;                         // current document, -1 before the first
+                                          // and DOC_ITERATOR_END after the last
+  int cost;                               // the most documents it can match
+  POSTINGS_CURSOR cursor;                 // postings: the word's postings
+  float weight;                           // postings: BM25 weight of the word
+  DOC_BITMAP* bitmap;                     // bitmap: the documents
+  DOC_BITMAP_ITERATOR bitmapIds;          // bitmap: where reading them is up to
+  int ids[POSTINGS_BLOCK_SIZE];           // bitmap: the ids read but not returned;
+                                          // and: the documents left in both blocks
+  int numIds;
+  int nextId;
+  struct _DOC_ITERATOR **children;        // and, or: the iterators combined;
+  int numChildren;                        // bitmap: those of the dense words
+  int *order;                             // and: children by increasing cost
+  int pair[2];                            // and: the two shortest postings children
+                                          // (-1 if it has fewer)
+  int checkedTo;                          // and: the blocks of the pair were
+                                          // intersected up to this document
+} DOC_ITERATOR;
+
+// function PROTOTYPES
+
+// newPostingsIterator: creates an iterator over the postings the cursor
+// is before, of a word found in documentCount documents with the given
+// BM25 weight (see bm25Weight, 0 if there is no scorer)
+DOC_ITERATOR* newPostingsIterator(const POSTINGS_CURSOR* cursor, int documentCount, float weight);
+
+// newBitmapIterator: creates an iterator over the documents all of the
+// dense words have, ANDing the document bitmaps of their postings
+// iterators. It frees words, which are only advanced to its documents to
+// read their frequencies
+DOC_ITERATOR* newBitmapIterator(DOC_ITERATOR** words, int numWords);
+
+// newAndIterator, newOrIterator: create an iterator over the documents
+// all, or any, of the children have. They free the children. An AND
+// needs at least one child
+DOC_ITERATOR* newAndIterator(DOC_ITERATOR** children, int numChildren);
+DOC_ITERATOR* newOrIterator(DOC_ITERATOR** children, int numChildren);
+
+// nextDocIterator: moves to the next document and returns it
+// (DOC_ITERATOR_END if there is none)
+int nextDocIterator(DOC_ITERATOR* iterator);
+
+// advanceDocIterator: moves to the first document that is at least
+// documentId and returns it (DOC_ITERATOR_END if there is none). It
+// stays put if it is on one already
+int advanceDocIterator(DOC_ITERATOR* iterator, int documentId);
+
+// docIteratorFrequency: returns the sum of the frequencies in the current
+// document of the words whose iterators are on it
+int docIteratorFrequency(DOC_ITERATOR* iterator);
+
+// scoreDocIterator: adds the BM25 scores of those words to the current
+// document in scorer and returns its score
+double scoreDocIterator(DOC_ITERATOR* iterator, BM25_SCORER* scorer);
+
+// isDenseIterator: returns 1 if the iterator is over the postings of a
+// dense word, whose documents are in a document bitmap
+int isDenseIterator(const DOC_ITERATOR* iterator);
+
+// freeDocIterator: frees the iterator and its children
+void freeDocIterator(DOC_ITERATOR* iterator);
+
+#endif
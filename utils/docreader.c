@@ -0,0 +1,254 @@
+/*
+
+FILE: docreader.c
+Description: Loads the crawled pages ahead of the indexer. Such as:
+
+0. Opening the upcoming pages (or the page store) and advising the kernel
+   to read them ahead
+1. Loading pages on a reader thread into a bounded queue
+2. Handing the pages to the indexer in document order
+3. Reporting how long each stage waited on the other
+
+By: Delos Chang
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "../utils/header.h"
+#include "docreader.h"
+#include "file.h"
+#include "pagestore.h"
+
+// seconds since some fixed point
+static double now(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Opens the page of documentId and lets the kernel start reading it
+static int openDocument(DOCUMENT_READER* reader, int documentId){
+  char* filepath = NULL;
+  char name[32];
+
+  snprintf(name, sizeof(name), "%d", documentId);
+  filepath = createFilepath(filepath, reader->dir, name);
+
+  int fd = open(filepath, O_RDONLY);
+
+  // If unable to find file, skip.
+  // Could be problem of skipped files i.e. (1, 3, 4, 5)
+  if (fd < 0){
+    fprintf(stderr, "Could not read file %s. Aborting. \n", filepath);
+    exit(1);
+  }
+
+#ifdef POSIX_FADV_WILLNEED
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+
+  free(filepath);
+  return fd;
+}
+
+// Reads the whole file into a NUL terminated buffer and closes it. Like
+// loadDocument, an empty or unreadable file aborts
+static char* readDocument(int fd){
+  struct stat st;
+
+  if (fstat(fd, &st) != 0){
+    fprintf(stderr, "Error: file size not valid \n");
+    exit(1);
+  }
+
+  char* html = (char*) malloc(sizeof(char) * (st.st_size + 2)); // +1 for terminal byte
+  MALLOC_CHECK(html);
+
+  size_t readResult = 0;
+  while (readResult < (size_t) st.st_size){
+    ssize_t length = read(fd, html + readResult, st.st_size - readResult);
+    if (length <= 0){
+      break;
+    }
+    readResult += length;
+  }
+
+  if (readResult == 0){
+    fprintf(stderr, "Error reading the file into buffer. Aborting. \n");
+    exit(1);
+  }
+
+  html[readResult] = '\0'; // add terminal byte
+  close(fd);
+
+  return html;
+}
+
+// Loads documentId from the file opened for it, and opens the page window
+// documents further on in its place. From a page store, the page is read
+// from its record
+static char* loadNextDocument(DOCUMENT_READER* reader, int documentId){
+  if (reader->store != NULL){
+    char* html = readPage(reader->store, documentId);
+
+    if (html == NULL){
+      fprintf(stderr, "Could not read page %d of the page store of %s. Aborting. \n",
+          documentId, reader->dir);
+      exit(1);
+    }
+    return html;
+  }
+
+  int slot = (documentId - reader->first) % reader->window;
+  char* html = readDocument(reader->files[slot]);
+
+  if (documentId + reader->window <= reader->last){
+    reader->files[slot] = openDocument(reader, documentId + reader->window);
+  }
+
+  return html;
+}
+
+// The reader thread: loads every document and queues it, waiting while
+// the queue is full
+static void* readDocuments(void* argument){
+  DOCUMENT_READER* reader = (DOCUMENT_READER*) argument;
+
+  for (int documentId = reader->first; documentId <= reader->last; documentId++){
+    char* html = loadNextDocument(reader, documentId);
+
+    pthread_mutex_lock(&(reader->lock));
+
+    if (reader->queued == reader->window){
+      double start = now();
+      while (reader->queued == reader->window){
+        pthread_cond_wait(&(reader->notFull), &(reader->lock));
+      }
+      reader->readerIdle += now() - start;
+    }
+
+    reader->queue[(reader->queueStart + reader->queued) % reader->window] = html;
+    reader->queued++;
+
+    pthread_cond_signal(&(reader->notEmpty));
+    pthread_mutex_unlock(&(reader->lock));
+  }
+
+  return NULL;
+}
+
+// Opens the first window pages and starts the reader thread
+DOCUMENT_READER* startDocumentReader(char* dir, int first, int last, int window){
+  DOCUMENT_READER* reader = (DOCUMENT_READER*) malloc(sizeof(DOCUMENT_READER));
+  MALLOC_CHECK(reader);
+  BZERO(reader, sizeof(DOCUMENT_READER));
+
+  reader->dir = dir;
+  reader->first = first;
+  reader->last = last;
+  reader->window = window > 0 ? window : 1;
+  reader->nextDocument = first;
+
+  reader->files = (int*) malloc(sizeof(int) * reader->window);
+  reader->queue = (char**) malloc(sizeof(char*) * reader->window);
+  MALLOC_CHECK(reader->files);
+  MALLOC_CHECK(reader->queue);
+
+  // the pages of a page store are one run of the file, read ahead at once
+  reader->store = openPageStore(dir);
+
+  if (reader->store != NULL && first <= last && first >= 1 && first <= reader->store->numPages){
+#ifdef POSIX_FADV_WILLNEED
+    PAGE_STORE* store = reader->store;
+    uint64_t end = last < store->numPages ? store->offsets[last] : store->end;
+
+    posix_fadvise(store->fd, (off_t) store->offsets[first - 1],
+        (off_t) (end - store->offsets[first - 1]), POSIX_FADV_WILLNEED);
+#endif
+  }
+
+  for (int documentId = first; reader->store == NULL && documentId <= last
+      && documentId < first + reader->window; documentId++){
+    reader->files[documentId - first] = openDocument(reader, documentId);
+  }
+
+  pthread_mutex_init(&(reader->lock), NULL);
+  pthread_cond_init(&(reader->notEmpty), NULL);
+  pthread_cond_init(&(reader->notFull), NULL);
+
+  // if no thread can be started, nextDocument loads the pages itself
+  reader->threaded = first <= last
+    && !pthread_create(&(reader->thread), NULL, readDocuments, reader);
+
+  return reader;
+}
+
+// Takes the next page off the queue, waiting while it is empty
+char* nextDocument(DOCUMENT_READER* reader, int* documentId){
+  char* html;
+
+  if (reader->nextDocument > reader->last){
+    return NULL;
+  }
+
+  if (!reader->threaded){
+    html = loadNextDocument(reader, reader->nextDocument);
+  } else {
+    pthread_mutex_lock(&(reader->lock));
+
+    if (reader->queued == 0){
+      double start = now();
+      while (reader->queued == 0){
+        pthread_cond_wait(&(reader->notEmpty), &(reader->lock));
+      }
+      reader->indexerIdle += now() - start;
+    }
+
+    html = reader->queue[reader->queueStart];
+    reader->queueStart = (reader->queueStart + 1) % reader->window;
+    reader->queued--;
+
+    pthread_cond_signal(&(reader->notFull));
+    pthread_mutex_unlock(&(reader->lock));
+  }
+
+  *documentId = reader->nextDocument++;
+  return html;
+}
+
+// Hands out whatever the indexer did not take, so that the reader can
+// finish, then reports the idle times
+void stopDocumentReader(DOCUMENT_READER* reader){
+  char* html;
+  int documentId;
+
+  while ((html = nextDocument(reader, &documentId)) != NULL){
+    free(html);
+  }
+
+  if (reader->threaded){
+    pthread_join(reader->thread, NULL);
+  }
+
+  printf("Documents %d-%d: reader idle %.3f s (queue full), indexer idle %.3f s (queue empty)\n",
+      reader->first, reader->last, reader->readerIdle, reader->indexerIdle);
+
+  pthread_mutex_destroy(&(reader->lock));
+  pthread_cond_destroy(&(reader->notEmpty));
+  pthread_cond_destroy(&(reader->notFull));
+
+  closePageStore(reader->store);
+  free(reader->files);
+  free(reader->queue);
+  free(reader);
+}
@@ -0,0 +1,75 @@
+#ifndef _DOCREADER_H_
+#define _DOCREADER_H_
+
+// *****************Impementation Spec********************************
+// File: docreader.c
+// Author: Delos Chang
+// This file contains useful information for the document reader:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// A document reader loads the crawled pages first to last of a directory
+// on a thread of its own, so that the indexer does not wait on every
+// read. It keeps a window of upcoming files open and asks the kernel to
+// read them ahead (posix_fadvise WILLNEED), which puts up to window reads
+// in flight at once. Loaded pages go into a queue of at most window
+// pages that the indexer takes them from, in document order.
+//
+// Both stages keep track of how long they sit idle: the reader when the
+// queue is full (the indexer is the bottleneck) and the indexer when it
+// is empty (the disk is).
+//
+// If the directory has a page store (see pagestore.h), the pages are read
+// from its records instead, and the kernel is asked to read the records
+// of the whole range ahead.
+//
+// If no thread can be started, the pages are loaded on demand instead.
+
+#include <pthread.h>
+
+#include "pagestore.h"
+
+// DEFINES
+
+// pages kept open and loaded ahead by a reader when nothing else is said
+#define DOCUMENT_READER_WINDOW 64
+
+// DATA STRUCTURES
+
+typedef struct _DOCUMENT_READER {
+  char *dir;                        // directory of the pages
+  int first;                        // first and last document to load
+  int last;
+  int window;                       // pages open or queued at most
+  int *files;                       // open files of the next window pages
+  PAGE_STORE *store;                // page store of dir (NULL if the pages are in files)
+  char **queue;                     // loaded pages, a ring of window slots
+  int queueStart;                   // slot of the next page to hand out
+  int queued;                       // pages in the queue
+  int nextDocument;                 // document handed out next
+  int threaded;                     // 1 if the pages are loaded by thread
+  pthread_t thread;
+  pthread_mutex_t lock;             // guards the queue
+  pthread_cond_t notEmpty;          // signalled when a page is queued
+  pthread_cond_t notFull;           // signalled when a page is taken
+  double readerIdle;                // seconds the reader waited on a full queue
+  double indexerIdle;               // seconds the indexer waited on an empty queue
+} DOCUMENT_READER;
+
+// function PROTOTYPES
+
+// startDocumentReader: starts loading the documents first to last of dir,
+// with at most window of them open or queued at a time
+DOCUMENT_READER* startDocumentReader(char* dir, int first, int last, int window);
+
+// nextDocument: returns the next document (to be freed by the caller) and
+// stores its id in documentId, or returns NULL once every document was
+// handed out. Waits for the reader if the document is not loaded yet
+char* nextDocument(DOCUMENT_READER* reader, int* documentId);
+
+// stopDocumentReader: waits for the reader to finish, prints how long
+// each stage sat idle and frees the reader
+void stopDocumentReader(DOCUMENT_READER* reader);
+
+#endif
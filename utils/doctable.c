@@ -0,0 +1,264 @@
+/*
+
+FILE: doctable.c
+Description: Records the URL, depth and length of every document. Such as:
+
+0. Recording each page as the indexer reads it
+1. Saving the table next to the results file
+2. Mapping the table and looking documents up by id
+
+By: Delos Chang
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../utils/header.h"
+#include "doctable.h"
+
+char* docTablePath(char* indexFile){
+  char* path = (char*) malloc(strlen(indexFile) + strlen(DOC_TABLE_SUFFIX) + 1);
+  MALLOC_CHECK(path);
+
+  sprintf(path, "%s%s", indexFile, DOC_TABLE_SUFFIX);
+  return path;
+}
+
+DOC_TABLE* newDocTable(int numDocuments){
+  DOC_TABLE* docTable = (DOC_TABLE*) malloc(sizeof(DOC_TABLE));
+  MALLOC_CHECK(docTable);
+  BZERO(docTable, sizeof(DOC_TABLE));
+
+  docTable->numDocuments = numDocuments;
+  docTable->entries = (DOC_TABLE_ENTRY*) calloc(numDocuments + 1, sizeof(DOC_TABLE_ENTRY));
+  docTable->urls = (char**) calloc(numDocuments + 1, sizeof(char*));
+  MALLOC_CHECK(docTable->entries);
+  MALLOC_CHECK(docTable->urls);
+
+  return docTable;
+}
+
+// The URL is the first line of the page and the depth the second
+void recordDocument(DOC_TABLE* docTable, int documentId, const char* page){
+  if (documentId < 1 || documentId > docTable->numDocuments){
+    return;
+  }
+
+  const char* urlEnd = strchr(page, '\n');
+  size_t urlLength = urlEnd != NULL ? (size_t) (urlEnd - page) : strlen(page);
+
+  char* url = (char*) malloc(urlLength + 1);
+  MALLOC_CHECK(url);
+  memcpy(url, page, urlLength);
+  url[urlLength] = '\0';
+
+  free(docTable->urls[documentId - 1]);
+  docTable->urls[documentId - 1] = url;
+  docTable->entries[documentId - 1].urlLength = (uint32_t) urlLength;
+  docTable->entries[documentId - 1].depth = urlEnd != NULL ? (uint32_t) atoi(urlEnd + 1) : 0;
+}
+
+void recordDocumentWords(DOC_TABLE* docTable, int documentId, int numWords){
+  if (documentId >= 1 && documentId <= docTable->numDocuments){
+    docTable->entries[documentId - 1].numWords = (uint32_t) numWords;
+  }
+}
+
+void copyDocument(DOC_TABLE* docTable, DOC_TABLE* from, int documentId){
+  const char* url = getDocumentURL(from, documentId);
+
+  if (url == NULL || documentId > docTable->numDocuments){
+    return;
+  }
+
+  char* copy = (char*) malloc(strlen(url) + 1);
+  MALLOC_CHECK(copy);
+  strcpy(copy, url);
+
+  free(docTable->urls[documentId - 1]);
+  docTable->urls[documentId - 1] = copy;
+  docTable->entries[documentId - 1] = from->entries[documentId - 1];
+}
+
+// writes size bytes to fp or aborts
+static void writeOrDie(const void* data, size_t size, FILE* fp, char* path){
+  if (size && fwrite(data, 1, size, fp) != size){
+    fprintf(stderr, "Error writing to the file %s \n", path);
+    exit(1);
+  }
+}
+
+// The URLs are laid out in document order, each one after the last
+void saveDocTable(DOC_TABLE* docTable, char* path){
+  DOC_TABLE_HEADER header;
+  uint64_t stringsSize = 0;
+  FILE* fp;
+
+  docTable->numIndexed = 0;
+  docTable->totalWords = 0;
+
+  for (int i = 0; i < docTable->numDocuments; i++){
+    docTable->entries[i].urlOffset = (uint32_t) stringsSize;
+    stringsSize += docTable->entries[i].urlLength + 1;
+
+    if (docTable->entries[i].urlLength > 0){
+      docTable->numIndexed++;
+      docTable->totalWords += docTable->entries[i].numWords;
+    }
+  }
+
+  BZERO(&header, sizeof(DOC_TABLE_HEADER));
+  memcpy(header.magic, DOC_TABLE_MAGIC, DOC_TABLE_MAGIC_LENGTH);
+  header.version = DOC_TABLE_VERSION;
+  header.numDocuments = (uint32_t) docTable->numDocuments;
+  header.stringsOffset = sizeof(DOC_TABLE_HEADER)
+    + (uint64_t) docTable->numDocuments * sizeof(DOC_TABLE_ENTRY);
+  header.fileSize = header.stringsOffset + stringsSize;
+  header.totalWords = docTable->totalWords;
+  header.numIndexed = (uint32_t) docTable->numIndexed;
+
+  fp = fopen(path, "w");
+  if (fp == NULL){
+    fprintf(stderr, "Error writing to the file %s", path);
+    exit(1);
+  }
+
+  writeOrDie(&header, sizeof(DOC_TABLE_HEADER), fp, path);
+  writeOrDie(docTable->entries, sizeof(DOC_TABLE_ENTRY) * docTable->numDocuments, fp, path);
+
+  for (int i = 0; i < docTable->numDocuments; i++){
+    const char* url = docTable->urls[i] != NULL ? docTable->urls[i] : "";
+    writeOrDie(url, docTable->entries[i].urlLength + 1, fp, path);
+  }
+
+  if (fclose(fp) != 0){
+    fprintf(stderr, "Error writing to the file %s \n", path);
+    exit(1);
+  }
+}
+
+// Maps the file and checks that every URL lies inside the mapping
+DOC_TABLE* openDocTable(char* path){
+  const DOC_TABLE_HEADER* header;
+  struct stat st;
+  void* map;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0){
+    return NULL;
+  }
+
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(DOC_TABLE_HEADER)){
+    fprintf(stderr, "Warning: %s is too small to be a document table \n", path);
+    close(fd);
+    return NULL;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps its own reference
+
+  if (map == MAP_FAILED){
+    fprintf(stderr, "Warning: could not map the document table %s \n", path);
+    return NULL;
+  }
+
+  header = (const DOC_TABLE_HEADER*) map;
+
+  // validate the header before trusting any offsets in it
+  if (memcmp(header->magic, DOC_TABLE_MAGIC, DOC_TABLE_MAGIC_LENGTH) != 0
+    || header->version != DOC_TABLE_VERSION
+    || header->fileSize != (uint64_t) st.st_size
+    || header->stringsOffset != sizeof(DOC_TABLE_HEADER)
+      + (uint64_t) header->numDocuments * sizeof(DOC_TABLE_ENTRY)
+    || header->stringsOffset > header->fileSize
+    || header->numIndexed > header->numDocuments){
+    fprintf(stderr, "Warning: %s is not a valid version %d document table \n", path,
+        DOC_TABLE_VERSION);
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  DOC_TABLE* docTable = (DOC_TABLE*) malloc(sizeof(DOC_TABLE));
+  MALLOC_CHECK(docTable);
+  BZERO(docTable, sizeof(DOC_TABLE));
+
+  docTable->map = (const unsigned char*) map;
+  docTable->size = (size_t) st.st_size;
+  docTable->numDocuments = (int) header->numDocuments;
+  docTable->numIndexed = (int) header->numIndexed;
+  docTable->totalWords = header->totalWords;
+  docTable->entries = (DOC_TABLE_ENTRY*) (docTable->map + sizeof(DOC_TABLE_HEADER));
+  docTable->strings = (const char*) (docTable->map + header->stringsOffset);
+
+  return docTable;
+}
+
+// A URL that would run past the end of the mapping is not known
+const char* getDocumentURL(DOC_TABLE* docTable, int documentId){
+  if (docTable == NULL || documentId < 1 || documentId > docTable->numDocuments){
+    return NULL;
+  }
+
+  const DOC_TABLE_ENTRY* entry = &(docTable->entries[documentId - 1]);
+  if (entry->urlLength == 0){
+    return NULL;
+  }
+
+  if (docTable->map == NULL){
+    return docTable->urls[documentId - 1];
+  }
+
+  uint64_t end = (uint64_t) (docTable->strings - (const char*) docTable->map)
+    + entry->urlOffset + entry->urlLength;
+  if (end >= docTable->size || docTable->strings[entry->urlOffset + entry->urlLength] != '\0'){
+    return NULL;
+  }
+
+  return docTable->strings + entry->urlOffset;
+}
+
+int getDocumentDepth(DOC_TABLE* docTable, int documentId){
+  if (getDocumentURL(docTable, documentId) == NULL){
+    return -1;
+  }
+  return (int) docTable->entries[documentId - 1].depth;
+}
+
+int getDocumentWords(DOC_TABLE* docTable, int documentId){
+  if (docTable == NULL || documentId < 1 || documentId > docTable->numDocuments){
+    return 0;
+  }
+  return (int) docTable->entries[documentId - 1].numWords;
+}
+
+double getAverageDocumentWords(DOC_TABLE* docTable){
+  if (docTable == NULL || docTable->numIndexed == 0){
+    return 0;
+  }
+  return (double) docTable->totalWords / docTable->numIndexed;
+}
+
+void freeDocTable(DOC_TABLE* docTable){
+  if (docTable == NULL){
+    return;
+  }
+
+  if (docTable->map != NULL){
+    munmap((void*) docTable->map, docTable->size);
+  } else {
+    for (int i = 0; i < docTable->numDocuments; i++){
+      free(docTable->urls[i]);
+    }
+    free(docTable->urls);
+    free(docTable->entries);
+  }
+
+  free(docTable);
+}
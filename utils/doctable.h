@@ -0,0 +1,122 @@
+#ifndef _DOCTABLE_H_
+#define _DOCTABLE_H_
+
+// *****************Impementation Spec********************************
+// File: doctable.c
+// Author: Delos Chang
+// This file contains useful information for the document table:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// The document table records, for every document the indexer saw, the
+// URL and crawl depth from the top of its page and the number of words
+// that were indexed from it. The indexer writes it next to the results
+// file (index.dat.docs for index.dat) in binary, host byte order:
+//
+//   DOC_TABLE_HEADER
+//   DOC_TABLE_ENTRY[numDocuments]     entry id - 1 is document id
+//   char strings[]                    NUL terminated URLs
+//
+// The header also carries the statistics of the whole collection that
+// ranking needs (how many documents were indexed and how many words they
+// have between them).
+//
+// The query engine mmaps it, so printing a result is a lookup in the
+// mapping instead of opening the crawled page for its first line.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// DEFINES
+
+// first bytes of every document table
+#define DOC_TABLE_MAGIC "TSEDOCTB"
+#define DOC_TABLE_MAGIC_LENGTH 8
+
+// bump whenever the layout above changes
+// (version 1 had no collection statistics)
+#define DOC_TABLE_VERSION 2
+
+// appended to the results file name to name its document table
+#define DOC_TABLE_SUFFIX ".docs"
+
+// DATA STRUCTURES
+
+typedef struct _DOC_TABLE_HEADER {
+  char magic[DOC_TABLE_MAGIC_LENGTH];   // DOC_TABLE_MAGIC, not NUL terminated
+  uint32_t version;                     // DOC_TABLE_VERSION
+  uint32_t numDocuments;                // entries, for document ids 1 to numDocuments
+  uint64_t stringsOffset;               // byte offset of the URLs
+  uint64_t fileSize;                    // total size in bytes
+  uint64_t totalWords;                  // words indexed from all the documents
+  uint32_t numIndexed;                  // documents that were indexed (have a URL)
+  uint32_t reserved;                    // 0
+} DOC_TABLE_HEADER;
+
+// what is recorded of each document
+typedef struct _DOC_TABLE_ENTRY {
+  uint32_t urlOffset;                   // offset of the URL in the strings
+  uint32_t urlLength;                   // length of the URL without the NUL, 0 if unknown
+  uint32_t depth;                       // crawl depth of the page
+  uint32_t numWords;                    // words indexed from the page
+} DOC_TABLE_ENTRY;
+
+// a document table being built by the indexer or opened (mmap'ed) from
+// its file
+typedef struct _DOC_TABLE {
+  int numDocuments;
+  int numIndexed;                       // documents with a URL, set when saved or opened
+  uint64_t totalWords;                  // words of those documents, set when saved or opened
+  DOC_TABLE_ENTRY *entries;             // entries[id - 1] is document id
+  char **urls;                          // while building: the URL of each document
+  const char *strings;                  // once opened: the URLs in the mapping
+  const unsigned char *map;             // start of the mapping (NULL while building)
+  size_t size;                          // size of the mapping
+} DOC_TABLE;
+
+// function PROTOTYPES
+
+// docTablePath: returns the (malloc'ed) name of the document table of
+// the results file indexFile
+char* docTablePath(char* indexFile);
+
+// newDocTable: creates an empty table for documents 1 to numDocuments
+DOC_TABLE* newDocTable(int numDocuments);
+
+// recordDocument: records the URL and depth at the top of the page of
+// documentId. Called before the page is tokenized, which writes over it.
+// Tables being built may have different documents recorded from several
+// threads at once
+void recordDocument(DOC_TABLE* docTable, int documentId, const char* page);
+
+// recordDocumentWords: records how many words were indexed from documentId
+void recordDocumentWords(DOC_TABLE* docTable, int documentId, int numWords);
+
+// copyDocument: copies what from records of documentId into docTable
+void copyDocument(DOC_TABLE* docTable, DOC_TABLE* from, int documentId);
+
+// saveDocTable: writes the table to path
+void saveDocTable(DOC_TABLE* docTable, char* path);
+
+// openDocTable: maps the table saved in path. Returns NULL if there is
+// none or it is not a valid document table
+DOC_TABLE* openDocTable(char* path);
+
+// getDocumentURL: returns the URL of documentId, or NULL if it is not known
+const char* getDocumentURL(DOC_TABLE* docTable, int documentId);
+
+// getDocumentDepth: returns the crawl depth of documentId, -1 if not known
+int getDocumentDepth(DOC_TABLE* docTable, int documentId);
+
+// getDocumentWords: returns the words indexed from documentId, 0 if not known
+int getDocumentWords(DOC_TABLE* docTable, int documentId);
+
+// getAverageDocumentWords: returns the average number of words indexed
+// from a document of a saved or opened table, 0 if there is none
+double getAverageDocumentWords(DOC_TABLE* docTable);
+
+// freeDocTable: unmaps or frees the table
+void freeDocTable(DOC_TABLE* docTable);
+
+#endif
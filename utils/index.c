@@ -7,20 +7,36 @@ Description: Shared functions that handle the INVERTED INDEX. Such as:
 1. Sanitizing the index 
 2. Reconstructing an inverted index from file into memory. 
 3. Creating WordNodes
-4. Creating DocNodes
+4. Creating DocNodes and adding postings to WordNodes
+5. Opening an index file lazily (postings decoded on first lookup)
 
 
 By: Delos Chang
 
 */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <limits.h>
+
+// the SSE2 fast path of sanitize compares characters as signed bytes, so
+// it is only used where char is signed (as on x86 with gcc and clang)
+#if defined(__SSE2__) && CHAR_MIN < 0
+#define SANITIZE_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
 
 #include "../utils/header.h"
 #include "index.h"
+#include "indexfile.h"
 #include "hash.h"
 
 // This function initializes the reloaded index structure that will be used
@@ -37,54 +53,160 @@ INVERTED_INDEX* initStructure(INVERTED_INDEX* indexVar){
   }
 
   MALLOC_CHECK(indexVar);
-  indexVar->start = indexVar->end = NULL;
   BZERO(indexVar, sizeof(INVERTED_INDEX));
 
+  // start with an empty word table
+  indexVar->wordArena = newArena(ARENA_BLOCK_SIZE);
+  indexVar->nodeArena = newArena(ARENA_BLOCK_SIZE);
+  indexVar->numSlots = INDEX_INITIAL_SLOTS;
+  indexVar->slots = (WORD_SLOT*) calloc(indexVar->numSlots, sizeof(WORD_SLOT));
+  MALLOC_CHECK(indexVar->slots);
+
   return indexVar;
 }
 
-// Cleans up the index by freeing the wordnode, documentnode
-// and entire index
-void cleanUpIndex(INVERTED_INDEX* index){
-  WordNode* startWordNode;
-  WordNode* toWordFreedom;
-  DocumentNode* startPage;
-  DocumentNode* toFreedom;
-
-  // loop through each hash slot
-  for(int i=0; i < MAX_NUMBER_OF_SLOTS; i++){
+// Finds the slot of word, or the empty slot where it would go.
+// Probing is linear; the table size is a power of two so the
+// starting slot is just the low bits of the hash
+static WORD_SLOT* probeWordSlot(INVERTED_INDEX* index, const char* word, int length,
+    unsigned long wordHash){
+  unsigned long mask = (unsigned long) index->numSlots - 1;
+  unsigned long position = wordHash & mask;
+
+  while (1){
+    WORD_SLOT* slot = &(index->slots[position]);
+
+    // compare the stored hashes first, the words only when they match
+    if (slot->wordNode == NULL || (slot->hash == wordHash
+        && slot->wordNode->length == length
+        && !memcmp(slot->wordNode->word, word, length))){
+      return slot;
+    }
 
-    startWordNode = index->hash[i];
-    // loop through every word in the list
-    while (startWordNode != NULL){
+    position = (position + 1) & mask;
+  }
+}
 
-      toWordFreedom = startWordNode;
+// Doubles the word table and re-inserts every word using the stored hashes
+static void growWordTable(INVERTED_INDEX* index){
+  WORD_SLOT* oldSlots = index->slots;
+  int oldNumSlots = index->numSlots;
 
-      // for each wordNode, loop through each of the DocNodes
-      startPage = startWordNode->page;
-      while (startPage != NULL){
-        toFreedom = startPage;
-        startPage = startPage->next;
+  index->numSlots = oldNumSlots * 2;
+  index->slots = (WORD_SLOT*) calloc(index->numSlots, sizeof(WORD_SLOT));
+  MALLOC_CHECK(index->slots);
 
-        // release the DocNode to FREEDOM!!
-        if (toFreedom != NULL){
-          free(toFreedom);
-        }
-      }
+  unsigned long mask = (unsigned long) index->numSlots - 1;
+  for (int i = 0; i < oldNumSlots; i++){
+    if (oldSlots[i].wordNode == NULL){
+      continue;
+    }
 
-      // continue
-      startWordNode = startWordNode->next;
-      
-      // we have no use for the WordNode anymore
-      if (toWordFreedom != NULL){
-        free(toWordFreedom);
-      }
+    // words are unique, so the first empty slot is the right one
+    unsigned long position = oldSlots[i].hash & mask;
+    while (index->slots[position].wordNode != NULL){
+      position = (position + 1) & mask;
     }
+    index->slots[position] = oldSlots[i];
   }
 
+  free(oldSlots);
+}
+
+// hash1 of word with its bits mixed. Only the low bits pick the slot,
+// and those of hash1 depend on the low bits of the characters alone
+static unsigned long wordTableHash(char* word){
+  unsigned long long wordHash = hash1(word) * 0x9E3779B97F4A7C15ULL;
+
+  return (unsigned long) (wordHash ^ (wordHash >> 32));
+}
+
+// Looks up a word in the word table
+WordNode* findWordNode(INVERTED_INDEX* index, char* word){
+  return probeWordSlot(index, word, (int) strlen(word), wordTableHash(word))->wordNode;
+}
+
+// Grows the word table until numWords words keep it at most
+// INDEX_MAX_LOAD_PERCENT full
+static void reserveWordTable(INVERTED_INDEX* index, long numWords){
+  while (numWords * 100 > (long) index->numSlots * INDEX_MAX_LOAD_PERCENT){
+    growWordTable(index);
+  }
+}
+
+// Inserts a new word whose hash is already known into the word table
+static void insertWordNode(INVERTED_INDEX* index, WordNode* wordNode, unsigned long wordHash){
+  reserveWordTable(index, index->numWords + 1L);
+
+  WORD_SLOT* slot = probeWordSlot(index, wordNode->word, wordNode->length, wordHash);
+
+  slot->hash = wordHash;
+  slot->wordNode = wordNode;
+  index->numWords++;
+}
+
+// Inserts a new word into the word table
+void addWordNode(INVERTED_INDEX* index, WordNode* wordNode){
+  insertWordNode(index, wordNode, wordTableHash(wordNode->word));
+}
+
+// Returns the WordNode of word, adding an empty one if it is new
+static WordNode* findOrAddWordNode(INVERTED_INDEX* index, char* word){
+  WordNode* wordNode = findWordNode(index, word);
+
+  if (wordNode == NULL){
+    wordNode = newWordNode(wordNode, word, index);
+    addWordNode(index, wordNode);
+  }
+
+  return wordNode;
+}
+
+// Unmaps a lazily opened text index
+static void closeLexicon(LEXICON* lexicon){
+  if (lexicon == NULL){
+    return;
+  }
+
+  munmap(lexicon->map, lexicon->size);
+  free(lexicon->entries);
+  free(lexicon);
+}
+
+// Cleans up the index by freeing the wordnode, documentnode
+// and entire index. The nodes and words are released block by
+// block with their arenas instead of one at a time
+void cleanUpIndex(INVERTED_INDEX* index){
+  free(index->slots);
+  freeArena(index->nodeArena);
+  freeArena(index->wordArena);
+
+  closeIndexFile(index->file);
+  closeLexicon(index->lexicon);
   free(index);
 }
 
+// Drops every word and posting but keeps the index itself, as if it had
+// just been created with initStructure
+void emptyIndex(INVERTED_INDEX* index){
+  free(index->slots);
+  freeArena(index->nodeArena);
+  freeArena(index->wordArena);
+
+  index->wordArena = newArena(ARENA_BLOCK_SIZE);
+  index->nodeArena = newArena(ARENA_BLOCK_SIZE);
+  index->numSlots = INDEX_INITIAL_SLOTS;
+  index->numWords = 0;
+  index->slots = (WORD_SLOT*) calloc(index->numSlots, sizeof(WORD_SLOT));
+  MALLOC_CHECK(index->slots);
+}
+
+// Adds up the arenas and the word table
+size_t indexMemoryUsed(INVERTED_INDEX* index){
+  return index->wordArena->bytesUsed + index->nodeArena->bytesUsed
+    + (size_t) index->numSlots * sizeof(WORD_SLOT);
+}
+
 // This function goes through the buffer and lower cases all the
 // capital letters using the ASCII table
 void capitalToLower(char* buffer){
@@ -96,74 +218,118 @@ void capitalToLower(char* buffer){
   }
 }
 
+// Applies the filtering rules of sanitize to one character: returns 1 if
+// it is kept. Everything up to 13 (and so every byte above 127 where char
+// is signed) is dropped, as is most punctuation
+int sanitizeKeepsCharacter(char c){
+  // filter newlines, tabs and other control characters
+  if (c <= 13){
+    return 0;
+  }
+
+  // filter apostrophe and periods and commas and quotes
+  if (c == 39 || c == ',' || c == '.' || c == '"'){
+    return 0;
+  }
+
+  // filter out '!' '#' '$' etc
+  if ((c >= 33 && c <= 44) && (c != '&')){
+    return 0;
+  }
+
+  // filter characters like ':' ';' '@' '?' etc.
+  // make sure '<' and '>' pass through
+  if (c >= 59 && c <= 64 && c != 60 && c != 62){
+    return 0;
+  }
+
+  // filter characters like '[' '\' '^' '_'
+  if (c >= 91 && c <= 96){
+    return 0;
+  }
+
+  // filter characters like '{' '|' '~'
+  if (c >= 123 && c <= 127){
+    return 0;
+  }
+
+  return 1;
+}
+
+// 1 for every byte sanitize keeps, built once from sanitizeKeepsCharacter
+static unsigned char sanitizeTable[256];
+static pthread_once_t sanitizeTableOnce = PTHREAD_ONCE_INIT;
+
+static void buildSanitizeTable(){
+  for (int b = 0; b < 256; b++){
+    sanitizeTable[b] = (unsigned char) sanitizeKeepsCharacter((char) b);
+  }
+}
+
+#ifdef SANITIZE_HAVE_SSE2
+// 0xFF in every lane of x between low and high (as signed bytes)
+static __m128i bytesInRange(__m128i x, char low, char high){
+  return _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8((char) (low - 1))),
+      _mm_cmplt_epi8(x, _mm_set1_epi8((char) (high + 1))));
+}
+
+// Returns 1 if sanitize keeps all 16 bytes of x. These are the ranges
+// left over by sanitizeKeepsCharacter
+static int keepsAllBytes(__m128i x){
+  __m128i keep = bytesInRange(x, 14, 32);                           // controls, space
+  keep = _mm_or_si128(keep, _mm_cmpeq_epi8(x, _mm_set1_epi8('&')));
+  keep = _mm_or_si128(keep, _mm_cmpeq_epi8(x, _mm_set1_epi8('-')));
+  keep = _mm_or_si128(keep, bytesInRange(x, '/', ':'));            // / digits :
+  keep = _mm_or_si128(keep, _mm_cmpeq_epi8(x, _mm_set1_epi8('<')));
+  keep = _mm_or_si128(keep, _mm_cmpeq_epi8(x, _mm_set1_epi8('>')));
+  keep = _mm_or_si128(keep, bytesInRange(x, 'A', 'Z'));
+  keep = _mm_or_si128(keep, bytesInRange(x, 'a', 'z'));
+
+  return _mm_movemask_epi8(keep) == 0xFFFF;
+}
+#endif
+
 // Strips the buffer of non-letters
 // sanitize: this will sanitize a buffer, stripping everything that should not be
 // parsed into words: e.g. -- newline characters, @, & etc. When choosing what to 
 // sanitize, there is a trade off between obfuscating possible words that could be
 // using them. 
+// The buffer is filtered in place in a single pass: runs of 16 characters
+// that are all kept are copied with SSE2, the rest go through a lookup
+// table. The result is always at most as long as what is left to read,
+// so writing behind the read position is safe.
 void sanitize(char* loadedDocument){
-  char* temp;
-  char* clear;
-
-  // set aside buffer for the document
-  temp = malloc(sizeof(char) * strlen(loadedDocument) + 1); 
-  BZERO(temp, (strlen(loadedDocument) + 1)); // to be safe
-
-  // Initialize a clear 
-  // We will put all valid letters into this and then transfer it
-  // into the temp buffer
-  clear = malloc(sizeof(char) + 1);
-  BZERO(clear, sizeof(char));
-
-  // loop through document until end
-  for (int i = 0; loadedDocument[i]; i++){
-
-    // only copy into buffer if it is valid by the following parameters
-    if (loadedDocument[i] > 13){
-      // filter apostrophe and periods and commas and quotes
-      if (loadedDocument[i] == 39 || loadedDocument[i] == ',' 
-        || loadedDocument[i] == '.'
-        || loadedDocument[i] == '"'){
-        continue;
-      }
-      
-      // filter out '!' '#' '$' etc
-      if ((loadedDocument[i] >= 33 && loadedDocument[i] <=44) && 
-        (loadedDocument[i] != '&')){
-        continue;
-      }
-
-      // filter characters like ':' ';' '@' '?' etc.
-      // make sure '<' and '>' pass through 
-      if (loadedDocument[i] >= 59 && loadedDocument[i] <= 64
-        && loadedDocument[i] != 60 && loadedDocument[i] != 62){
-        continue;
-      }
-      
-      // filter characters like '[' '\' '^' '_'
-      if (loadedDocument[i] >= 91 && loadedDocument[i] <= 96){
-        continue;
-      }
+  size_t length = strlen(loadedDocument);
+  const char* in = loadedDocument;
+  const char* end = loadedDocument + length;
+  char* out = loadedDocument;
 
-      // filter characters like '{' '|' '~'
-      if (loadedDocument[i] >= 123 && loadedDocument[i] <= 127){
-        continue;
-      }
+  pthread_once(&sanitizeTableOnce, buildSanitizeTable);
 
-      // put that character into the clearzone
-      sprintf(clear, "%c", loadedDocument[i]);
+#ifdef SANITIZE_HAVE_SSE2
+  while (end - in >= 16){
+    __m128i chunk = _mm_loadu_si128((const __m128i*) in);
 
-      // append it to temp
-      strcat(temp, clear);
+    if (keepsAllBytes(chunk)){
+      _mm_storeu_si128((__m128i*) out, chunk);
+      out += 16;
+    } else {
+      for (int i = 0; i < 16; i++){
+        *out = in[i];
+        out += sanitizeTable[(unsigned char) in[i]];
+      }
     }
+    in += 16;
   }
+#endif
 
-  // replace original with sanitized version
-  strcpy(loadedDocument, temp);
-  
-  // clean up
-  free(temp);
-  free(clear);
+  // the rest (or all of it without SSE2), one character at a time
+  for (; in < end; in++){
+    *out = *in;
+    out += sanitizeTable[(unsigned char) *in];
+  }
+
+  *out = '\0';
 }
 
 // Given a doc ID and integer page frequency, this function
@@ -185,23 +351,385 @@ DocumentNode* newDocNode(DocumentNode* docNode, int docId, int page_freq){
   return docNode;
 }
 
-// Given a word node and a doc Node, this function will create
-// a new Word Node and return it
-WordNode* newWordNode(WordNode* wordNode, DocumentNode* docNode, char* word){
-  wordNode = (WordNode*)malloc(sizeof(WordNode));
-  if (wordNode == NULL){
-    fprintf(stderr, "Out of memory for indexing! Aborting. \n");
-    exit(1);
+// Given a word, this function will create a new Word Node and return
+// it. The node and the word both come from the index's arenas, so the
+// word only takes up its own length
+WordNode* newWordNode(WordNode* wordNode, char* word, INVERTED_INDEX* index){
+  wordNode = (WordNode*) arenaAlloc(index->nodeArena, sizeof(WordNode));
+  BZERO(wordNode, sizeof(WordNode)); // no postings yet
+
+  wordNode->length = (int) strlen(word);
+  wordNode->word = arenaCopyString(index->wordArena, word, wordNode->length);
+
+  return wordNode;
+}
+
+// Makes sure the word's postings buffer has room for needed more bytes.
+// The buffer doubles in size; the outgrown one stays in the node arena
+// until the index is cleaned up
+static void reservePostings(WordNode* wordNode, int needed, INVERTED_INDEX* index){
+  if (wordNode->postingsLength + needed <= wordNode->maxPostingsLength){
+    return;
   }
 
-  MALLOC_CHECK(wordNode);
-  wordNode->prev = wordNode->next = NULL; // first in hash slot, no connections
-  wordNode->page = docNode; // pointer to 1st element of page list
+  int maxPostingsLength = wordNode->maxPostingsLength * 2;
+  if (maxPostingsLength < INDEX_FIRST_POSTINGS_BYTES){
+    maxPostingsLength = INDEX_FIRST_POSTINGS_BYTES;
+  }
+  while (maxPostingsLength < wordNode->postingsLength + needed){
+    maxPostingsLength *= 2;
+  }
 
-  BZERO(wordNode->word, WORD_LENGTH);
-  strncpy(wordNode->word, word, WORD_LENGTH);
+  unsigned char* postings = (unsigned char*) arenaAlloc(index->nodeArena, maxPostingsLength);
+  if (wordNode->postingsLength > 0){
+    memcpy(postings, wordNode->postings, wordNode->postingsLength);
+  }
 
-  return wordNode;
+  wordNode->postings = postings;
+  wordNode->maxPostingsLength = maxPostingsLength;
+}
+
+// Re-encodes the tail of the word's postings, POSTINGS_BLOCK_SIZE
+// varint pairs, as a block that can be decoded with SIMD
+static void sealPostings(WordNode* wordNode, INVERTED_INDEX* index){
+  uint32_t gaps[POSTINGS_BLOCK_SIZE];
+  uint32_t frequencies[POSTINGS_BLOCK_SIZE];
+  unsigned char block[POSTINGS_MAX_BLOCK_BYTES];
+
+  const unsigned char* tail = wordNode->postings + wordNode->blocksLength;
+  for (int i = 0; i < POSTINGS_BLOCK_SIZE; i++){
+    tail = decodeVarint(tail, &(gaps[i]));
+    tail = decodeVarint(tail, &(frequencies[i]));
+  }
+
+  int blockLength = encodePostingsBlock(block, gaps, frequencies);
+
+  // the block replaces the tail (it can be a little longer)
+  wordNode->postingsLength = wordNode->blocksLength;
+  reservePostings(wordNode, blockLength, index);
+
+  memcpy(wordNode->postings + wordNode->blocksLength, block, blockLength);
+  wordNode->blocksLength += blockLength;
+  wordNode->postingsLength = wordNode->blocksLength;
+}
+
+// Encodes a posting after the last one of the word, sealing the tail
+// into a block first if it is full
+static void appendPosting(WordNode* wordNode, int docId, int page_freq, INVERTED_INDEX* index){
+  if (wordNode->numPages > 0 && wordNode->numPages % POSTINGS_BLOCK_SIZE == 0){
+    sealPostings(wordNode, index);
+  }
+
+  reservePostings(wordNode, 2 * POSTINGS_MAX_VARINT_BYTES, index);
+
+  unsigned char* end = wordNode->postings + wordNode->postingsLength;
+  int gapLength = encodeVarint(end, (uint32_t) (docId - wordNode->lastDocumentId));
+
+  wordNode->lastFrequencyOffset = wordNode->postingsLength + gapLength;
+  wordNode->postingsLength += gapLength + encodeVarint(end + gapLength, (uint32_t) page_freq);
+
+  wordNode->lastDocumentId = docId;
+  wordNode->lastFrequency = page_freq;
+  wordNode->numPages++;
+}
+
+// Replaces the postings of the word with count postings, sorted by
+// document id, encoded from scratch in a fresh buffer (the old one is
+// left in the arena)
+static void reencodePostings(WordNode* wordNode, int* documentIds, int* pageFrequencies,
+    int count, INVERTED_INDEX* index){
+  wordNode->numPages = 0;
+  wordNode->lastDocumentId = 0;
+  wordNode->postingsLength = 0;
+  wordNode->blocksLength = 0;
+  wordNode->maxPostingsLength = 0;
+  wordNode->postings = NULL;
+
+  for (int i = 0; i < count; i++){
+    appendPosting(wordNode, documentIds[i], pageFrequencies[i], index);
+  }
+}
+
+// Re-encodes the postings of the word with an earlier document merged in.
+// The indexer never gets here since it adds documents in ascending order
+static void insertPosting(WordNode* wordNode, int docId, int page_freq, INVERTED_INDEX* index){
+  POSTINGS_CURSOR cursor;
+  int numPages = wordNode->numPages;
+  int* documentIds = (int*) malloc(sizeof(int) * (numPages + 1));
+  int* pageFrequencies = (int*) malloc(sizeof(int) * (numPages + 1));
+  MALLOC_CHECK(documentIds);
+  MALLOC_CHECK(pageFrequencies);
+
+  int count = 0;
+  int inserted = 0;
+  startWordPostings(&cursor, wordNode);
+  while (nextPosting(&cursor)){
+    if (!inserted && cursor.documentId >= docId){
+      if (cursor.documentId == docId){
+        cursor.frequency += page_freq;
+      } else {
+        documentIds[count] = docId;
+        pageFrequencies[count] = page_freq;
+        count++;
+      }
+      inserted = 1;
+    }
+
+    documentIds[count] = cursor.documentId;
+    pageFrequencies[count] = cursor.frequency;
+    count++;
+  }
+
+  reencodePostings(wordNode, documentIds, pageFrequencies, count, index);
+
+  free(documentIds);
+  free(pageFrequencies);
+}
+
+// Adds the document to the word's postings, keeping them sorted by
+// document id. The common cases are the last document again (only its
+// frequency is re-encoded) or a later one (appended)
+void addPosting(WordNode* wordNode, int docId, int page_freq, INVERTED_INDEX* index){
+  if (wordNode->numPages > 0 && docId == wordNode->lastDocumentId){
+    // same document again, add up the occurrences. The frequency is the
+    // last thing encoded so it can be rewritten in place
+    reservePostings(wordNode, POSTINGS_MAX_VARINT_BYTES, index);
+
+    wordNode->lastFrequency += page_freq;
+    wordNode->postingsLength = wordNode->lastFrequencyOffset
+      + encodeVarint(wordNode->postings + wordNode->lastFrequencyOffset,
+          (uint32_t) wordNode->lastFrequency);
+
+  } else if (wordNode->numPages > 0 && docId < wordNode->lastDocumentId){
+    insertPosting(wordNode, docId, page_freq, index);
+
+  } else {
+    appendPosting(wordNode, docId, page_freq, index);
+  }
+}
+
+void startWordPostings(POSTINGS_CURSOR* cursor, WordNode* wordNode){
+  startPostings(cursor, wordNode->postings, wordNode->numPages);
+}
+
+// returns 1 if documentId is one of the removed documents
+static int isRemovedDocument(const char* removed, int lastDocumentId, int documentId){
+  return documentId <= lastDocumentId && removed[documentId];
+}
+
+// Re-encodes the postings of the word without those of the removed
+// documents, if it has any
+static void removeWordDocuments(WordNode* wordNode, const char* removed, int lastDocumentId,
+    INVERTED_INDEX* index){
+  POSTINGS_CURSOR cursor;
+  int found = 0;
+
+  startWordPostings(&cursor, wordNode);
+  while (!found && nextPosting(&cursor)){
+    found = isRemovedDocument(removed, lastDocumentId, cursor.documentId);
+  }
+
+  if (!found){
+    return;
+  }
+
+  int* documentIds = (int*) malloc(sizeof(int) * wordNode->numPages);
+  int* pageFrequencies = (int*) malloc(sizeof(int) * wordNode->numPages);
+  MALLOC_CHECK(documentIds);
+  MALLOC_CHECK(pageFrequencies);
+
+  int count = 0;
+  startWordPostings(&cursor, wordNode);
+  while (nextPosting(&cursor)){
+    if (!isRemovedDocument(removed, lastDocumentId, cursor.documentId)){
+      documentIds[count] = cursor.documentId;
+      pageFrequencies[count] = cursor.frequency;
+      count++;
+    }
+  }
+
+  reencodePostings(wordNode, documentIds, pageFrequencies, count, index);
+
+  free(documentIds);
+  free(pageFrequencies);
+}
+
+// Filters the postings of every word, then rebuilds the word table
+// without the words that were left with none (linear probing cannot
+// just empty their slots)
+void removeDocuments(INVERTED_INDEX* index, const char* removed, int lastDocumentId){
+  int emptied = 0;
+
+  for (int i = 0; i < index->numSlots; i++){
+    WordNode* wordNode = index->slots[i].wordNode;
+
+    if (wordNode != NULL){
+      removeWordDocuments(wordNode, removed, lastDocumentId, index);
+      emptied |= wordNode->numPages == 0;
+    }
+  }
+
+  if (!emptied){
+    return;
+  }
+
+  WORD_SLOT* oldSlots = index->slots;
+  int oldNumSlots = index->numSlots;
+
+  index->slots = (WORD_SLOT*) calloc(oldNumSlots, sizeof(WORD_SLOT));
+  MALLOC_CHECK(index->slots);
+  index->numWords = 0;
+
+  for (int i = 0; i < oldNumSlots; i++){
+    if (oldSlots[i].wordNode != NULL && oldSlots[i].wordNode->numPages > 0){
+      insertWordNode(index, oldSlots[i].wordNode, oldSlots[i].hash);
+    }
+  }
+
+  free(oldSlots);
+}
+
+// the words of a set of partial indexes that one merge thread moves into
+// an index of its own: those whose hash falls in its part
+typedef struct _MERGE_PART {
+  INVERTED_INDEX **partials;
+  int numPartials;
+  int part;
+  int numParts;
+  INVERTED_INDEX *merged;
+} MERGE_PART;
+
+// The part a word is merged in. The low bits of the hash pick its slot,
+// so they are scrambled first: otherwise every word of a part would
+// compete for the same fraction of the slots
+static int mergePartOf(unsigned long wordHash, int numParts){
+  return (int) ((((uint32_t) wordHash * 2654435761u) >> 16) % (uint32_t) numParts);
+}
+
+// Appends the postings of from after those of wordNode. The documents of
+// from all come after those of wordNode
+static void appendWordPostings(WordNode* wordNode, WordNode* from, INVERTED_INDEX* index){
+  POSTINGS_CURSOR cursor;
+
+  startWordPostings(&cursor, from);
+  while (nextPosting(&cursor)){
+    appendPosting(wordNode, cursor.documentId, cursor.frequency, index);
+  }
+}
+
+// Merges the words of one part, partial by partial in document order.
+// The first WordNode seen for a word is taken over as it is; the postings
+// of the later ones are appended to it
+static void* mergePart(void* argument){
+  MERGE_PART* part = (MERGE_PART*) argument;
+  INVERTED_INDEX* merged = part->merged;
+
+  for (int p = 0; p < part->numPartials; p++){
+    INVERTED_INDEX* partial = part->partials[p];
+
+    for (int i = 0; i < partial->numSlots; i++){
+      WORD_SLOT* slot = &(partial->slots[i]);
+
+      if (slot->wordNode == NULL || mergePartOf(slot->hash, part->numParts) != part->part){
+        continue;
+      }
+
+      WORD_SLOT* mergedSlot = probeWordSlot(merged, slot->wordNode->word,
+          slot->wordNode->length, slot->hash);
+
+      if (mergedSlot->wordNode == NULL){
+        insertWordNode(merged, slot->wordNode, slot->hash);
+      } else {
+        appendWordPostings(mergedSlot->wordNode, slot->wordNode, merged);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+// Takes over the arenas of from and frees the rest of it
+static void absorbIndex(INVERTED_INDEX* index, INVERTED_INDEX* from){
+  mergeArena(index->nodeArena, from->nodeArena);
+  mergeArena(index->wordArena, from->wordArena);
+
+  free(from->slots);
+  free(from);
+}
+
+// Splits the words into one part per thread, merges the parts in
+// parallel and then gathers the merged parts into index
+void mergeIndexes(INVERTED_INDEX* index, INVERTED_INDEX** partials, int numPartials,
+    int numThreads){
+  if (numThreads < 1){
+    numThreads = 1;
+  }
+
+  MERGE_PART* parts = (MERGE_PART*) malloc(sizeof(MERGE_PART) * numThreads);
+  pthread_t* threads = (pthread_t*) malloc(sizeof(pthread_t) * numThreads);
+  int* started = (int*) malloc(sizeof(int) * numThreads);
+  MALLOC_CHECK(parts);
+  MALLOC_CHECK(threads);
+  MALLOC_CHECK(started);
+
+  long largestPartial = 0;
+  for (int p = 0; p < numPartials; p++){
+    if (partials[p]->numWords > largestPartial){
+      largestPartial = partials[p]->numWords;
+    }
+  }
+
+  for (int t = 0; t < numThreads; t++){
+    parts[t].partials = partials;
+    parts[t].numPartials = numPartials;
+    parts[t].part = t;
+    parts[t].numParts = numThreads;
+    parts[t].merged = NULL;
+    parts[t].merged = initStructure(parts[t].merged);
+
+    // room for the part's share of the largest partial index
+    reserveWordTable(parts[t].merged, largestPartial / numThreads);
+
+    // if no thread can be started, this one merges the part itself
+    started[t] = numThreads > 1
+      && !pthread_create(&(threads[t]), NULL, mergePart, &(parts[t]));
+    if (!started[t]){
+      mergePart(&(parts[t]));
+    }
+  }
+
+  for (int t = 0; t < numThreads; t++){
+    if (started[t]){
+      pthread_join(threads[t], NULL);
+    }
+  }
+
+  // every word is in exactly one part, so they can go straight in
+  long numWords = index->numWords;
+  for (int t = 0; t < numThreads; t++){
+    numWords += parts[t].merged->numWords;
+  }
+  reserveWordTable(index, numWords);
+
+  for (int t = 0; t < numThreads; t++){
+    INVERTED_INDEX* merged = parts[t].merged;
+
+    for (int i = 0; i < merged->numSlots; i++){
+      if (merged->slots[i].wordNode != NULL){
+        insertWordNode(index, merged->slots[i].wordNode, merged->slots[i].hash);
+      }
+    }
+
+    absorbIndex(index, merged);
+  }
+
+  for (int p = 0; p < numPartials; p++){
+    absorbIndex(index, partials[p]);
+  }
+
+  free(parts);
+  free(threads);
+  free(started);
 }
 
 // Loads the file into memory
@@ -240,7 +768,6 @@ char* loadDocument(char* filepath){
       fprintf(stderr, "Error reading the file into buffer. Aborting. \n");
       exit(1);
     } else {
-      readResult++;
       html[readResult] = '\0'; // add terminal byte
     }
   }
@@ -253,192 +780,282 @@ char* loadDocument(char* filepath){
 // word, document ID and page frequency passed to it. It is used in 
 // debug mode to ensure that the index can be "reloaded" 
 int reconstructIndex(char* word, int documentId, int page_word_frequency, INVERTED_INDEX* indexReload){
-  int wordHash = hash1(word) % MAX_NUMBER_OF_SLOTS;
-  DocumentNode* docNode;
-  WordNode* wordNode;
+  WordNode* matchedWordNode = findOrAddWordNode(indexReload, word);
 
-  // check if hash slot occupied first
-  if (indexReload->hash[wordHash] == NULL){
-    docNode = NULL;
-    docNode = newDocNode(docNode, documentId, page_word_frequency);
+  addPosting(matchedWordNode, documentId, page_word_frequency, indexReload);
 
-    // create Word Node of word and document node first
-    wordNode = NULL;
-    wordNode = newWordNode(wordNode, docNode, word);
+  return 1;
+}
 
-    // indexing at this slot will bring this wordNode up first
-    indexReload->hash[wordHash] = wordNode;
+// saves the inverted index into a file
+// saveIndexToFile: this function will save the index in memory to a file
+// by sorting the WordNodes by word, then going through each of them and
+// its postings, writing them in the specified format
+// cat 2 2 3 4 5 
+// the first 2 indicates that there are 2 documents with 'cat' found
+// the second 2 indicates the document ID with 3 occurrences of 'cat'
+// the 4 indicates the document ID with 5 occurrences of 'cat'
+// The lines come out sorted by word in one pass, so the file is not
+// sorted again afterwards
+void saveIndexToFile(INVERTED_INDEX* index, char* targetFile, int format){
+  WordNode** words;
+  POSTINGS_CURSOR cursor;
+  FILE* fp;
+  int numWords;
 
-    // change end of inverted Index
-    indexReload->end = wordNode;
-  } else {
-    // occupied, move down the list checking for identical WordNode
-    WordNode* checkWordNode = indexReload->hash[wordHash];
+  if (format == INDEX_FORMAT_BINARY){
+    saveIndexToBinaryFile(index, targetFile);
+    return;
+  }
 
-    WordNode* matchedWordNode = NULL;
-    WordNode* endWordNode = NULL;
+  // open the targeted file
+  fp = fopen(targetFile, "w");
 
-    // check if the pointer is on the current word
-    // we are looking for.
-    // if not, run down the list and check for the word
-    if (!strncmp(checkWordNode->word, word, WORD_LENGTH)){
-      matchedWordNode = checkWordNode;
+  if (fp == NULL){
+    fprintf(stderr, "Error writing to the file %s", targetFile);
+    exit(1);
+  }
 
-    } else {
-      // loop until the end of the word list
-      // the last WordNode 
-
-      while (checkWordNode != NULL){
-        // reached end of the WordNode list?
-        if ( (checkWordNode->next == NULL) ){
-          // store this last word node in the list
-          endWordNode = checkWordNode;
-          break;
-        }
+  words = sortedWordNodes(index, &numWords);
 
-        checkWordNode = checkWordNode->next;
-        if (!strncmp(checkWordNode->word, word, WORD_LENGTH)){
-          // found a match that wasn't the first in the list
-          matchedWordNode = checkWordNode; // store this word node
-          break;
-        }
-      }
+  // loop through the words in order
+  for (int i = 0; i < numWords; i++){
+    fprintf(fp, "%s %d ", words[i]->word, words[i]->numPages);
+
+    // rest are docID and number of occurrences
+    startWordPostings(&cursor, words[i]);
+    while (nextPosting(&cursor)){
+      // keep adding the doc identifier and the page freq until no more
+      fprintf(fp, "%d %d ", cursor.documentId, cursor.frequency);
     }
+    fprintf(fp, "\n");
+  }
 
-    // either we ran to end of list and the word was not found
-    // OR we have found a match
-    if (matchedWordNode != NULL){
-      // WordNode already exists
-      // see if document Node exists
+  free(words);
 
-      // grab first of the document nodes
-      DocumentNode* matchDocNode = matchedWordNode->page;
-      DocumentNode* endDocNode;
+  // writing is done; free resources
+  if (fclose(fp) != 0){
+    fprintf(stderr, "Error writing to the file %s \n", targetFile);
+    exit(1);
+  }
+}
 
-      while (matchDocNode != NULL){
-        if ( (matchDocNode->next == NULL) ){
+// compares two WordNode pointers by their words (for qsort)
+static int compareWordNodes(const void* a, const void* b){
+  const WordNode* wordA = *(WordNode* const*) a;
+  const WordNode* wordB = *(WordNode* const*) b;
 
-          // end of the doc node listing
-          endDocNode = matchDocNode;
+  return strcmp(wordA->word, wordB->word);
+}
 
-          // create Document node first
-          docNode = NULL;
-          docNode = newDocNode(docNode, documentId, page_word_frequency);
+// one slice of the words, sorted by its own thread
+typedef struct _SORT_RUN {
+  WordNode **words;
+  int numWords;
+} SORT_RUN;
 
-          // the docNode should be last now
-          endDocNode->next = docNode;
-          break;
-        }
+static void* sortRun(void* argument){
+  SORT_RUN* run = (SORT_RUN*) argument;
 
-        matchDocNode = matchDocNode->next;
-        // check if the matched Doc Node has the same document ID
-        if (matchDocNode->document_id == documentId){
-          // this is the correct document to increase page frequency
-          matchDocNode->page_word_frequency++;
-          break;
-        }
-      }
+  qsort(run->words, run->numWords, sizeof(WordNode*), compareWordNodes);
+  return NULL;
+}
+
+// Merges the sorted runs a and b into out
+static void mergeRuns(WordNode** out, SORT_RUN* a, SORT_RUN* b){
+  int i = 0;
+  int j = 0;
+
+  while (i < a->numWords && j < b->numWords){
+    if (compareWordNodes(&(b->words[j]), &(a->words[i])) < 0){
+      *out++ = b->words[j++];
     } else {
-      // create Document node first
-      docNode = NULL;
-      docNode = newDocNode(docNode, documentId, page_word_frequency);
+      *out++ = a->words[i++];
+    }
+  }
+  while (i < a->numWords){
+    *out++ = a->words[i++];
+  }
+  while (j < b->numWords){
+    *out++ = b->words[j++];
+  }
+}
+
+// Sorts the words by strcmp. Large indexes are cut into one run per CPU,
+// the runs are sorted in parallel and then merged pairwise
+static void sortWordNodes(WordNode** words, int numWords){
+  SORT_RUN runs[INDEX_MAX_SORT_THREADS];
+  pthread_t threads[INDEX_MAX_SORT_THREADS];
+  int started[INDEX_MAX_SORT_THREADS];
+
+  long numRuns = sysconf(_SC_NPROCESSORS_ONLN);
+  if (numRuns > INDEX_MAX_SORT_THREADS){
+    numRuns = INDEX_MAX_SORT_THREADS;
+  }
+
+  if (numWords < INDEX_PARALLEL_SORT_MIN || numRuns < 2){
+    qsort(words, numWords, sizeof(WordNode*), compareWordNodes);
+    return;
+  }
 
-      // WordNode doesn't exist, create new
-      wordNode = NULL;
-      wordNode = newWordNode(wordNode, docNode, word);
+  for (int r = 0; r < numRuns; r++){
+    int first = (int) ((long) numWords * r / numRuns);
+    int last = (int) ((long) numWords * (r + 1) / numRuns);
 
-      // adjust previous 
-      endWordNode->next = wordNode;
+    runs[r].words = words + first;
+    runs[r].numWords = last - first;
 
+    // if no thread can be started, this one sorts the run itself
+    started[r] = !pthread_create(&(threads[r]), NULL, sortRun, &(runs[r]));
+    if (!started[r]){
+      sortRun(&(runs[r]));
     }
+  }
 
-    return 1;
+  for (int r = 0; r < numRuns; r++){
+    if (started[r]){
+      pthread_join(threads[r], NULL);
+    }
   }
 
-  // do indexing here
-  return 1;
-}
+  WordNode** scratch = (WordNode**) malloc(sizeof(WordNode*) * numWords);
+  MALLOC_CHECK(scratch);
 
-// saves the inverted index into a file
-// returns 1 if successful, 0 if not
-// saveIndexToFile: this function will save the index in memory to a file
-// by going through each WordNode and Document Node, parsing them 
-// and writing them in the specified format
-// cat 2 2 3 4 5 
-// the first 2 indicates that there are 2 documents with 'cat' found
-// the second 2 indicates the document ID with 3 occurrences of 'cat'
-// the 4 indicates the document ID with 5 occurrences of 'cat'
-void saveIndexToFile(INVERTED_INDEX* index, char* targetFile){
-  WordNode* startWordNode;
-  DocumentNode* startPage;
-  FILE* fp;
+  // each pass merges neighbouring runs into the other array
+  WordNode** from = words;
+  WordNode** to = scratch;
+  while (numRuns > 1){
+    int merged = 0;
 
-  int count;
+    for (int r = 0; r < numRuns; r += 2){
+      WordNode** out = to + (runs[r].words - from);
 
-  // open the targeted file
-  fp = fopen(targetFile, "w");
+      if (r + 1 < numRuns){
+        mergeRuns(out, &(runs[r]), &(runs[r + 1]));
+        runs[merged].numWords = runs[r].numWords + runs[r + 1].numWords;
+      } else {
+        memcpy(out, runs[r].words, sizeof(WordNode*) * runs[r].numWords);
+        runs[merged].numWords = runs[r].numWords;
+      }
+      runs[merged].words = out;
+      merged++;
+    }
 
-  if (fp == NULL){
-    fprintf(stderr, "Error writing to the file %s", targetFile);
-    exit(1);
+    numRuns = merged;
+    WordNode** swap = from;
+    from = to;
+    to = swap;
   }
 
-  // loop through every possible hash slot 
-  for(int i=0; i < MAX_NUMBER_OF_SLOTS; i++){
-    // loop through every word in the list
-    for ( startWordNode = index->hash[i]; startWordNode != NULL; startWordNode=startWordNode->next){
+  if (from != words){
+    memcpy(words, from, sizeof(WordNode*) * numWords);
+  }
 
-      count = 0;
-      // count the number of documents
-      for (startPage = (DocumentNode*) startWordNode->page; 
-        startPage != NULL; startPage = startPage->next){
+  free(scratch);
+}
 
-        count++;
-      }
+// Collects every WordNode from the word table and sorts them by word
+WordNode** sortedWordNodes(INVERTED_INDEX* index, int* numWords){
+  WordNode** words;
+  int count = 0;
 
-      fprintf(fp, "%s %d ", startWordNode->word, count);
+  words = (WordNode**) malloc(sizeof(WordNode*) * (index->numWords + 1));
+  MALLOC_CHECK(words);
 
-      // rest are docID and number of occurrences
-      // loop again
-      for (startPage = startWordNode->page; startPage != NULL; startPage=startPage->next){
-        // keep adding the doc identifier and the page freq until no more
-        fprintf(fp, "%d %d ", startPage->document_id, startPage->page_word_frequency);
-      }
-      fprintf(fp, "\n");
+  for (int i = 0; i < index->numSlots; i++){
+    if (index->slots[i].wordNode != NULL){
+      words[count++] = index->slots[i].wordNode;
     }
   }
 
+  sortWordNodes(words, count);
 
-  // writing is done; free resources
-  fclose(fp);
+  *numWords = count;
+  return words;
+}
+
+// Parses the number at position, skipping whatever separates it from the
+// previous one. Returns NULL if the line ends before another number
+static const char* parseNumber(const char* position, const char* end, int* value){
+  while (position < end && (*position < '0' || *position > '9')){
+    position++;
+  }
+
+  if (position == end){
+    return NULL;
+  }
 
-  // sort the outputted list with a command
+  int number = 0;
+  while (position < end && *position >= '0' && *position <= '9'){
+    number = number * 10 + (*position - '0');
+    position++;
+  }
 
-  size_t string1 = strlen("sort -o ");
-  size_t string2 = strlen(targetFile);
-  char* sortCommand = (char*) malloc(string1 + string2 + string2 + 2); // last byte
+  *value = number;
+  return position;
+}
 
-  sprintf(sortCommand, "%s%s %s", "sort -o ", targetFile, targetFile); 
-  int result = system(sortCommand);
+// Adds the postings of a "df id freq id freq ..." line to the word
+static void parsePostings(const char* position, const char* end, WordNode* wordNode,
+    INVERTED_INDEX* index){
+  int documentCount;
+  int documentId;
+  int frequency;
 
-  // check the exit status
-  if ( result != 0){
-    fprintf(stderr, "Error: Could not sort the file %s. \n", targetFile);
+  position = parseNumber(position, end, &documentCount);
 
-    free(sortCommand);
-    exit(1);
+  while (position != NULL){
+    position = parseNumber(position, end, &documentId);
+    if (position == NULL){
+      break;
+    }
+
+    position = parseNumber(position, end, &frequency);
+    if (position == NULL){
+      fprintf(stderr, "Reconstruction failed for the word %s \n", wordNode->word);
+      break;
+    }
+
+    addPosting(wordNode, documentId, frequency, index);
+  }
+}
+
+// Loads one line of a text index. The word is cut off in place, so the
+// line is looked up once and its postings are added straight to it
+static void loadIndexLine(char* line, char* end, INVERTED_INDEX* index){
+  char* wordEnd = line;
+
+  while (wordEnd < end && *wordEnd != ' '){
+    wordEnd++;
+  }
+
+  // skip empty lines
+  if (wordEnd == line){
+    return;
   }
 
-  free(sortCommand);
+  *wordEnd = '\0';
+  WordNode* wordNode = findOrAddWordNode(index, line);
+
+  if (wordEnd < end){
+    parsePostings(wordEnd + 1, end, wordNode, index);
+  }
 }
 
 // "reloads" the index data structure from the file 
 // reloadIndexFromFile: This function does the heavy lifting of 
-// "reloading" a file into an index in memory. It goes through
-// each of the characters and uses strtok to split by space
+// "reloading" a file into an index in memory. It streams the file
+// through a fixed buffer, one chunk at a time, and loads every complete
+// line with loadIndexLine. A line cut off by the end of the chunk is
+// moved to the front of the buffer and finished with the next chunk.
+// Binary index files are handed to reloadIndexFromBinaryFile
 INVERTED_INDEX* reloadIndexFromFile(char* loadFile, INVERTED_INDEX* indexReload){
   FILE* fp;
 
+  if (isIndexFile(loadFile)){
+    return reloadIndexFromBinaryFile(loadFile, indexReload);
+  }
+
   fp = fopen(loadFile, "r");
   if (fp == NULL){
     fprintf(stderr, "Error opening the file to be reloaded: %s \n", loadFile);
@@ -447,56 +1064,203 @@ INVERTED_INDEX* reloadIndexFromFile(char* loadFile, INVERTED_INDEX* indexReload)
 
   // Commence reloading the index from the file
   // indexReload has been initialized already
-  char* placeholder = NULL;
-  char* loadedFile = NULL;
-  loadedFile = loadDocument(loadFile);
+  size_t capacity = INDEX_LOAD_CHUNK;
+  size_t filled = 0;
+  char* buffer = (char*) malloc(capacity + 1); // +1 to terminate a last line without '\n'
+  MALLOC_CHECK(buffer);
+
+  // every line represents a word node with all its postings
+  while (1){
+    size_t readResult = fread(buffer + filled, 1, capacity - filled, fp);
+    filled += readResult;
+
+    int atEnd = (readResult == 0);
+    char* lineStart = buffer;
+    char* bufferEnd = buffer + filled;
+
+    // load every complete line in the buffer
+    while (lineStart < bufferEnd){
+      char* lineEnd = (char*) memchr(lineStart, '\n', bufferEnd - lineStart);
+
+      if (lineEnd == NULL){
+        if (!atEnd){
+          break; // the rest of the line is in the next chunk
+        }
+        lineEnd = bufferEnd;
+      }
+
+      loadIndexLine(lineStart, lineEnd, indexReload);
+      lineStart = lineEnd + 1;
+    }
+
+    if (atEnd){
+      break;
+    }
+
+    // keep the partial line at the front of the buffer
+    filled = lineStart < bufferEnd ? (size_t) (bufferEnd - lineStart) : 0;
+    memmove(buffer, lineStart, filled);
+
+    // a line longer than the buffer: make room for the rest of it
+    if (filled == capacity){
+      capacity *= 2;
+      buffer = (char*) realloc(buffer, capacity + 1);
+      MALLOC_CHECK(buffer);
+    }
+  }
+
+  if (ferror(fp)){
+    fprintf(stderr, "Error reading the file to be reloaded: %s \n", loadFile);
+    exit(1);
+  }
 
-  if (loadedFile == NULL){
-    fprintf(stderr, "Could not reload the index from the file! \n");
+  fclose(fp);
+  free(buffer);
+
+  return indexReload;
+}
+
+// compares two lexicon entries by their words, the same order as strcmp
+static int compareLexiconEntries(const void* a, const void* b){
+  const LEXICON_ENTRY* entryA = (const LEXICON_ENTRY*) a;
+  const LEXICON_ENTRY* entryB = (const LEXICON_ENTRY*) b;
+  int shorter = min(entryA->length, entryB->length);
+
+  int compare = memcmp(entryA->word, entryB->word, shorter);
+  if (compare != 0){
+    return compare;
+  }
+  return entryA->length - entryB->length;
+}
+
+// Maps a text index file and records where each line's word and postings
+// start. No postings are parsed here.
+static LEXICON* openLexicon(char* loadFile){
+  LEXICON* lexicon;
+  struct stat st;
+  int fd;
+  int capacity = 1024;
+  int sorted = 1;
+
+  fd = open(loadFile, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0){
+    fprintf(stderr, "Error opening the file to be reloaded: %s \n", loadFile);
     exit(1);
   }
 
-  size_t string1 = strlen(loadedFile);
+  lexicon = (LEXICON*) malloc(sizeof(LEXICON));
+  MALLOC_CHECK(lexicon);
+  BZERO(lexicon, sizeof(LEXICON));
 
-  placeholder = (char*) malloc(sizeof(char) * string1 + 1);
-  BZERO(placeholder, string1 + 1);
+  lexicon->size = (size_t) st.st_size;
+  lexicon->entries = (LEXICON_ENTRY*) malloc(sizeof(LEXICON_ENTRY) * capacity);
+  MALLOC_CHECK(lexicon->entries);
 
-  // every line represents a word node with all its Document Nodes
-  while(1){
-    // continue until end
-    if (fgets(placeholder, string1 + 1, fp) == NULL){
-      break;
-    } else {
+  if (lexicon->size == 0){
+    close(fd);
+    return lexicon;
+  }
 
-      // sanitize first so that all characters are valid to be parsed
-      sanitize(placeholder);
+  lexicon->map = mmap(NULL, lexicon->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
 
-      char buffer[string1 + 1];
-      strcpy(buffer, placeholder);
+  if (lexicon->map == MAP_FAILED){
+    fprintf(stderr, "Error mapping the file to be reloaded: %s \n", loadFile);
+    exit(1);
+  }
 
-      // takes the first word from the line
-      char* docNode;
-      char* wordNode = strtok(buffer, " ");
-      strtok(NULL, " ");
+  char* end = lexicon->map + lexicon->size;
+  char* line = lexicon->map;
 
-      while ((docNode = strtok(NULL, " ")) != NULL){
-        char* page_word_frequency = strtok(NULL, " ");
-        // insert into index here
-        int docId = atoi(docNode);
-        int pageFreq = atoi(page_word_frequency);
+  // every line represents a word with all its Document Nodes
+  while (line < end){
+    char* lineEnd = memchr(line, '\n', end - line);
+    if (lineEnd == NULL){
+      lineEnd = end;
+    }
 
-        int result = reconstructIndex(wordNode, docId, pageFreq, indexReload);
+    char* wordEnd = memchr(line, ' ', lineEnd - line);
+    if (wordEnd != NULL && wordEnd > line){
+      if (lexicon->numWords == capacity){
+        capacity *= 2;
+        lexicon->entries = (LEXICON_ENTRY*) realloc(lexicon->entries, sizeof(LEXICON_ENTRY) * capacity);
+        MALLOC_CHECK(lexicon->entries);
+      }
 
-        if (result != 1){
-          fprintf(stderr, "Reconstruction failed for the word %s \n", wordNode);
-        }
+      LEXICON_ENTRY* entry = &(lexicon->entries[lexicon->numWords]);
+      entry->word = line;
+      entry->length = (int) (wordEnd - line);
+      entry->postings = wordEnd + 1;
+
+      // saveIndexToFile writes the lines sorted; anything else gets sorted below
+      if (lexicon->numWords > 0 && compareLexiconEntries(entry - 1, entry) > 0){
+        sorted = 0;
       }
+      lexicon->numWords++;
     }
+
+    line = lineEnd + 1;
   }
 
-  fclose(fp);
-  free(placeholder);
-  free(loadedFile);
+  if (!sorted){
+    qsort(lexicon->entries, lexicon->numWords, sizeof(LEXICON_ENTRY), compareLexiconEntries);
+  }
+
+  return lexicon;
+}
+
+// Binary search for word in the sorted lexicon
+static LEXICON_ENTRY* findLexiconEntry(LEXICON* lexicon, char* word){
+  LEXICON_ENTRY key;
+  key.word = word;
+  key.length = (int) strlen(word);
+
+  return (LEXICON_ENTRY*) bsearch(&key, lexicon->entries, lexicon->numWords,
+      sizeof(LEXICON_ENTRY), compareLexiconEntries);
+}
+
+// Parses "df id freq id freq ..." up to the end of the line into the index
+static void decodeLexiconEntry(LEXICON* lexicon, LEXICON_ENTRY* entry, char* word,
+    INVERTED_INDEX* index){
+  const char* end = lexicon->map + lexicon->size;
+  const char* lineEnd = (const char*) memchr(entry->postings, '\n', end - entry->postings);
+
+  if (lineEnd == NULL){
+    lineEnd = end;
+  }
+
+  parsePostings(entry->postings, lineEnd, findOrAddWordNode(index, word), index);
+}
+
+// Opens the index without reconstructing any postings
+INVERTED_INDEX* openIndexLazily(char* loadFile, INVERTED_INDEX* indexReload){
+  if (isIndexFile(loadFile)){
+    indexReload->file = openIndexFile(loadFile);
+    if (indexReload->file == NULL){
+      return NULL;
+    }
+  } else {
+    indexReload->lexicon = openLexicon(loadFile);
+  }
 
   return indexReload;
 }
+
+// Looks the word up in the word table. On a miss in a lazily opened text
+// index, the word's line is decoded into the index and looked up again.
+WordNode* lookUpWordNode(INVERTED_INDEX* index, char* word){
+  WordNode* wordNode = findWordNode(index, word);
+
+  if (wordNode != NULL || index->lexicon == NULL){
+    return wordNode;
+  }
+
+  LEXICON_ENTRY* entry = findLexiconEntry(index->lexicon, word);
+  if (entry == NULL){
+    return NULL;
+  }
+
+  decodeLexiconEntry(index->lexicon, entry, word, index);
+
+  return findWordNode(index, word);
+}
@@ -5,10 +5,44 @@
 // File: index.c
 // Author: Delos Chang
 // This file contains useful information for implementing the indexer:
+// - INCLUDES
+// - DEFINES
 // - DATA STRUCTURES
 // - PROTOTYPES
 
-// represents the document that was found with the word contained. 
+// INCLUDES
+
+#include "arena.h"
+#include "postings.h"
+
+// DEFINES
+
+// The word table starts with this many slots (a power of two) and
+// doubles whenever it becomes more than INDEX_MAX_LOAD_PERCENT full.
+// Keeping it sparse keeps the probe sequences short, so a lookup is
+// O(1) however many words are indexed.
+#define INDEX_INITIAL_SLOTS 1024
+#define INDEX_MAX_LOAD_PERCENT 70
+
+// sortedWordNodes splits indexes of at least INDEX_PARALLEL_SORT_MIN
+// words into one run per CPU (at most INDEX_MAX_SORT_THREADS), sorts the
+// runs in parallel and merges them
+#define INDEX_PARALLEL_SORT_MIN 65536
+#define INDEX_MAX_SORT_THREADS 8
+
+// reloadIndexFromFile reads text index files this many bytes at a time
+#define INDEX_LOAD_CHUNK (1024 * 1024)
+
+// The postings of a word are kept sorted by document id and compressed
+// into blocks and a varint tail (see postings.h), so adding a posting for
+// the document being indexed is O(1) and reading them is a sequential
+// scan. The buffer starts with INDEX_FIRST_POSTINGS_BYTES bytes and
+// doubles when full.
+#define INDEX_FIRST_POSTINGS_BYTES 8
+
+// represents the document that was found with the word contained.
+// Only used for the lists built by the query engine; the index itself
+// keeps its postings compressed in each WordNode
 typedef struct _DocumentNode {
   struct _DocumentNode *next;        // pointer to the next member of the list.
   int document_id;                   // document identifier
@@ -17,20 +51,57 @@ typedef struct _DocumentNode {
 
 // fills each hash slot 
 typedef struct _WordNode {
-  struct _WordNode *prev;           // pointer to the previous word
-  struct _WordNode *next;           // pointer to the next word
-  char word[WORD_LENGTH];           // the word
-  DocumentNode  *page;              // pointer to the first element of the page list.
+  char *word;                       // the word (NUL terminated, in the index's word arena)
+  int length;                       // length of the word
+  int numPages;                     // number of documents containing the word
+  int lastDocumentId;               // largest document id in the postings
+  int lastFrequency;                // occurrences of the word in that document
+  int lastFrequencyOffset;          // byte where that frequency is encoded
+  int postingsLength;               // bytes of encoded postings
+  int blocksLength;                 // bytes of its sealed blocks (the tail follows)
+  int maxPostingsLength;            // room in the postings buffer
+  unsigned char *postings;          // blocks and tail, by document id
 } WordNode;
 
+// one slot of the open addressing word table. The full hash of the word
+// is stored next to it so that probing only compares words whose hashes
+// match.
+typedef struct _WORD_SLOT {
+  unsigned long hash;               // hash1() of the word
+  WordNode *wordNode;               // NULL if the slot is empty
+} WORD_SLOT;
+
+
+// one line of a lazily opened text index file
+typedef struct _LEXICON_ENTRY {
+  const char *word;                     // start of the word in the file (not NUL terminated)
+  int length;                           // length of the word
+  const char *postings;                 // rest of the line ("df id freq id freq ...")
+} LEXICON_ENTRY;
+
+// the words of a lazily opened text index file, sorted. The postings
+// of a word are only parsed the first time the word is looked up.
+typedef struct _LEXICON {
+  char *map;                            // mapped index file
+  size_t size;                          // size of the mapping
+  LEXICON_ENTRY *entries;               // one entry per line, sorted by word
+  int numWords;                         // number of entries
+} LEXICON;
 
 typedef struct _INVERTED_INDEX {
-                                        // Start and end pointer of the dynamic links.
-  WordNode *start;                      // start of the list
-  WordNode *end;                        // end of the list
-  WordNode *hash[MAX_NUMBER_OF_SLOTS];  // hash slot
+  ARENA *wordArena;                     // every word of the index, stored back to back
+  ARENA *nodeArena;                     // every WordNode and postings buffer of the index
+  WORD_SLOT *slots;                     // open addressing table, linear probing
+  int numSlots;                         // size of the table (a power of two)
+  int numWords;                         // number of occupied slots
+  struct _INDEX_FILE *file;             // mapped binary index queried in place (or NULL)
+  LEXICON *lexicon;                     // lazily opened text index (or NULL)
 } INVERTED_INDEX;
 
+// formats saveIndexToFile can write
+#define INDEX_FORMAT_TEXT 0             // "cat 2 2 3 4 5" lines, sorted
+#define INDEX_FORMAT_BINARY 1           // mmap-able binary file (see indexfile.h)
+
 // function PROTOTYPES 
 
 // initReloadStructure: This function initializes the reloaded index structure that will be used
@@ -39,34 +110,109 @@ typedef struct _INVERTED_INDEX {
 // properly retrieved
 INVERTED_INDEX* initStructure(INVERTED_INDEX* index);
 
+// findWordNode: returns the WordNode of word in the table, or NULL
+WordNode* findWordNode(INVERTED_INDEX* index, char* word);
+
+// addWordNode: inserts a WordNode whose word is not in the table yet,
+// growing the table first if it is too full
+void addWordNode(INVERTED_INDEX* index, WordNode* wordNode);
+
 // "reloads" the index data structure from the file 
 // reloadIndexFromFile: This function does the heavy lifting of 
-// "reloading" a file into an index in memory. It goes through
-// each of the characters and uses strtok to split by space
+// "reloading" a file into an index in memory. A text file is read in
+// INDEX_LOAD_CHUNK sized chunks and each line is split in place: the
+// word is looked up once and the numbers after it are parsed straight
+// into its postings. Binary files are handed to reloadIndexFromBinaryFile
 INVERTED_INDEX* reloadIndexFromFile(char* loadFile, INVERTED_INDEX* indexReload);
 
+// openIndexLazily: opens an index file without reconstructing it. A binary
+// file is mapped and searched in place. A text file is mapped and only the
+// word at the start of each line is recorded; the postings of a word are
+// parsed into the index the first time lookUpWordNode asks for it.
+INVERTED_INDEX* openIndexLazily(char* loadFile, INVERTED_INDEX* indexReload);
 
+// lookUpWordNode: returns the WordNode of word, or NULL if it was not
+// indexed. With a lazily opened text index, the word's postings are
+// decoded into the index on the first lookup (see findWordNode).
+WordNode* lookUpWordNode(INVERTED_INDEX* index, char* word);
+
+
+// reconstructIndex: this function will reconstruct the entire index with a
+// word, document ID and page frequency passed to it. It is used in 
+// debug mode to ensure that the index can be "reloaded" 
+int reconstructIndex(char* word, int documentId, int page_word_frequency, INVERTED_INDEX* indexReload);
+
+// newDocNode: mallocs a standalone DocumentNode (e.g. for query results).
+// The caller frees it. Postings inside an index are added with addPosting
 DocumentNode* newDocNode(DocumentNode* docNode, int docId, int page_freq);
 
-WordNode* newWordNode(WordNode* wordNode, DocumentNode* docNode, char* word);
+// newWordNode: creates a WordNode for word with no postings yet. The
+// node and the word are allocated from the arenas of the index the node is
+// going to be added to, and are freed together with that index
+WordNode* newWordNode(WordNode* wordNode, char* word, INVERTED_INDEX* index);
+
+// addPosting: records page_freq occurrences of the word in document docId.
+// The frequencies are added up if the word already has that document.
+// Documents arriving in ascending order (as the indexer produces them)
+// are appended in O(1); any other document makes the word's postings be
+// re-encoded with the document in its sorted place
+void addPosting(WordNode* wordNode, int docId, int page_freq, INVERTED_INDEX* index);
+
+// removeDocuments: drops every posting of the documents whose removed[id]
+// is set (for ids up to lastDocumentId) and the words left without any
+void removeDocuments(INVERTED_INDEX* index, const char* removed, int lastDocumentId);
+
+// startWordPostings: points a cursor at the postings of wordNode
+void startWordPostings(POSTINGS_CURSOR* cursor, WordNode* wordNode);
 
 char* loadDocument(char* filepath);
 
 // saves the inverted index into a file
-// returns 1 if successful, 0 if not
 // saveIndexToFile: this function will save the index in memory to a file
-// by going through each WordNode and Document Node, parsing them 
-// and writing them in the specified format
+// by going through each WordNode, sorted by word, and its postings,
+// writing them in the specified format
 // cat 2 2 3 4 5 
 // the first 2 indicates that there are 2 documents with 'cat' found
 // the second 2 indicates the document ID with 3 occurrences of 'cat'
 // the 4 indicates the document ID with 5 occurrences of 'cat'
-void saveIndexToFile(INVERTED_INDEX* index, char* targetFile);
-
+// With INDEX_FORMAT_BINARY the index is written as a binary file instead
+void saveIndexToFile(INVERTED_INDEX* index, char* targetFile, int format);
+
+// sortedWordNodes: returns a malloc'ed array of every WordNode in the
+// index sorted by word (byte order, as strcmp, whatever the locale).
+// Large indexes are sorted by several threads. The number of words is
+// stored in numWords
+WordNode** sortedWordNodes(INVERTED_INDEX* index, int* numWords);
+
+// mergeIndexes: moves every word and posting of the partial indexes into
+// index, merging the postings of the words they share. The documents of
+// partials[i] must all come before those of partials[i + 1], so that the
+// postings only ever get appended and come out as if index had been built
+// on its own. The words are split by hash between numThreads threads.
+// The partial indexes are freed (their nodes now belong to index)
+void mergeIndexes(INVERTED_INDEX* index, INVERTED_INDEX** partials, int numPartials,
+    int numThreads);
+
+// cleanUpIndex: frees the whole index. All the nodes and words live in
+// the index's arenas, so this does not walk the postings
 void cleanUpIndex(INVERTED_INDEX* index);
 
+// emptyIndex: frees every word and posting of the index and leaves it
+// empty, ready to be filled again (e.g. after it was spilled to a run)
+void emptyIndex(INVERTED_INDEX* index);
+
+// indexMemoryUsed: returns roughly how many bytes the words, postings and
+// word table of the index take up
+size_t indexMemoryUsed(INVERTED_INDEX* index);
+
+// sanitize: strips the characters that are not parsed into words from
+// the buffer, in place and in a single pass
 void sanitize(char* loadedDocument);
 
+// sanitizeKeepsCharacter: returns 1 if sanitize keeps the character c,
+// 0 if it strips it
+int sanitizeKeepsCharacter(char c);
+
 void capitalToLower(char* buffer);
 
 #endif
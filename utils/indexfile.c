@@ -0,0 +1,471 @@
+/*
+
+FILE: indexfile.c
+Description: Binary, memory-mappable storage for the INVERTED INDEX. Such as:
+
+0. Writing the index in memory (or word by word) to a versioned binary file
+1. Mapping a binary index file and validating it
+2. Looking up a word and its postings in place in the mapping
+   (or the document bitmap of a dense word)
+3. Reconstructing an inverted index from a binary file into memory
+
+The text index.dat has to be parsed posting by posting on every load.
+The binary file is laid out so that the query engine can mmap it and
+search it directly (see indexfile.h for the layout).
+
+By: Delos Chang
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../utils/header.h"
+#include "index.h"
+#include "indexfile.h"
+
+// Checks the magic bytes at the start of the file
+int isIndexFile(char* path){
+  char magic[INDEX_FILE_MAGIC_LENGTH];
+  FILE* fp;
+  size_t readResult;
+
+  fp = fopen(path, "r");
+  if (fp == NULL){
+    return 0;
+  }
+
+  readResult = fread(magic, 1, INDEX_FILE_MAGIC_LENGTH, fp);
+  fclose(fp);
+
+  if (readResult != INDEX_FILE_MAGIC_LENGTH){
+    return 0;
+  }
+
+  return !memcmp(magic, INDEX_FILE_MAGIC, INDEX_FILE_MAGIC_LENGTH);
+}
+
+// writes size bytes to fp or aborts
+static void writeOrDie(const void* data, size_t size, FILE* fp, char* targetFile){
+  if (size && fwrite(data, 1, size, fp) != size){
+    fprintf(stderr, "Error writing to the file %s \n", targetFile);
+    exit(1);
+  }
+}
+
+// Writes the header, then leaves the dictionary, strings and postings
+// streams positioned at the start of their sections. The three streams
+// fill disjoint parts of the file, so words can be written one at a time
+INDEX_FILE_WRITER* startIndexFileWriter(char* targetFile, uint32_t numWords,
+    uint64_t stringsSize, uint64_t numPostings){
+  INDEX_FILE_HEADER header;
+  FILE* fp;
+
+  INDEX_FILE_WRITER* writer = (INDEX_FILE_WRITER*) malloc(sizeof(INDEX_FILE_WRITER));
+  MALLOC_CHECK(writer);
+  BZERO(writer, sizeof(INDEX_FILE_WRITER));
+
+  writer->targetFile = targetFile;
+
+  BZERO(&header, sizeof(INDEX_FILE_HEADER));
+  memcpy(header.magic, INDEX_FILE_MAGIC, INDEX_FILE_MAGIC_LENGTH);
+  header.version = INDEX_FILE_VERSION;
+  header.numWords = numWords;
+  header.numPostings = numPostings;
+  header.dictionaryOffset = sizeof(INDEX_FILE_HEADER);
+  header.stringsOffset = header.dictionaryOffset + (uint64_t) numWords * sizeof(INDEX_FILE_TERM);
+  header.postingsOffset = ALIGN8(header.stringsOffset + stringsSize);
+  header.fileSize = 0; // filled in once the postings are written
+
+  fp = fopen(targetFile, "w");
+  if (fp == NULL){
+    fprintf(stderr, "Error writing to the file %s", targetFile);
+    exit(1);
+  }
+
+  writeOrDie(&header, sizeof(INDEX_FILE_HEADER), fp, targetFile);
+
+  // padding up to the postings, so every section exists before it is
+  // written through its own stream
+  char padding[8] = { 0 };
+  if (fseek(fp, header.stringsOffset + stringsSize, SEEK_SET) != 0){
+    fprintf(stderr, "Error writing to the file %s \n", targetFile);
+    exit(1);
+  }
+  writeOrDie(padding, header.postingsOffset - (header.stringsOffset + stringsSize), fp, targetFile);
+
+  writer->dictionary = fp;
+  writer->strings = fopen(targetFile, "r+");
+  writer->postings = fopen(targetFile, "r+");
+  if (writer->strings == NULL || writer->postings == NULL
+      || fseek(writer->dictionary, header.dictionaryOffset, SEEK_SET) != 0
+      || fseek(writer->strings, header.stringsOffset, SEEK_SET) != 0
+      || fseek(writer->postings, header.postingsOffset, SEEK_SET) != 0){
+    fprintf(stderr, "Error writing to the file %s \n", targetFile);
+    exit(1);
+  }
+
+  writer->header = header;
+  return writer;
+}
+
+// Builds the document bitmap of a word from its postings, if that and
+// its frequencies would take fewer bytes than the postings do. Returns
+// NULL otherwise. Sets the bytes each frequency needs
+static DOC_BITMAP* denseWordBitmap(int documentCount, const unsigned char* postings,
+    int postingsLength, int* frequencyWidth){
+  POSTINGS_CURSOR cursor;
+  int maxFrequency = 0;
+
+  if (documentCount < INDEX_FILE_BITMAP_MIN_DOCUMENTS){
+    return NULL;
+  }
+
+  DOC_BITMAP_BUILDER* builder = newDocBitmapBuilder();
+  startPostings(&cursor, postings, documentCount);
+  while (nextPosting(&cursor)){
+    addToDocBitmap(builder, cursor.documentId);
+    if (cursor.frequency > maxFrequency){
+      maxFrequency = cursor.frequency;
+    }
+  }
+  DOC_BITMAP* bitmap = finishDocBitmap(builder);
+
+  *frequencyWidth = maxFrequency <= 0xFF ? 1 : (maxFrequency <= 0xFFFF ? 2 : 4);
+
+  // counting the padding that puts the bitmap at a multiple of 8
+  if (bitmap->length + (size_t) documentCount * *frequencyWidth + 7 >= (size_t) postingsLength){
+    freeDocBitmap(bitmap);
+    return NULL;
+  }
+
+  return bitmap;
+}
+
+// Writes the frequencies of the postings, width bytes each
+static void writeFrequencies(INDEX_FILE_WRITER* writer, int documentCount,
+    const unsigned char* postings, int width){
+  unsigned char buffer[4 * POSTINGS_BLOCK_SIZE];
+  POSTINGS_CURSOR cursor;
+  size_t length = 0;
+
+  startPostings(&cursor, postings, documentCount);
+  while (nextPosting(&cursor)){
+    uint32_t frequency32 = (uint32_t) cursor.frequency;
+    uint16_t frequency16 = (uint16_t) cursor.frequency;
+    uint8_t frequency8 = (uint8_t) cursor.frequency;
+
+    if (width == 1){
+      memcpy(buffer + length, &frequency8, 1);
+    } else if (width == 2){
+      memcpy(buffer + length, &frequency16, 2);
+    } else {
+      memcpy(buffer + length, &frequency32, 4);
+    }
+    length += width;
+
+    if (length == sizeof(buffer)){
+      writeOrDie(buffer, length, writer->postings, writer->targetFile);
+      length = 0;
+    }
+  }
+
+  writeOrDie(buffer, length, writer->postings, writer->targetFile);
+}
+
+// Appends one dictionary entry, its word and its postings, or the
+// document bitmap and frequencies of a dense word
+void writeIndexFileTerm(INDEX_FILE_WRITER* writer, const char* word, int wordLength,
+    int documentCount, const unsigned char* postings, int postingsLength){
+  INDEX_FILE_TERM term;
+  int frequencyWidth = 0;
+
+  DOC_BITMAP* bitmap = denseWordBitmap(documentCount, postings, postingsLength, &frequencyWidth);
+
+  // bitmaps are used in place, so they start at a multiple of 8
+  if (bitmap != NULL){
+    char padding[8] = { 0 };
+    uint64_t aligned = ALIGN8(writer->postingsOffset);
+
+    writeOrDie(padding, aligned - writer->postingsOffset, writer->postings, writer->targetFile);
+    writer->postingsOffset = aligned;
+  }
+
+  BZERO(&term, sizeof(INDEX_FILE_TERM));
+  term.wordOffset = writer->wordOffset;
+  term.wordLength = (uint32_t) wordLength;
+  term.documentCount = (uint32_t) documentCount;
+  term.postingsLength = (uint32_t) postingsLength;
+  term.postingsOffset = writer->postingsOffset;
+  term.postingsFormat = INDEX_FILE_POSTINGS_BLOCKS;
+
+  if (bitmap != NULL){
+    term.postingsFormat = INDEX_FILE_POSTINGS_BITMAP;
+    term.frequencyWidth = (uint16_t) frequencyWidth;
+    term.bitmapLength = (uint32_t) bitmap->length;
+    term.postingsLength = (uint32_t) (bitmap->length + (size_t) documentCount * frequencyWidth);
+  }
+
+  writeOrDie(&term, sizeof(INDEX_FILE_TERM), writer->dictionary, writer->targetFile);
+
+  // the word strings are NUL terminated so they can be used in place
+  writeOrDie(word, wordLength, writer->strings, writer->targetFile);
+  writeOrDie("", 1, writer->strings, writer->targetFile);
+
+  if (bitmap != NULL){
+    writeOrDie(bitmap->data, bitmap->length, writer->postings, writer->targetFile);
+    writeFrequencies(writer, documentCount, postings, frequencyWidth);
+    freeDocBitmap(bitmap);
+  } else {
+    // the postings are already compressed, so they are copied out unchanged
+    writeOrDie(postings, postingsLength, writer->postings, writer->targetFile);
+  }
+
+  writer->wordOffset += term.wordLength + 1;
+  writer->postingsOffset += term.postingsLength;
+  writer->numWords++;
+}
+
+// Checks that the sections were filled as announced, writes the final
+// size into the header and closes the streams
+void finishIndexFileWriter(INDEX_FILE_WRITER* writer){
+  INDEX_FILE_HEADER* header = &(writer->header);
+  int failed = 0;
+
+  if (writer->numWords != header->numWords
+      || header->stringsOffset + writer->wordOffset > header->postingsOffset){
+    fprintf(stderr, "Error: the words written to %s do not match its header \n",
+        writer->targetFile);
+    exit(1);
+  }
+
+  header->fileSize = header->postingsOffset + writer->postingsOffset;
+
+  failed |= fclose(writer->postings) != 0;
+  failed |= fclose(writer->strings) != 0;
+
+  if (fseek(writer->dictionary, 0, SEEK_SET) != 0){
+    failed = 1;
+  } else {
+    writeOrDie(header, sizeof(INDEX_FILE_HEADER), writer->dictionary, writer->targetFile);
+  }
+  failed |= fclose(writer->dictionary) != 0;
+
+  if (failed){
+    fprintf(stderr, "Error writing to the file %s \n", writer->targetFile);
+    exit(1);
+  }
+
+  free(writer);
+}
+
+// saves the inverted index into a binary file
+// saveIndexToBinaryFile: sorts the words, sizes up the sections and then
+// writes every word through an INDEX_FILE_WRITER
+void saveIndexToBinaryFile(INVERTED_INDEX* index, char* targetFile){
+  WordNode** words;
+  int numWords;
+
+  words = sortedWordNodes(index, &numWords);
+
+  // size up every section before writing anything
+  uint64_t stringsSize = 0;
+  uint64_t numPostings = 0;
+  for (int i = 0; i < numWords; i++){
+    stringsSize += words[i]->length + 1;
+    numPostings += words[i]->numPages;
+  }
+
+  INDEX_FILE_WRITER* writer = startIndexFileWriter(targetFile, (uint32_t) numWords,
+      stringsSize, numPostings);
+
+  for (int i = 0; i < numWords; i++){
+    writeIndexFileTerm(writer, words[i]->word, words[i]->length, words[i]->numPages,
+        words[i]->postings, words[i]->postingsLength);
+  }
+
+  finishIndexFileWriter(writer);
+  free(words);
+}
+
+// Maps the file and checks that every section lies inside the mapping
+INDEX_FILE* openIndexFile(char* path){
+  INDEX_FILE* indexFile;
+  const INDEX_FILE_HEADER* header;
+  struct stat st;
+  void* map;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0){
+    fprintf(stderr, "Error opening the index file: %s \n", path);
+    return NULL;
+  }
+
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(INDEX_FILE_HEADER)){
+    fprintf(stderr, "Error: %s is too small to be an index file \n", path);
+    close(fd);
+    return NULL;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps its own reference
+
+  if (map == MAP_FAILED){
+    fprintf(stderr, "Error mapping the index file: %s \n", path);
+    return NULL;
+  }
+
+  header = (const INDEX_FILE_HEADER*) map;
+
+  // validate the header before trusting any offsets in it
+  if (memcmp(header->magic, INDEX_FILE_MAGIC, INDEX_FILE_MAGIC_LENGTH) != 0
+    || header->version != INDEX_FILE_VERSION
+    || header->fileSize != (uint64_t) st.st_size
+    || header->stringsOffset != header->dictionaryOffset
+      + (uint64_t) header->numWords * sizeof(INDEX_FILE_TERM)
+    || header->postingsOffset < header->stringsOffset
+    || header->postingsOffset % 8 != 0
+    || header->postingsOffset > header->fileSize){
+    fprintf(stderr, "Error: %s is not a valid version %d index file \n", path, INDEX_FILE_VERSION);
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  indexFile = (INDEX_FILE*) malloc(sizeof(INDEX_FILE));
+  MALLOC_CHECK(indexFile);
+
+  indexFile->map = (const unsigned char*) map;
+  indexFile->size = (size_t) st.st_size;
+  indexFile->header = header;
+  indexFile->terms = (const INDEX_FILE_TERM*) (indexFile->map + header->dictionaryOffset);
+  indexFile->strings = (const char*) (indexFile->map + header->stringsOffset);
+  indexFile->postings = indexFile->map + header->postingsOffset;
+  indexFile->postingsSize = header->fileSize - header->postingsOffset;
+
+  return indexFile;
+}
+
+void closeIndexFile(INDEX_FILE* indexFile){
+  if (indexFile == NULL){
+    return;
+  }
+
+  munmap((void*) indexFile->map, indexFile->size);
+  free(indexFile);
+}
+
+const char* getIndexFileWord(INDEX_FILE* indexFile, const INDEX_FILE_TERM* term){
+  return indexFile->strings + term->wordOffset;
+}
+
+// A term whose postings would run past the end of the file is treated
+// as having none
+void startIndexFilePostings(POSTINGS_CURSOR* cursor, INDEX_FILE* indexFile,
+    const INDEX_FILE_TERM* term){
+  DOC_BITMAP bitmap;
+
+  if (term->postingsOffset + term->postingsLength > indexFile->postingsSize){
+    fprintf(stderr, "Error: the postings of %s are out of bounds \n",
+        getIndexFileWord(indexFile, term));
+    startPostings(cursor, indexFile->postings, 0);
+    return;
+  }
+
+  if (term->postingsFormat == INDEX_FILE_POSTINGS_BITMAP){
+    if (!openIndexFileBitmap(indexFile, term, &bitmap)){
+      startPostings(cursor, indexFile->postings, 0);
+      return;
+    }
+
+    startBitmapPostings(cursor, &bitmap,
+        indexFile->postings + term->postingsOffset + term->bitmapLength, term->frequencyWidth);
+    return;
+  }
+
+  startPostings(cursor, indexFile->postings + term->postingsOffset,
+      (int) term->documentCount);
+}
+
+// The bitmap and the frequencies of all its documents have to fit in
+// the postings of the term
+int openIndexFileBitmap(INDEX_FILE* indexFile, const INDEX_FILE_TERM* term, DOC_BITMAP* bitmap){
+  if (term->postingsFormat != INDEX_FILE_POSTINGS_BITMAP){
+    return 0;
+  }
+
+  if (term->postingsOffset + term->postingsLength > indexFile->postingsSize
+      || (term->frequencyWidth != 1 && term->frequencyWidth != 2 && term->frequencyWidth != 4)
+      || term->bitmapLength + (uint64_t) term->documentCount * term->frequencyWidth
+        > term->postingsLength
+      || !openDocBitmap(bitmap, indexFile->postings + term->postingsOffset, term->bitmapLength)
+      || (uint32_t) docBitmapCardinality(bitmap) != term->documentCount){
+    fprintf(stderr, "Error: the document bitmap of %s is not valid \n",
+        getIndexFileWord(indexFile, term));
+    return 0;
+  }
+
+  return 1;
+}
+
+// Binary search over the sorted dictionary
+const INDEX_FILE_TERM* findIndexFileTerm(INDEX_FILE* indexFile, char* word){
+  long low = 0;
+  long high = (long) indexFile->header->numWords - 1;
+
+  while (low <= high){
+    long middle = low + (high - low) / 2;
+    const INDEX_FILE_TERM* term = &(indexFile->terms[middle]);
+
+    int compare = strcmp(getIndexFileWord(indexFile, term), word);
+    if (compare == 0){
+      return term;
+    } else if (compare < 0){
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  return NULL;
+}
+
+// "reloads" the index data structure from a binary file
+// reloadIndexFromBinaryFile: walks the dictionary and its postings and
+// reconstructs each (word, docId, freq) without parsing any text
+INVERTED_INDEX* reloadIndexFromBinaryFile(char* loadFile, INVERTED_INDEX* indexReload){
+  INDEX_FILE* indexFile = openIndexFile(loadFile);
+  POSTINGS_CURSOR cursor;
+
+  if (indexFile == NULL){
+    fprintf(stderr, "Could not reload the index from the file! \n");
+    exit(1);
+  }
+
+  for (uint32_t i = 0; i < indexFile->header->numWords; i++){
+    const INDEX_FILE_TERM* term = &(indexFile->terms[i]);
+    char* word = (char*) getIndexFileWord(indexFile, term);
+
+    startIndexFilePostings(&cursor, indexFile, term);
+    while (nextPosting(&cursor)){
+      int result = reconstructIndex(word, cursor.documentId,
+          cursor.frequency, indexReload);
+
+      if (result != 1){
+        fprintf(stderr, "Reconstruction failed for the word %s \n", word);
+      }
+    }
+  }
+
+  closeIndexFile(indexFile);
+
+  return indexReload;
+}
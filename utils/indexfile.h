@@ -0,0 +1,168 @@
+#ifndef _INDEXFILE_H_
+#define _INDEXFILE_H_
+
+// *****************Impementation Spec********************************
+// File: indexfile.c
+// Author: Delos Chang
+// This file contains useful information for the binary index file:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// Layout of a binary index file (all integers in host byte order):
+//
+//   INDEX_FILE_HEADER
+//   INDEX_FILE_TERM[numWords]         term dictionary, sorted by word
+//   char strings[]                    NUL terminated words
+//   unsigned char postings[]          compressed postings, grouped by word
+//
+// The postings of a word are blocks of (gap, frequency) pairs and a
+// varint tail, exactly as the WordNodes keep them in memory (see
+// postings.h).
+//
+// Dense words, whose document ids take fewer bytes as a document bitmap
+// (see docbitmap.h), are stored as that bitmap followed by their
+// frequencies in document order, all frequencyWidth bytes wide:
+//
+//   bitmap[bitmapLength]              at a multiple of 8 in the file
+//   frequencies[documentCount]
+//
+// The writer picks which, word by word, as the file is built. The query
+// engine ANDs the bitmaps of dense words in place, and looks documents
+// up in them without decoding their postings.
+//
+// The file is meant to be mmap'ed and queried in place: looking up a
+// word is a binary search over the dictionary and its postings are a
+// contiguous run of bytes inside the mapping, decoded on the fly with a
+// POSTINGS_CURSOR. Nothing is parsed or malloc'ed.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "postings.h"
+
+// DEFINES
+
+// first bytes of every binary index file
+#define INDEX_FILE_MAGIC "TSEINDEX"
+#define INDEX_FILE_MAGIC_LENGTH 8
+
+// bump whenever the layout below changes
+// (version 1 stored every posting as two uint32s, version 2 as varints
+// without blocks, version 3 had no document bitmaps, version 4 had no
+// block headers)
+#define INDEX_FILE_VERSION 5
+
+// how the postings of a word are stored
+#define INDEX_FILE_POSTINGS_BLOCKS 0
+#define INDEX_FILE_POSTINGS_BITMAP 1
+
+// words in fewer documents are always stored as blocks (a bitmap would
+// not be smaller)
+#define INDEX_FILE_BITMAP_MIN_DOCUMENTS 64
+
+// rounds x up to the next multiple of 8 so the postings start aligned
+#define ALIGN8(x) (((x) + 7) & ~((uint64_t) 7))
+
+// DATA STRUCTURES
+
+typedef struct _INDEX_FILE_HEADER {
+  char magic[INDEX_FILE_MAGIC_LENGTH];  // INDEX_FILE_MAGIC, not NUL terminated
+  uint32_t version;                     // INDEX_FILE_VERSION
+  uint32_t numWords;                    // number of entries in the dictionary
+  uint64_t numPostings;                 // number of (docId, freq) postings
+  uint64_t dictionaryOffset;            // byte offset of the term dictionary
+  uint64_t stringsOffset;               // byte offset of the word strings
+  uint64_t postingsOffset;              // byte offset of the postings
+  uint64_t fileSize;                    // total size in bytes
+} INDEX_FILE_HEADER;
+
+// one entry of the term dictionary
+typedef struct _INDEX_FILE_TERM {
+  uint32_t wordOffset;                  // offset of the word in the strings
+  uint32_t wordLength;                  // length of the word without the NUL
+  uint32_t documentCount;               // number of documents with the word
+  uint32_t postingsLength;              // bytes of its compressed postings
+  uint64_t postingsOffset;              // where they start in the postings
+  uint16_t postingsFormat;              // INDEX_FILE_POSTINGS_BLOCKS or _BITMAP
+  uint16_t frequencyWidth;              // bitmap: bytes of each frequency (1, 2 or 4)
+  uint32_t bitmapLength;                // bitmap: bytes of the document bitmap
+} INDEX_FILE_TERM;
+
+// an opened (mmap'ed) binary index file
+typedef struct _INDEX_FILE {
+  const unsigned char *map;             // start of the mapping
+  size_t size;                          // size of the mapping
+  const INDEX_FILE_HEADER *header;
+  const INDEX_FILE_TERM *terms;
+  const char *strings;
+  const unsigned char *postings;
+  uint64_t postingsSize;                // bytes of the postings section
+} INDEX_FILE;
+
+// a binary index file being written one word at a time, in sorted
+// order. The number of words and the size of their strings have to be
+// known up front so that every section can be placed
+typedef struct _INDEX_FILE_WRITER {
+  char *targetFile;
+  FILE *dictionary;                     // positioned in the term dictionary
+  FILE *strings;                        // positioned in the word strings
+  FILE *postings;                       // positioned in the postings
+  INDEX_FILE_HEADER header;
+  uint32_t numWords;                    // words written so far
+  uint32_t wordOffset;                  // bytes of strings written so far
+  uint64_t postingsOffset;              // bytes of postings written so far
+} INDEX_FILE_WRITER;
+
+// function PROTOTYPES
+
+// isIndexFile: returns 1 if the file at path starts with INDEX_FILE_MAGIC,
+// 0 otherwise (e.g. the text index.dat format)
+int isIndexFile(char* path);
+
+// saveIndexToBinaryFile: writes the index in memory to targetFile in the
+// binary format described above. Words are written in sorted order.
+void saveIndexToBinaryFile(INVERTED_INDEX* index, char* targetFile);
+
+// startIndexFileWriter: creates targetFile for numWords words whose strings
+// take stringsSize bytes (NULs included) and numPostings postings in all
+INDEX_FILE_WRITER* startIndexFileWriter(char* targetFile, uint32_t numWords,
+    uint64_t stringsSize, uint64_t numPostings);
+
+// writeIndexFileTerm: writes the next word (in sorted order) and its
+// documentCount compressed postings
+void writeIndexFileTerm(INDEX_FILE_WRITER* writer, const char* word, int wordLength,
+    int documentCount, const unsigned char* postings, int postingsLength);
+
+// finishIndexFileWriter: completes the header, closes the file and frees
+// the writer. Aborts if not as many words were written as announced
+void finishIndexFileWriter(INDEX_FILE_WRITER* writer);
+
+// openIndexFile: maps a binary index file into memory and validates its
+// header. Returns NULL if the file is not a valid binary index.
+INDEX_FILE* openIndexFile(char* path);
+
+// closeIndexFile: unmaps the file and frees the handle
+void closeIndexFile(INDEX_FILE* indexFile);
+
+// findIndexFileTerm: binary searches the dictionary for word. Returns
+// the matching entry or NULL if the word was not indexed
+const INDEX_FILE_TERM* findIndexFileTerm(INDEX_FILE* indexFile, char* word);
+
+// getIndexFileWord: returns the NUL terminated word of a dictionary entry
+const char* getIndexFileWord(INDEX_FILE* indexFile, const INDEX_FILE_TERM* term);
+
+// startIndexFilePostings: points a cursor at the documentCount postings
+// of a term, which are decoded straight out of the mapping
+void startIndexFilePostings(POSTINGS_CURSOR* cursor, INDEX_FILE* indexFile,
+    const INDEX_FILE_TERM* term);
+
+// openIndexFileBitmap: points bitmap at the document bitmap of a term in
+// the mapping. Returns 0 if the term is stored as blocks
+int openIndexFileBitmap(INDEX_FILE* indexFile, const INDEX_FILE_TERM* term, DOC_BITMAP* bitmap);
+
+// reloadIndexFromBinaryFile: rebuilds the index in memory from a binary
+// index file without any text parsing
+INVERTED_INDEX* reloadIndexFromBinaryFile(char* loadFile, INVERTED_INDEX* indexReload);
+
+#endif
@@ -0,0 +1,358 @@
+/*
+
+FILE: indexrun.c
+Description: Builds an index larger than memory out of sorted runs. Such as:
+
+0. Writing the index in memory to a run file, sorted by word
+1. Reading the runs back one record at a time
+2. Merging the runs k ways into a text or binary index file
+
+By: Delos Chang
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../utils/header.h"
+#include "index.h"
+#include "indexfile.h"
+#include "indexrun.h"
+
+// writes size bytes to the run or aborts
+static void writeRunOrDie(const void* data, size_t size, FILE* fp, char* runFile){
+  if (size && fwrite(data, 1, size, fp) != size){
+    fprintf(stderr, "Error writing to the run %s \n", runFile);
+    exit(1);
+  }
+}
+
+// Writes one record per word, in sorted order. The postings are already
+// compressed, so they are copied out unchanged
+void writeIndexRun(INVERTED_INDEX* index, char* runFile){
+  INDEX_RUN_RECORD record;
+  WordNode** words;
+  FILE* fp;
+  int numWords;
+
+  fp = fopen(runFile, "w");
+  if (fp == NULL){
+    fprintf(stderr, "Error writing to the run %s \n", runFile);
+    exit(1);
+  }
+
+  words = sortedWordNodes(index, &numWords);
+
+  for (int i = 0; i < numWords; i++){
+    record.wordLength = (uint32_t) words[i]->length;
+    record.numPages = (uint32_t) words[i]->numPages;
+    record.postingsLength = (uint32_t) words[i]->postingsLength;
+
+    writeRunOrDie(&record, sizeof(INDEX_RUN_RECORD), fp, runFile);
+    writeRunOrDie(words[i]->word, words[i]->length, fp, runFile);
+    writeRunOrDie(words[i]->postings, words[i]->postingsLength, fp, runFile);
+  }
+
+  free(words);
+
+  if (fclose(fp) != 0){
+    fprintf(stderr, "Error writing to the run %s \n", runFile);
+    exit(1);
+  }
+}
+
+// Makes sure buffer holds at least needed bytes, doubling it if not
+static void *reserveRunBuffer(void* buffer, int* size, int needed){
+  if (needed <= *size){
+    return buffer;
+  }
+
+  while (*size < needed){
+    *size = *size > 0 ? *size * 2 : 64;
+  }
+
+  buffer = realloc(buffer, *size);
+  MALLOC_CHECK(buffer);
+  return buffer;
+}
+
+// Reads the next record of the run. The postings are only read if
+// withPostings is set, otherwise they are skipped. Returns 0 at the end
+// of the run
+static int nextRunRecord(INDEX_RUN* run, int withPostings){
+  INDEX_RUN_RECORD record;
+
+  if (fread(&record, sizeof(INDEX_RUN_RECORD), 1, run->fp) != 1){
+    if (ferror(run->fp)){
+      fprintf(stderr, "Error reading the run %s \n", run->path);
+      exit(1);
+    }
+    return 0;
+  }
+
+  run->word = (char*) reserveRunBuffer(run->word, &(run->maxWordLength),
+      (int) record.wordLength + 1);
+  if (fread(run->word, 1, record.wordLength, run->fp) != record.wordLength){
+    fprintf(stderr, "Error: the run %s is truncated \n", run->path);
+    exit(1);
+  }
+  run->word[record.wordLength] = '\0';
+  run->wordLength = (int) record.wordLength;
+  run->numPages = (int) record.numPages;
+  run->postingsLength = (int) record.postingsLength;
+
+  if (!withPostings){
+    if (fseek(run->fp, record.postingsLength, SEEK_CUR) != 0){
+      fprintf(stderr, "Error reading the run %s \n", run->path);
+      exit(1);
+    }
+    return 1;
+  }
+
+  run->postings = (unsigned char*) reserveRunBuffer(run->postings,
+      &(run->maxPostingsLength), run->postingsLength);
+  if (fread(run->postings, 1, record.postingsLength, run->fp) != record.postingsLength){
+    fprintf(stderr, "Error: the run %s is truncated \n", run->path);
+    exit(1);
+  }
+
+  return 1;
+}
+
+// Orders runs by their current word, then by position so that the
+// postings of a word come out in document order
+static int compareRuns(INDEX_RUN* a, INDEX_RUN* b){
+  int result = strcmp(a->word, b->word);
+  return result != 0 ? result : a->order - b->order;
+}
+
+// Moves the run at position down the heap until both its children
+// come after it
+static void siftRunDown(INDEX_RUN** heap, int heapSize, int position){
+  while (1){
+    int smallest = position;
+    int left = 2 * position + 1;
+    int right = left + 1;
+
+    if (left < heapSize && compareRuns(heap[left], heap[smallest]) < 0){
+      smallest = left;
+    }
+    if (right < heapSize && compareRuns(heap[right], heap[smallest]) < 0){
+      smallest = right;
+    }
+    if (smallest == position){
+      return;
+    }
+
+    INDEX_RUN* swap = heap[position];
+    heap[position] = heap[smallest];
+    heap[smallest] = swap;
+    position = smallest;
+  }
+}
+
+// Moves the run at position up the heap until its parent comes before it
+static void siftRunUp(INDEX_RUN** heap, int position){
+  while (position > 0){
+    int parent = (position - 1) / 2;
+
+    if (compareRuns(heap[parent], heap[position]) <= 0){
+      return;
+    }
+
+    INDEX_RUN* swap = heap[position];
+    heap[position] = heap[parent];
+    heap[parent] = swap;
+    position = parent;
+  }
+}
+
+// Opens the runs and puts those that are not empty on the heap. Returns
+// the size of the heap
+static int openRuns(INDEX_RUN* runs, INDEX_RUN** heap, char** runFiles, int numRuns,
+    int withPostings){
+  int heapSize = 0;
+
+  for (int r = 0; r < numRuns; r++){
+    BZERO(&(runs[r]), sizeof(INDEX_RUN));
+    runs[r].path = runFiles[r];
+    runs[r].order = r;
+    runs[r].fp = fopen(runFiles[r], "r");
+
+    if (runs[r].fp == NULL){
+      fprintf(stderr, "Could not read the run %s. Aborting. \n", runFiles[r]);
+      exit(1);
+    }
+
+    if (nextRunRecord(&(runs[r]), withPostings)){
+      heap[heapSize] = &(runs[r]);
+      siftRunUp(heap, heapSize);
+      heapSize++;
+    }
+  }
+
+  return heapSize;
+}
+
+static void closeRuns(INDEX_RUN* runs, int numRuns){
+  for (int r = 0; r < numRuns; r++){
+    fclose(runs[r].fp);
+    free(runs[r].word);
+    free(runs[r].postings);
+  }
+}
+
+// Takes every run whose current word is the smallest off the heap and
+// stores them in group, in run order. Returns how many there are
+static int popWordGroup(INDEX_RUN** heap, int* heapSize, INDEX_RUN** group){
+  int groupSize = 0;
+
+  do {
+    group[groupSize++] = heap[0];
+
+    (*heapSize)--;
+    heap[0] = heap[*heapSize];
+    siftRunDown(heap, *heapSize, 0);
+  } while (*heapSize > 0 && !strcmp(heap[0]->word, group[0]->word));
+
+  return groupSize;
+}
+
+// Moves the runs of the group to their next record and puts those that
+// have one back on the heap
+static void advanceWordGroup(INDEX_RUN** heap, int* heapSize, INDEX_RUN** group,
+    int groupSize, int withPostings){
+  for (int g = 0; g < groupSize; g++){
+    if (nextRunRecord(group[g], withPostings)){
+      heap[*heapSize] = group[g];
+      siftRunUp(heap, *heapSize);
+      (*heapSize)++;
+    }
+  }
+}
+
+// Writes the merged postings of the group as a line of the text index
+static void writeTextWord(FILE* fp, INDEX_RUN** group, int groupSize){
+  POSTINGS_CURSOR cursor;
+  int numPages = 0;
+
+  for (int g = 0; g < groupSize; g++){
+    numPages += group[g]->numPages;
+  }
+
+  fprintf(fp, "%s %d ", group[0]->word, numPages);
+
+  for (int g = 0; g < groupSize; g++){
+    startPostings(&cursor, group[g]->postings, group[g]->numPages);
+    while (nextPosting(&cursor)){
+      fprintf(fp, "%d %d ", cursor.documentId, cursor.frequency);
+    }
+  }
+
+  fprintf(fp, "\n");
+}
+
+// Writes the merged postings of the group to the binary index. Postings
+// from a single run are already encoded as they have to be; those of
+// several runs are appended one by one to a WordNode of the scratch index
+static void writeBinaryWord(INDEX_FILE_WRITER* writer, INDEX_RUN** group, int groupSize,
+    INVERTED_INDEX* scratch){
+  POSTINGS_CURSOR cursor;
+
+  if (groupSize == 1){
+    writeIndexFileTerm(writer, group[0]->word, group[0]->wordLength, group[0]->numPages,
+        group[0]->postings, group[0]->postingsLength);
+    return;
+  }
+
+  WordNode* wordNode = newWordNode(NULL, group[0]->word, scratch);
+
+  for (int g = 0; g < groupSize; g++){
+    startPostings(&cursor, group[g]->postings, group[g]->numPages);
+    while (nextPosting(&cursor)){
+      addPosting(wordNode, cursor.documentId, cursor.frequency, scratch);
+    }
+  }
+
+  writeIndexFileTerm(writer, wordNode->word, wordNode->length, wordNode->numPages,
+      wordNode->postings, wordNode->postingsLength);
+
+  if (indexMemoryUsed(scratch) > INDEX_RUN_SCRATCH_BYTES){
+    emptyIndex(scratch);
+  }
+}
+
+// Merges the runs with a heap. The binary format needs the number of
+// words and the size of their strings first, so for it the words alone
+// are merged once beforehand, skipping over the postings
+void mergeIndexRuns(char** runFiles, int numRuns, char* targetFile, int format){
+  INDEX_RUN* runs = (INDEX_RUN*) malloc(sizeof(INDEX_RUN) * (numRuns + 1));
+  INDEX_RUN** heap = (INDEX_RUN**) malloc(sizeof(INDEX_RUN*) * (numRuns + 1));
+  INDEX_RUN** group = (INDEX_RUN**) malloc(sizeof(INDEX_RUN*) * (numRuns + 1));
+  INDEX_FILE_WRITER* writer = NULL;
+  INVERTED_INDEX* scratch = NULL;
+  FILE* fp = NULL;
+  int heapSize, groupSize;
+
+  MALLOC_CHECK(runs);
+  MALLOC_CHECK(heap);
+  MALLOC_CHECK(group);
+
+  if (format == INDEX_FORMAT_BINARY){
+    uint32_t numWords = 0;
+    uint64_t stringsSize = 0;
+    uint64_t numPostings = 0;
+
+    heapSize = openRuns(runs, heap, runFiles, numRuns, 0);
+    while (heapSize > 0){
+      groupSize = popWordGroup(heap, &heapSize, group);
+
+      numWords++;
+      stringsSize += group[0]->wordLength + 1;
+      for (int g = 0; g < groupSize; g++){
+        numPostings += group[g]->numPages;
+      }
+
+      advanceWordGroup(heap, &heapSize, group, groupSize, 0);
+    }
+    closeRuns(runs, numRuns);
+
+    writer = startIndexFileWriter(targetFile, numWords, stringsSize, numPostings);
+    scratch = initStructure(scratch);
+  } else {
+    fp = fopen(targetFile, "w");
+
+    if (fp == NULL){
+      fprintf(stderr, "Error writing to the file %s", targetFile);
+      exit(1);
+    }
+  }
+
+  heapSize = openRuns(runs, heap, runFiles, numRuns, 1);
+  while (heapSize > 0){
+    groupSize = popWordGroup(heap, &heapSize, group);
+
+    if (writer != NULL){
+      writeBinaryWord(writer, group, groupSize, scratch);
+    } else {
+      writeTextWord(fp, group, groupSize);
+    }
+
+    advanceWordGroup(heap, &heapSize, group, groupSize, 1);
+  }
+  closeRuns(runs, numRuns);
+
+  if (writer != NULL){
+    finishIndexFileWriter(writer);
+    cleanUpIndex(scratch);
+  } else if (fclose(fp) != 0){
+    fprintf(stderr, "Error writing to the file %s \n", targetFile);
+    exit(1);
+  }
+
+  free(runs);
+  free(heap);
+  free(group);
+}
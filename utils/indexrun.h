@@ -0,0 +1,74 @@
+#ifndef _INDEXRUN_H_
+#define _INDEXRUN_H_
+
+// *****************Impementation Spec********************************
+// File: indexrun.c
+// Author: Delos Chang
+// This file contains useful information for the index runs:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// When the index being built would outgrow its memory budget, the
+// indexer writes it out as a run and starts over with an empty one. A
+// run is a file of records sorted by word:
+//
+//   INDEX_RUN_RECORD                  word length, documents, postings bytes
+//   char word[wordLength]             not NUL terminated
+//   unsigned char postings[]          compressed as in memory (see postings.h)
+//
+// The runs are merged k ways into the results file once every document
+// was indexed: the next word is taken from a heap of the runs, ordered by
+// word and then by run, so that the postings of a word come out in run
+// order. Runs hold consecutive documents in ascending order, so the
+// postings just follow one another and the file is the same as if the
+// whole index had been built in memory.
+//
+// Only the current record of each run is held in memory while merging.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "index.h"
+
+// DEFINES
+
+// the merge re-encodes the postings of words found in several runs in a
+// scratch index, which is emptied once it holds this many bytes
+#define INDEX_RUN_SCRATCH_BYTES (1024 * 1024)
+
+// DATA STRUCTURES
+
+// what comes before the word and postings of each record
+typedef struct _INDEX_RUN_RECORD {
+  uint32_t wordLength;                  // bytes of the word
+  uint32_t numPages;                    // number of (docId, freq) postings
+  uint32_t postingsLength;              // bytes of compressed postings
+} INDEX_RUN_RECORD;
+
+// a run being read back during the merge
+typedef struct _INDEX_RUN {
+  FILE *fp;
+  char *path;
+  int order;                            // position of the run in document order
+  char *word;                           // word of the current record (NUL terminated)
+  int wordLength;
+  int maxWordLength;                    // room in word
+  int numPages;                         // postings of the current record
+  unsigned char *postings;              // its postings (if they were read)
+  int postingsLength;
+  int maxPostingsLength;                // room in postings
+} INDEX_RUN;
+
+// function PROTOTYPES
+
+// writeIndexRun: writes every word of the index and its postings to
+// runFile, sorted by word. The index is left as it is
+void writeIndexRun(INVERTED_INDEX* index, char* runFile);
+
+// mergeIndexRuns: merges the numRuns run files, given in document order,
+// into targetFile in the format saveIndexToFile would have written
+// (INDEX_FORMAT_TEXT or INDEX_FORMAT_BINARY). The runs are left in place
+void mergeIndexRuns(char** runFiles, int numRuns, char* targetFile, int format);
+
+#endif
@@ -0,0 +1,188 @@
+/*
+
+FILE: indexstate.c
+Description: Records which pages an index was built from. Such as:
+
+0. Stating the pages of a directory
+1. Saving and loading the state next to the results file
+2. Telling which pages changed between two states
+
+By: Delos Chang
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../utils/header.h"
+#include "indexstate.h"
+#include "file.h"
+#include "pagestore.h"
+
+// Allocates a state for documents 1 to lastDocumentId, none of which
+// has a page yet
+static INDEX_STATE* newIndexState(int lastDocumentId){
+  INDEX_STATE* state = (INDEX_STATE*) malloc(sizeof(INDEX_STATE));
+  MALLOC_CHECK(state);
+
+  state->lastDocumentId = lastDocumentId;
+  state->documents = (INDEX_STATE_DOCUMENT*) malloc(sizeof(INDEX_STATE_DOCUMENT)
+      * (lastDocumentId + 1));
+  MALLOC_CHECK(state->documents);
+
+  for (int id = 0; id <= lastDocumentId; id++){
+    state->documents[id].mtimeSeconds = 0;
+    state->documents[id].mtimeNanoseconds = 0;
+    state->documents[id].size = -1;
+  }
+
+  return state;
+}
+
+// Records where each page of a page store lies and how long it is. The
+// records are never rewritten, so that is enough to tell them apart
+static void scanPageStoreState(INDEX_STATE* state, PAGE_STORE* store){
+  PAGE_RECORD_HEADER record;
+
+  for (int id = 1; id <= state->lastDocumentId; id++){
+    if (readPageRecord(store, id, &record)){
+      state->documents[id].mtimeSeconds = (long long) store->offsets[id - 1];
+      state->documents[id].size = (long long) (record.urlLength + record.bodyLength);
+    }
+  }
+}
+
+// Stats every page. A page that cannot be stated is recorded as missing
+INDEX_STATE* scanIndexState(char* dir, int lastDocumentId){
+  INDEX_STATE* state = newIndexState(lastDocumentId);
+  struct stat st;
+  char name[32];
+
+  PAGE_STORE* store = openPageStore(dir);
+  if (store != NULL){
+    scanPageStoreState(state, store);
+    closePageStore(store);
+    return state;
+  }
+
+  for (int id = 1; id <= lastDocumentId; id++){
+    char* filepath = NULL;
+
+    snprintf(name, sizeof(name), "%d", id);
+    filepath = createFilepath(filepath, dir, name);
+
+    if (stat(filepath, &st) == 0){
+      state->documents[id].mtimeSeconds = (long long) st.st_mtim.tv_sec;
+      state->documents[id].mtimeNanoseconds = st.st_mtim.tv_nsec;
+      state->documents[id].size = (long long) st.st_size;
+    }
+
+    free(filepath);
+  }
+
+  return state;
+}
+
+// Reads the header, then one line per document
+INDEX_STATE* loadIndexState(char* stateFile){
+  char magic[32];
+  int version;
+  int lastDocumentId;
+  FILE* fp;
+
+  fp = fopen(stateFile, "r");
+  if (fp == NULL){
+    return NULL;
+  }
+
+  if (fscanf(fp, "%31s %d %d", magic, &version, &lastDocumentId) != 3
+      || strcmp(magic, INDEX_STATE_MAGIC) != 0 || version != INDEX_STATE_VERSION
+      || lastDocumentId < 0){
+    fprintf(stderr, "Warning: %s is not a valid index state, ignoring it \n", stateFile);
+    fclose(fp);
+    return NULL;
+  }
+
+  INDEX_STATE* state = newIndexState(lastDocumentId);
+
+  for (int i = 1; i <= lastDocumentId; i++){
+    INDEX_STATE_DOCUMENT document;
+    int id;
+
+    if (fscanf(fp, "%d %lld %ld %lld", &id, &(document.mtimeSeconds),
+          &(document.mtimeNanoseconds), &(document.size)) != 4
+        || id < 1 || id > lastDocumentId){
+      fprintf(stderr, "Warning: %s is truncated, ignoring it \n", stateFile);
+      freeIndexState(state);
+      fclose(fp);
+      return NULL;
+    }
+
+    state->documents[id] = document;
+  }
+
+  fclose(fp);
+  return state;
+}
+
+void saveIndexState(INDEX_STATE* state, char* stateFile){
+  FILE* fp;
+
+  fp = fopen(stateFile, "w");
+  if (fp == NULL){
+    fprintf(stderr, "Error writing to the file %s", stateFile);
+    exit(1);
+  }
+
+  fprintf(fp, "%s %d\n%d\n", INDEX_STATE_MAGIC, INDEX_STATE_VERSION, state->lastDocumentId);
+
+  for (int id = 1; id <= state->lastDocumentId; id++){
+    INDEX_STATE_DOCUMENT* document = &(state->documents[id]);
+
+    fprintf(fp, "%d %lld %ld %lld\n", id, document->mtimeSeconds,
+        document->mtimeNanoseconds, document->size);
+  }
+
+  if (fclose(fp) != 0){
+    fprintf(stderr, "Error writing to the file %s \n", stateFile);
+    exit(1);
+  }
+}
+
+// A page changed if its size or modification time did, or if it
+// appeared or disappeared
+int indexStateChanged(INDEX_STATE* before, INDEX_STATE* now, int documentId){
+  INDEX_STATE_DOCUMENT* a = &(before->documents[documentId]);
+  INDEX_STATE_DOCUMENT* b = &(now->documents[documentId]);
+
+  return a->size != b->size || a->mtimeSeconds != b->mtimeSeconds
+    || a->mtimeNanoseconds != b->mtimeNanoseconds;
+}
+
+// Same last document and no page changed
+int indexStatesEqual(INDEX_STATE* a, INDEX_STATE* b){
+  if (a->lastDocumentId != b->lastDocumentId){
+    return 0;
+  }
+
+  for (int id = 1; id <= a->lastDocumentId; id++){
+    if (indexStateChanged(a, b, id)){
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+void freeIndexState(INDEX_STATE* state){
+  if (state == NULL){
+    return;
+  }
+
+  free(state->documents);
+  free(state);
+}
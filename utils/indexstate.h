@@ -0,0 +1,77 @@
+#ifndef _INDEXSTATE_H_
+#define _INDEXSTATE_H_
+
+// *****************Impementation Spec********************************
+// File: indexstate.c
+// Author: Delos Chang
+// This file contains useful information for the index state:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// The state of an index records which pages it was built from: the
+// highest document id and the modification time and size of every page.
+// (Pages of a page store record the offset of their record instead of a
+// modification time.) It is saved next to the results file (index.dat.state for index.dat)
+// in text:
+//
+//   tse-index-state 1
+//   2000                              highest document id
+//   1 1697000000 123456789 9123       id, mtime (seconds, nanoseconds), size
+//   2 ...
+//
+// Comparing the state an index was built with to the pages on disk now
+// tells which pages are new and which changed (or disappeared) since,
+// so that only those have to be indexed again.
+
+// DEFINES
+
+// first line of a state file
+#define INDEX_STATE_MAGIC "tse-index-state"
+
+// bump whenever the layout above changes
+#define INDEX_STATE_VERSION 1
+
+// appended to the results file name to name its state file
+#define INDEX_STATE_SUFFIX ".state"
+
+// DATA STRUCTURES
+
+// what is recorded of each page
+typedef struct _INDEX_STATE_DOCUMENT {
+  long long mtimeSeconds;           // modification time of the page
+  long mtimeNanoseconds;
+  long long size;                   // bytes in the page, -1 if there was no page
+} INDEX_STATE_DOCUMENT;
+
+typedef struct _INDEX_STATE {
+  int lastDocumentId;               // highest document id
+  INDEX_STATE_DOCUMENT *documents;  // documents[id] for ids 1 to lastDocumentId
+} INDEX_STATE;
+
+// function PROTOTYPES
+
+// scanIndexState: stats the pages 1 to lastDocumentId of dir and returns
+// their state. For a page store (see pagestore.h), the offset of each
+// record stands in for the modification time
+INDEX_STATE* scanIndexState(char* dir, int lastDocumentId);
+
+// loadIndexState: reads a state file. Returns NULL if there is none or it
+// is not a valid state file
+INDEX_STATE* loadIndexState(char* stateFile);
+
+// saveIndexState: writes the state to stateFile
+void saveIndexState(INDEX_STATE* state, char* stateFile);
+
+// indexStateChanged: returns 1 if the page documentId (at most the last
+// document of both states) differs between the two states, 0 otherwise
+int indexStateChanged(INDEX_STATE* before, INDEX_STATE* now, int documentId);
+
+// indexStatesEqual: returns 1 if both states have the same pages, none of
+// which changed, 0 otherwise
+int indexStatesEqual(INDEX_STATE* a, INDEX_STATE* b);
+
+// freeIndexState: frees the state
+void freeIndexState(INDEX_STATE* state);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+
+FILE: intersect.c
+Description: Intersects sorted arrays of document ids. Such as:
+
+0. Intersecting one id of each array at a time
+1. Intersecting blocks of 4 ids with SSE2
+2. Intersecting blocks of 8 ids with AVX2
+3. Picking the fastest kernel the CPU supports
+
+By: Delos Chang
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "intersect.h"
+
+// the vector kernels are compiled in on x86 with gcc or clang and only
+// used if the CPU running the program supports them
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INTERSECT_HAVE_SIMD 1
+#include <immintrin.h>
+#endif
+
+// kernel used by intersectDocumentIds, -1 until one is selected
+static int intersectKernel = -1;
+
+// picks the default kernel once
+static pthread_once_t defaultKernelOnce = PTHREAD_ONCE_INIT;
+
+// Merges from positions i and j on, moving on in the array that is behind
+static int intersectScalar(const int* a, int aLength, const int* b, int bLength,
+    int i, int j, int* aMatches, int* bMatches, int numMatches){
+  while (i < aLength && j < bLength){
+    if (a[i] < b[j]){
+      i++;
+    } else if (a[i] > b[j]){
+      j++;
+    } else {
+      aMatches[numMatches] = i;
+      bMatches[numMatches] = j;
+      numMatches++;
+      i++;
+      j++;
+    }
+  }
+
+  return numMatches;
+}
+
+#ifdef INTERSECT_HAVE_SIMD
+// Writes the positions of the matches two block masks describe. The ids
+// are increasing in both blocks, so the n-th lane set in one mask
+// matches the n-th lane set in the other
+static inline int addBlockMatches(int aMask, int bMask, int i, int j,
+    int* aMatches, int* bMatches, int numMatches){
+  while (aMask){
+    aMatches[numMatches] = i + __builtin_ctz(aMask);
+    bMatches[numMatches] = j + __builtin_ctz(bMask);
+    numMatches++;
+
+    aMask &= aMask - 1;
+    bMask &= bMask - 1;
+  }
+
+  return numMatches;
+}
+
+// Compares blocks of 4 ids: three rotations of each block give every pair
+__attribute__((target("sse2")))
+static int intersectSse2(const int* a, int aLength, const int* b, int bLength,
+    int* aMatches, int* bMatches){
+  int numMatches = 0;
+  int i = 0;
+  int j = 0;
+
+  while (i + 4 <= aLength && j + 4 <= bLength){
+    __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*) (b + j));
+
+    __m128i aEqual = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+          _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+        _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+          _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+    int aMask = _mm_movemask_ps(_mm_castsi128_ps(aEqual));
+
+    // most blocks have no match: only then are the lanes of b worked out
+    if (aMask){
+      __m128i bEqual = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi32(vb, va),
+            _mm_cmpeq_epi32(vb, _mm_shuffle_epi32(va, _MM_SHUFFLE(0, 3, 2, 1)))),
+          _mm_or_si128(_mm_cmpeq_epi32(vb, _mm_shuffle_epi32(va, _MM_SHUFFLE(1, 0, 3, 2))),
+            _mm_cmpeq_epi32(vb, _mm_shuffle_epi32(va, _MM_SHUFFLE(2, 1, 0, 3)))));
+      int bMask = _mm_movemask_ps(_mm_castsi128_ps(bEqual));
+
+      numMatches = addBlockMatches(aMask, bMask, i, j, aMatches, bMatches, numMatches);
+    }
+
+    int aLast = a[i + 3];
+    int bLast = b[j + 3];
+    if (aLast <= bLast){
+      i += 4;
+    }
+    if (bLast <= aLast){
+      j += 4;
+    }
+  }
+
+  return intersectScalar(a, aLength, b, bLength, i, j, aMatches, bMatches, numMatches);
+}
+
+// Compares blocks of 8 ids: seven rotations of one block give every pair
+__attribute__((target("avx2")))
+static int intersectAvx2(const int* a, int aLength, const int* b, int bLength,
+    int* aMatches, int* bMatches){
+  const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+  int numMatches = 0;
+  int i = 0;
+  int j = 0;
+
+  while (i + 8 <= aLength && j + 8 <= bLength){
+    __m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i*) (b + j));
+
+    __m256i aEqual = _mm256_cmpeq_epi32(va, vb);
+    __m256i rotated = vb;
+    for (int r = 1; r < 8; r++){
+      rotated = _mm256_permutevar8x32_epi32(rotated, rotate);
+      aEqual = _mm256_or_si256(aEqual, _mm256_cmpeq_epi32(va, rotated));
+    }
+    int aMask = _mm256_movemask_ps(_mm256_castsi256_ps(aEqual));
+
+    // most blocks have no match: only then are the lanes of b worked out
+    if (aMask){
+      __m256i bEqual = _mm256_cmpeq_epi32(vb, va);
+      rotated = va;
+      for (int r = 1; r < 8; r++){
+        rotated = _mm256_permutevar8x32_epi32(rotated, rotate);
+        bEqual = _mm256_or_si256(bEqual, _mm256_cmpeq_epi32(vb, rotated));
+      }
+      int bMask = _mm256_movemask_ps(_mm256_castsi256_ps(bEqual));
+
+      numMatches = addBlockMatches(aMask, bMask, i, j, aMatches, bMatches, numMatches);
+    }
+
+    int aLast = a[i + 7];
+    int bLast = b[j + 7];
+    if (aLast <= bLast){
+      i += 8;
+    }
+    if (bLast <= aLast){
+      j += 8;
+    }
+  }
+
+  return intersectScalar(a, aLength, b, bLength, i, j, aMatches, bMatches, numMatches);
+}
+#endif
+
+int selectIntersectKernel(int kernel){
+  intersectKernel = INTERSECT_KERNEL_SCALAR;
+
+#ifdef INTERSECT_HAVE_SIMD
+  if (kernel >= INTERSECT_KERNEL_AVX2 && __builtin_cpu_supports("avx2")){
+    intersectKernel = INTERSECT_KERNEL_AVX2;
+  } else if (kernel >= INTERSECT_KERNEL_SSE2 && __builtin_cpu_supports("sse2")){
+    intersectKernel = INTERSECT_KERNEL_SSE2;
+  }
+#endif
+
+  return intersectKernel;
+}
+
+// The fastest supported kernel, unless one was selected already
+static void selectDefaultKernel(){
+  if (intersectKernel < 0){
+    selectIntersectKernel(INTERSECT_KERNEL_AVX2);
+  }
+}
+
+int intersectDocumentIds(const int* a, int aLength, const int* b, int bLength,
+    int* aMatches, int* bMatches){
+  pthread_once(&defaultKernelOnce, selectDefaultKernel);
+
+#ifdef INTERSECT_HAVE_SIMD
+  if (intersectKernel == INTERSECT_KERNEL_AVX2){
+    return intersectAvx2(a, aLength, b, bLength, aMatches, bMatches);
+  }
+  if (intersectKernel == INTERSECT_KERNEL_SSE2){
+    return intersectSse2(a, aLength, b, bLength, aMatches, bMatches);
+  }
+#endif
+
+  return intersectScalar(a, aLength, b, bLength, 0, 0, aMatches, bMatches, 0);
+}
@@ -0,0 +1,45 @@
+#ifndef _INTERSECT_H_
+#define _INTERSECT_H_
+
+// *****************Impementation Spec********************************
+// File: intersect.c
+// Author: Delos Chang
+// This file contains useful information for intersecting document ids:
+// - DEFINES
+// - PROTOTYPES
+//
+// The kernels intersect two arrays of document ids in increasing order
+// (as postings are decoded) and return where each common id is in both
+// arrays, so that the caller can combine whatever it keeps next to them.
+//
+// The vector kernels compare a block of ids of one array with a block of
+// the other all at once: the block of the second array is rotated one
+// lane at a time and compared for equality, which gives a mask of the
+// lanes of each block that have a match. The block whose last id is the
+// smaller one is then moved past. They finish the last ids that do not
+// fill a block with the scalar kernel.
+
+#include <stdint.h>
+
+// DEFINES
+
+// kernels selectIntersectKernel can pick
+#define INTERSECT_KERNEL_SCALAR 0       // portable, one id of each array at a time
+#define INTERSECT_KERNEL_SSE2 1         // blocks of 4 ids
+#define INTERSECT_KERNEL_AVX2 2         // blocks of 8 ids
+
+// function PROTOTYPES
+
+// intersectDocumentIds: intersects a (aLength ids) and b (bLength ids)
+// with the selected kernel. For the n-th common id, aMatches[n] and
+// bMatches[n] are set to its positions in a and b; each needs room for
+// the shorter of the two arrays. Returns the number of common ids
+int intersectDocumentIds(const int* a, int aLength, const int* b, int bLength,
+    int* aMatches, int* bMatches);
+
+// selectIntersectKernel: makes intersectDocumentIds use kernel if this
+// CPU supports it, the next fastest one that it does otherwise. Returns
+// the kernel in use. Without a call, the fastest supported kernel is used
+int selectIntersectKernel(int kernel);
+
+#endif
@@ -0,0 +1,346 @@
+/*
+
+FILE: pagestore.c
+Description: Keeps the crawled pages of a directory in one file. Such as:
+
+0. Appending pages to a page store, and writing its offset table
+1. Opening a page store and finding its pages (even without a table)
+2. Reading a page, or only its URL, by document id
+3. Counting and loading pages whether they are in a store or in files
+
+By: Delos Chang
+
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../utils/header.h"
+#include "pagestore.h"
+#include "index.h"
+#include "file.h"
+
+// Reads size bytes at offset. Returns 1, or 0 if the file is shorter
+static int readAt(int fd, void* buffer, size_t size, uint64_t offset){
+  size_t done = 0;
+
+  while (done < size){
+    ssize_t length = pread(fd, (char*) buffer + done, size - done, (off_t) (offset + done));
+    if (length <= 0){
+      return 0;
+    }
+    done += length;
+  }
+
+  return 1;
+}
+
+// Writes size bytes at offset or aborts
+static void writeAt(PAGE_STORE* store, const void* buffer, size_t size, uint64_t offset){
+  size_t done = 0;
+
+  while (done < size){
+    ssize_t length = pwrite(store->fd, (const char*) buffer + done, size - done,
+        (off_t) (offset + done));
+    if (length <= 0){
+      fprintf(stderr, "Error writing to the page store %s \n", store->path);
+      exit(1);
+    }
+    done += length;
+  }
+}
+
+char* pageStorePath(char* dir){
+  char* path = NULL;
+  return createFilepath(path, dir, PAGE_STORE_NAME);
+}
+
+int hasPageStore(char* dir){
+  char* path = pageStorePath(dir);
+  int found = access(path, F_OK) == 0;
+
+  free(path);
+  return found;
+}
+
+// Records that page numPages + 1 starts at offset
+static void addPageOffset(PAGE_STORE* store, uint64_t offset){
+  if (store->numPages == store->maxPages){
+    store->maxPages = store->maxPages > 0 ? store->maxPages * 2 : 1024;
+    store->offsets = (uint64_t*) realloc(store->offsets, sizeof(uint64_t) * store->maxPages);
+    MALLOC_CHECK(store->offsets);
+  }
+
+  store->offsets[store->numPages++] = offset;
+}
+
+// Finds the records: from the offset table if the trailer is there and
+// makes sense, by walking them from the header otherwise. A record cut
+// short at the end is left out
+static void findPages(PAGE_STORE* store, uint64_t size){
+  PAGE_STORE_TRAILER trailer;
+  PAGE_RECORD_HEADER record;
+
+  if (size >= sizeof(PAGE_STORE_HEADER) + sizeof(PAGE_STORE_TRAILER)
+      && readAt(store->fd, &trailer, sizeof(PAGE_STORE_TRAILER), size - sizeof(PAGE_STORE_TRAILER))
+      && !memcmp(trailer.magic, PAGE_STORE_TRAILER_MAGIC, PAGE_STORE_MAGIC_LENGTH)
+      && trailer.tableOffset >= sizeof(PAGE_STORE_HEADER)
+      && trailer.numPages < INT32_MAX
+      && trailer.tableOffset + trailer.numPages * sizeof(uint64_t) + sizeof(PAGE_STORE_TRAILER) == size){
+    store->numPages = store->maxPages = (int) trailer.numPages;
+    store->offsets = (uint64_t*) malloc(sizeof(uint64_t) * (store->maxPages + 1));
+    MALLOC_CHECK(store->offsets);
+
+    if (!readAt(store->fd, store->offsets, sizeof(uint64_t) * store->numPages, trailer.tableOffset)){
+      fprintf(stderr, "Error reading the page store %s \n", store->path);
+      exit(1);
+    }
+
+    store->end = trailer.tableOffset;
+    return;
+  }
+
+  uint64_t offset = sizeof(PAGE_STORE_HEADER);
+  while (offset + sizeof(PAGE_RECORD_HEADER) <= size
+      && readAt(store->fd, &record, sizeof(PAGE_RECORD_HEADER), offset)){
+    uint64_t next = offset + sizeof(PAGE_RECORD_HEADER) + record.urlLength + record.bodyLength;
+    if (next > size){
+      break;
+    }
+
+    addPageOffset(store, offset);
+    offset = next;
+  }
+
+  store->end = offset;
+}
+
+// Opens path and checks its header. A new (empty) store gets a header
+// if writable is set. Returns NULL if the file cannot be opened or is not
+// a page store
+static PAGE_STORE* openPageStoreFile(char* path, int writable){
+  PAGE_STORE_HEADER header;
+  struct stat st;
+
+  int fd = writable ? open(path, O_RDWR | O_CREAT, 0644) : open(path, O_RDONLY);
+  if (fd < 0){
+    return NULL;
+  }
+
+  PAGE_STORE* store = (PAGE_STORE*) malloc(sizeof(PAGE_STORE));
+  MALLOC_CHECK(store);
+  BZERO(store, sizeof(PAGE_STORE));
+
+  store->fd = fd;
+  store->path = path;
+  store->writable = writable;
+
+  if (fstat(fd, &st) != 0){
+    fprintf(stderr, "Error reading the page store %s \n", path);
+    exit(1);
+  }
+
+  if (writable && st.st_size == 0){
+    BZERO(&header, sizeof(PAGE_STORE_HEADER));
+    memcpy(header.magic, PAGE_STORE_MAGIC, PAGE_STORE_MAGIC_LENGTH);
+    header.version = PAGE_STORE_VERSION;
+
+    writeAt(store, &header, sizeof(PAGE_STORE_HEADER), 0);
+    store->end = sizeof(PAGE_STORE_HEADER);
+    return store;
+  }
+
+  if (!readAt(fd, &header, sizeof(PAGE_STORE_HEADER), 0)
+      || memcmp(header.magic, PAGE_STORE_MAGIC, PAGE_STORE_MAGIC_LENGTH)
+      || header.version != PAGE_STORE_VERSION){
+    fprintf(stderr, "Warning: %s is not a valid page store \n", path);
+    close(fd);
+    free(store);
+    return NULL;
+  }
+
+  findPages(store, (uint64_t) st.st_size);
+  return store;
+}
+
+PAGE_STORE* openPageStore(char* dir){
+  char* path = pageStorePath(dir);
+  PAGE_STORE* store = openPageStoreFile(path, 0);
+
+  if (store == NULL){
+    free(path);
+  }
+  return store;
+}
+
+// The offset table is dropped: new records go over it and it is
+// written again on close
+PAGE_STORE* createPageStore(char* dir){
+  char* path = pageStorePath(dir);
+  PAGE_STORE* store = openPageStoreFile(path, 1);
+
+  if (store == NULL){
+    fprintf(stderr, "Error: could not open the page store %s for writing \n", path);
+    exit(1);
+  }
+
+  if (ftruncate(store->fd, (off_t) store->end) != 0){
+    fprintf(stderr, "Error writing to the page store %s \n", path);
+    exit(1);
+  }
+
+  return store;
+}
+
+int appendPage(PAGE_STORE* store, const char* url, int depth, const char* body,
+    size_t bodyLength){
+  PAGE_RECORD_HEADER record;
+
+  record.urlLength = (uint32_t) strlen(url);
+  record.depth = (uint32_t) depth;
+  record.bodyLength = (uint64_t) bodyLength;
+
+  uint64_t offset = store->end;
+  writeAt(store, &record, sizeof(PAGE_RECORD_HEADER), offset);
+  writeAt(store, url, record.urlLength, offset + sizeof(PAGE_RECORD_HEADER));
+  writeAt(store, body, bodyLength, offset + sizeof(PAGE_RECORD_HEADER) + record.urlLength);
+
+  addPageOffset(store, offset);
+  store->end = offset + sizeof(PAGE_RECORD_HEADER) + record.urlLength + bodyLength;
+
+  return store->numPages;
+}
+
+// Reads the record header of page documentId. Returns 0 if there is
+// no such page
+int readPageRecord(PAGE_STORE* store, int documentId, PAGE_RECORD_HEADER* record){
+  if (documentId < 1 || documentId > store->numPages){
+    return 0;
+  }
+
+  if (!readAt(store->fd, record, sizeof(PAGE_RECORD_HEADER), store->offsets[documentId - 1])){
+    fprintf(stderr, "Error reading the page store %s \n", store->path);
+    exit(1);
+  }
+  return 1;
+}
+
+// The URL and the body are read straight into place around the depth
+char* readPage(PAGE_STORE* store, int documentId){
+  PAGE_RECORD_HEADER record;
+  char depthLine[16];
+
+  if (!readPageRecord(store, documentId, &record)){
+    return NULL;
+  }
+
+  uint64_t start = store->offsets[documentId - 1] + sizeof(PAGE_RECORD_HEADER);
+  int depthLength = snprintf(depthLine, sizeof(depthLine), "\n%u\n", record.depth);
+
+  char* html = (char*) malloc(record.urlLength + depthLength + record.bodyLength + 1);
+  MALLOC_CHECK(html);
+
+  if (!readAt(store->fd, html, record.urlLength, start)
+      || !readAt(store->fd, html + record.urlLength + depthLength, record.bodyLength,
+        start + record.urlLength)){
+    fprintf(stderr, "Error reading the page store %s \n", store->path);
+    exit(1);
+  }
+
+  memcpy(html + record.urlLength, depthLine, depthLength);
+  html[record.urlLength + depthLength + record.bodyLength] = '\0';
+
+  return html;
+}
+
+int readPageURL(PAGE_STORE* store, int documentId, char* url, size_t size){
+  PAGE_RECORD_HEADER record;
+
+  if (size == 0 || !readPageRecord(store, documentId, &record)){
+    return 0;
+  }
+
+  size_t length = record.urlLength < size - 1 ? record.urlLength : size - 1;
+  if (!readAt(store->fd, url, length, store->offsets[documentId - 1] + sizeof(PAGE_RECORD_HEADER))){
+    fprintf(stderr, "Error reading the page store %s \n", store->path);
+    exit(1);
+  }
+
+  url[length] = '\0';
+  return 1;
+}
+
+// The table goes right after the last record, then the trailer
+void closePageStore(PAGE_STORE* store){
+  if (store == NULL){
+    return;
+  }
+
+  if (store->writable){
+    PAGE_STORE_TRAILER trailer;
+
+    BZERO(&trailer, sizeof(PAGE_STORE_TRAILER));
+    trailer.tableOffset = store->end;
+    trailer.numPages = (uint64_t) store->numPages;
+    memcpy(trailer.magic, PAGE_STORE_TRAILER_MAGIC, PAGE_STORE_MAGIC_LENGTH);
+
+    uint64_t tableLength = sizeof(uint64_t) * store->numPages;
+    writeAt(store, store->offsets, tableLength, store->end);
+    writeAt(store, &trailer, sizeof(PAGE_STORE_TRAILER), store->end + tableLength);
+  }
+
+  if (close(store->fd) != 0){
+    fprintf(stderr, "Error closing the page store %s \n", store->path);
+    exit(1);
+  }
+
+  free(store->offsets);
+  free(store->path);
+  free(store);
+}
+
+int countPages(char* dir){
+  PAGE_STORE* store = openPageStore(dir);
+
+  if (store == NULL){
+    return dirScan(dir);
+  }
+
+  int numPages = store->numPages;
+  closePageStore(store);
+
+  return numPages;
+}
+
+char* loadPage(char* dir, int documentId){
+  char* html;
+  char name[32];
+
+  PAGE_STORE* store = openPageStore(dir);
+  if (store != NULL){
+    html = readPage(store, documentId);
+    closePageStore(store);
+
+    if (html == NULL){
+      fprintf(stderr, "Could not read page %d of the page store of %s. Aborting. \n",
+          documentId, dir);
+      exit(1);
+    }
+    return html;
+  }
+
+  char* filepath = NULL;
+  snprintf(name, sizeof(name), "%d", documentId);
+  filepath = createFilepath(filepath, dir, name);
+
+  html = loadDocument(filepath);
+
+  free(filepath);
+  return html;
+}
@@ -0,0 +1,126 @@
+#ifndef _PAGESTORE_H_
+#define _PAGESTORE_H_
+
+// *****************Impementation Spec********************************
+// File: pagestore.c
+// Author: Delos Chang
+// This file contains useful information for the page store:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// A page store keeps every crawled page of a directory in a single
+// append-only file (PAGE_STORE_NAME) instead of one file per page:
+//
+//   PAGE_STORE_HEADER
+//   record[numPages]                  page 1, 2, ... in crawl order
+//   uint64_t offsets[numPages]        where each record starts
+//   PAGE_STORE_TRAILER
+//
+// where a record is a PAGE_RECORD_HEADER followed by the URL and the body
+// of the page (neither NUL terminated). The document id of a page is its
+// position in the file, starting at 1, the same as the name of its file.
+//
+// Pages are appended over the offset table, which is written out again
+// when the store is closed. A store whose crawl was cut short has no
+// trailer; its records are then found by walking them from the start.
+//
+// Reading a page gives the same buffer as reading its file: the URL,
+// the depth and the body on lines of their own. So the indexer and the
+// query engine can use either, and pick the store when a directory has
+// one.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// DEFINES
+
+// name of the page store inside a page directory
+#define PAGE_STORE_NAME "pages.tse"
+
+// first and last bytes of every page store
+#define PAGE_STORE_MAGIC "TSEPAGES"
+#define PAGE_STORE_TRAILER_MAGIC "TSEPGEND"
+#define PAGE_STORE_MAGIC_LENGTH 8
+
+// bump whenever the layout above changes
+#define PAGE_STORE_VERSION 1
+
+// DATA STRUCTURES
+
+typedef struct _PAGE_STORE_HEADER {
+  char magic[PAGE_STORE_MAGIC_LENGTH];  // PAGE_STORE_MAGIC, not NUL terminated
+  uint32_t version;                     // PAGE_STORE_VERSION
+  uint32_t reserved;                    // 0
+} PAGE_STORE_HEADER;
+
+typedef struct _PAGE_RECORD_HEADER {
+  uint32_t urlLength;                   // bytes of the URL
+  uint32_t depth;                       // crawl depth of the page
+  uint64_t bodyLength;                  // bytes of the HTML
+} PAGE_RECORD_HEADER;
+
+typedef struct _PAGE_STORE_TRAILER {
+  uint64_t tableOffset;                 // where the offset table starts
+  uint64_t numPages;                    // entries in the offset table
+  char magic[PAGE_STORE_MAGIC_LENGTH];  // PAGE_STORE_TRAILER_MAGIC
+} PAGE_STORE_TRAILER;
+
+// an opened page store
+typedef struct _PAGE_STORE {
+  int fd;
+  char *path;
+  int writable;                         // 1 if pages can be appended
+  int numPages;
+  int maxPages;                         // room in offsets
+  uint64_t *offsets;                    // offsets[id - 1] is the record of page id
+  uint64_t end;                         // end of the last record
+} PAGE_STORE;
+
+// function PROTOTYPES
+
+// pageStorePath: returns the (malloc'ed) path of the page store of dir
+char* pageStorePath(char* dir);
+
+// hasPageStore: returns 1 if dir has a page store, 0 otherwise
+int hasPageStore(char* dir);
+
+// openPageStore: opens the page store of dir for reading. Returns NULL if
+// there is none or it is not a valid page store
+PAGE_STORE* openPageStore(char* dir);
+
+// createPageStore: opens the page store of dir for appending, creating it
+// if there is none yet
+PAGE_STORE* createPageStore(char* dir);
+
+// appendPage: adds a page at the end of the store and returns its
+// document id
+int appendPage(PAGE_STORE* store, const char* url, int depth, const char* body,
+    size_t bodyLength);
+
+// readPageRecord: reads the record header of the page documentId into
+// record. Returns 1, or 0 if there is no such page
+int readPageRecord(PAGE_STORE* store, int documentId, PAGE_RECORD_HEADER* record);
+
+// readPage: returns the page documentId as its file would hold it (the
+// URL, the depth and the body, NUL terminated), to be freed by the caller.
+// Returns NULL if the store has no such page
+char* readPage(PAGE_STORE* store, int documentId);
+
+// readPageURL: copies the URL of the page documentId, NUL terminated and
+// cut to size bytes, into url. Returns 1, or 0 if there is no such page
+int readPageURL(PAGE_STORE* store, int documentId, char* url, size_t size);
+
+// closePageStore: writes the offset table and the trailer of a store
+// opened for appending, then closes the store and frees it
+void closePageStore(PAGE_STORE* store);
+
+// countPages: returns the number of pages of dir, whether they are in a
+// page store or in a file each (see dirScan)
+int countPages(char* dir);
+
+// loadPage: returns the page documentId of dir (from its page store or
+// its file) as loadDocument would, to be freed by the caller
+char* loadPage(char* dir, int documentId);
+
+#endif
@@ -0,0 +1,487 @@
+/*
+
+FILE: postings.c
+Description: Compressed (delta + varint / block) posting lists. Such as:
+
+0. Encoding numbers as varints
+1. Decoding varints
+2. Encoding blocks of postings (StreamVByte layout)
+3. Decoding blocks with SSSE3 or a portable scalar decoder
+4. Walking a compressed posting list with a cursor
+5. Walking the document bitmap and frequencies of a dense word with one
+6. Skipping a cursor ahead to a document, over whole blocks by their
+   headers and through one by galloping
+
+By: Delos Chang
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "postings.h"
+
+// the SSSE3 decoder is compiled in on x86 with gcc or clang and only used
+// if the CPU running the program supports it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POSTINGS_HAVE_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+// bytes taken by the 4 numbers a control byte describes
+static unsigned char controlLengths[256];
+
+#ifdef POSTINGS_HAVE_SSSE3
+// for each control byte, moves the bytes of 4 numbers into 4 int lanes
+static unsigned char shuffleMasks[256][16];
+#endif
+
+// decoder used by decodePostingsBlock, -1 until one is selected
+static int postingsDecoder = -1;
+
+// picks the default decoder once, even with several threads decoding
+static pthread_once_t defaultDecoderOnce = PTHREAD_ONCE_INIT;
+
+// Writes 7 bits per byte until the rest of the value fits
+int encodeVarint(unsigned char* out, uint32_t value){
+  int length = 0;
+
+  while (value >= 0x80){
+    out[length++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = (unsigned char) value;
+
+  return length;
+}
+
+// Collects 7 bits per byte until a byte without the high bit
+const unsigned char* decodeVarint(const unsigned char* in, uint32_t* value){
+  uint32_t result = 0;
+  int shift = 0;
+
+  // most gaps and frequencies fit in a single byte
+  while (*in & 0x80){
+    result |= (uint32_t) (*in & 0x7F) << shift;
+    shift += 7;
+    in++;
+  }
+  result |= (uint32_t) *in << shift;
+
+  *value = result;
+  return in + 1;
+}
+
+// bytes needed to store value (at least 1)
+static int byteLength(uint32_t value){
+  if (value < (1u << 8)){
+    return 1;
+  } else if (value < (1u << 16)){
+    return 2;
+  } else if (value < (1u << 24)){
+    return 3;
+  }
+  return 4;
+}
+
+// Writes the lengths of POSTINGS_BLOCK_SIZE values to control and their
+// bytes to data. Returns the byte after the data
+static unsigned char* encodeStream(unsigned char* control, unsigned char* data,
+    const uint32_t* values){
+  for (int i = 0; i < POSTINGS_BLOCK_SIZE; i += 4){
+    unsigned char lengths = 0;
+
+    for (int j = 0; j < 4; j++){
+      uint32_t value = values[i + j];
+      int length = byteLength(value);
+
+      lengths |= (unsigned char) ((length - 1) << (2 * j));
+      for (int b = 0; b < length; b++){
+        *data++ = (unsigned char) (value >> (8 * b));
+      }
+    }
+
+    control[i / 4] = lengths;
+  }
+
+  return data;
+}
+
+// Block layout: header (sum of the gaps, bytes that follow), gap
+// lengths, frequency lengths, gap bytes, frequency bytes
+int encodePostingsBlock(unsigned char* out, const uint32_t* gaps, const uint32_t* frequencies){
+  uint32_t span = 0;
+  uint32_t bodyLength = POSTINGS_BLOCK_SIZE / 2;
+
+  for (int i = 0; i < POSTINGS_BLOCK_SIZE; i++){
+    span += gaps[i];
+    bodyLength += byteLength(gaps[i]) + byteLength(frequencies[i]);
+  }
+
+  int headerLength = encodeVarint(out, span);
+  headerLength += encodeVarint(out + headerLength, bodyLength);
+
+  unsigned char* body = out + headerLength;
+  unsigned char* data = body + POSTINGS_BLOCK_SIZE / 2;
+
+  data = encodeStream(body, data, gaps);
+  data = encodeStream(body + POSTINGS_BLOCK_SIZE / 4, data, frequencies);
+
+  return (int) (data - out);
+}
+
+// Reads the header of the block at in: sets the bytes of the rest of the
+// block and returns where they start. The last document id of the block
+// is previousDocumentId plus the span
+static const unsigned char* readBlockHeader(const unsigned char* in, uint32_t* span,
+    uint32_t* bodyLength){
+  in = decodeVarint(in, span);
+  return decodeVarint(in, bodyLength);
+}
+
+// Decodes the 4 numbers a control byte describes, one byte at a time
+static const unsigned char* decodeQuad(unsigned char control, const unsigned char* data,
+    int* values){
+  for (int j = 0; j < 4; j++){
+    int length = ((control >> (2 * j)) & 3) + 1;
+    uint32_t value = 0;
+
+    for (int b = 0; b < length; b++){
+      value |= (uint32_t) data[b] << (8 * b);
+    }
+
+    values[j] = (int) value;
+    data += length;
+  }
+
+  return data;
+}
+
+// The portable decoder
+static const unsigned char* decodeBlockScalar(const unsigned char* in, int previousDocumentId,
+    int* documentIds, int* frequencies){
+  const unsigned char* data = in + POSTINGS_BLOCK_SIZE / 2;
+
+  for (int i = 0; i < POSTINGS_BLOCK_SIZE / 4; i++){
+    data = decodeQuad(in[i], data, &(documentIds[4 * i]));
+  }
+  for (int i = 0; i < POSTINGS_BLOCK_SIZE / 4; i++){
+    data = decodeQuad(in[POSTINGS_BLOCK_SIZE / 4 + i], data, &(frequencies[4 * i]));
+  }
+
+  // turn the gaps into document ids
+  for (int i = 0; i < POSTINGS_BLOCK_SIZE; i++){
+    previousDocumentId += documentIds[i];
+    documentIds[i] = previousDocumentId;
+  }
+
+  return data;
+}
+
+#ifdef POSTINGS_HAVE_SSSE3
+// The SSSE3 decoder: one unaligned load and one byte shuffle give 4
+// numbers, and the gaps are summed into document ids 4 at a time
+__attribute__((target("ssse3")))
+static const unsigned char* decodeBlockSsse3(const unsigned char* in, int previousDocumentId,
+    int* documentIds, int* frequencies){
+  const unsigned char* control = in;
+  const unsigned char* data = in + POSTINGS_BLOCK_SIZE / 2;
+  __m128i carry = _mm_set1_epi32(previousDocumentId);
+  int i;
+
+  // the frequency bytes follow the gaps, so the 16 byte loads of the
+  // gaps never read past the block
+  for (i = 0; i < POSTINGS_BLOCK_SIZE / 4; i++){
+    __m128i gaps = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) data),
+        _mm_loadu_si128((const __m128i*) shuffleMasks[control[i]]));
+    data += controlLengths[control[i]];
+
+    // prefix sum of the 4 gaps plus the last document id so far
+    gaps = _mm_add_epi32(gaps, _mm_slli_si128(gaps, 4));
+    gaps = _mm_add_epi32(gaps, _mm_slli_si128(gaps, 8));
+    gaps = _mm_add_epi32(gaps, carry);
+    _mm_storeu_si128((__m128i*) &(documentIds[4 * i]), gaps);
+
+    carry = _mm_shuffle_epi32(gaps, 0xFF);
+  }
+
+  // the frequencies end the block: find where, and finish the last few
+  // numbers one byte at a time instead of loading past it
+  control = in + POSTINGS_BLOCK_SIZE / 4;
+  const unsigned char* end = data;
+  for (i = 0; i < POSTINGS_BLOCK_SIZE / 4; i++){
+    end += controlLengths[control[i]];
+  }
+
+  for (i = 0; i < POSTINGS_BLOCK_SIZE / 4 && data + 16 <= end; i++){
+    __m128i values = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) data),
+        _mm_loadu_si128((const __m128i*) shuffleMasks[control[i]]));
+    data += controlLengths[control[i]];
+
+    _mm_storeu_si128((__m128i*) &(frequencies[4 * i]), values);
+  }
+  for (; i < POSTINGS_BLOCK_SIZE / 4; i++){
+    data = decodeQuad(control[i], data, &(frequencies[4 * i]));
+  }
+
+  return end;
+}
+#endif
+
+// Fills the lookup tables of the block decoders
+static void buildDecoderTables(){
+  for (int control = 0; control < 256; control++){
+    int length = 0;
+
+    for (int j = 0; j < 4; j++){
+      int bytes = ((control >> (2 * j)) & 3) + 1;
+
+#ifdef POSTINGS_HAVE_SSSE3
+      // 0xFF zeroes the unused high bytes of the lane
+      for (int b = 0; b < 4; b++){
+        shuffleMasks[control][4 * j + b] = (unsigned char) (b < bytes ? length + b : 0xFF);
+      }
+#endif
+      length += bytes;
+    }
+
+    controlLengths[control] = (unsigned char) length;
+  }
+}
+
+int selectPostingsDecoder(int decoder){
+  buildDecoderTables();
+
+  postingsDecoder = POSTINGS_DECODER_SCALAR;
+
+#ifdef POSTINGS_HAVE_SSSE3
+  if (decoder == POSTINGS_DECODER_SSSE3 && __builtin_cpu_supports("ssse3")){
+    postingsDecoder = POSTINGS_DECODER_SSSE3;
+  }
+#endif
+
+  return postingsDecoder;
+}
+
+// The fastest supported decoder, unless one was selected already
+static void selectDefaultDecoder(){
+  if (postingsDecoder < 0){
+    selectPostingsDecoder(POSTINGS_DECODER_SSSE3);
+  }
+}
+
+const unsigned char* decodePostingsBlock(const unsigned char* in, int previousDocumentId,
+    int* documentIds, int* frequencies){
+  uint32_t span;
+  uint32_t bodyLength;
+
+  pthread_once(&defaultDecoderOnce, selectDefaultDecoder);
+  in = readBlockHeader(in, &span, &bodyLength);
+
+#ifdef POSTINGS_HAVE_SSSE3
+  if (postingsDecoder == POSTINGS_DECODER_SSSE3){
+    return decodeBlockSsse3(in, previousDocumentId, documentIds, frequencies);
+  }
+#endif
+
+  return decodeBlockScalar(in, previousDocumentId, documentIds, frequencies);
+}
+
+void startPostings(POSTINGS_CURSOR* cursor, const unsigned char* postings, int numPages){
+  cursor->next = postings;
+  cursor->remaining = numPages;
+  cursor->blocks = numPages > 0 ? (numPages - 1) / POSTINGS_BLOCK_SIZE : 0;
+  cursor->buffered = 0;
+  cursor->documentId = 0; // the first gap is the document id itself
+  cursor->frequency = 0;
+  cursor->bitmap.header = NULL;
+}
+
+// The ids come out of the bitmap a block at a time, so that nextPosting
+// walks them like decoded blocks
+void startBitmapPostings(POSTINGS_CURSOR* cursor, const DOC_BITMAP* bitmap,
+    const unsigned char* frequencies, int frequencyWidth){
+  int numPages = docBitmapCardinality(bitmap);
+
+  startPostings(cursor, frequencies, numPages);
+  cursor->blocks = (numPages + POSTINGS_BLOCK_SIZE - 1) / POSTINGS_BLOCK_SIZE;
+  cursor->bitmap = *bitmap;
+  cursor->frequencyWidth = frequencyWidth;
+  cursor->bitmapRank = 0;
+  startDocBitmapIds(&(cursor->bitmapIds));
+}
+
+int readFrequency(const unsigned char* frequencies, int width, int position){
+  if (width == 1){
+    return frequencies[position];
+  }
+
+  if (width == 2){
+    uint16_t frequency;
+    memcpy(&frequency, frequencies + 2 * position, sizeof(uint16_t));
+    return frequency;
+  }
+
+  uint32_t frequency;
+  memcpy(&frequency, frequencies + 4 * (size_t) position, sizeof(uint32_t));
+  return (int) frequency;
+}
+
+// Reads the next (up to) POSTINGS_BLOCK_SIZE ids of the bitmap and their
+// frequencies into the end of the block buffers. The frequencies are
+// found by the rank of the ids, which is looked up again after a seek
+static void readBitmapBlock(POSTINGS_CURSOR* cursor){
+  int numIds = readDocBitmapIds(&(cursor->bitmap), &(cursor->bitmapIds),
+      cursor->blockDocumentIds, POSTINGS_BLOCK_SIZE);
+  int first = POSTINGS_BLOCK_SIZE - numIds;
+
+  if (numIds == 0){
+    cursor->remaining = 0;
+    cursor->buffered = 0;
+    return;
+  }
+
+  if (cursor->bitmapRank < 0){
+    cursor->bitmapRank = docBitmapRank(&(cursor->bitmap), cursor->blockDocumentIds[0]);
+  }
+
+  memmove(cursor->blockDocumentIds + first, cursor->blockDocumentIds, sizeof(int) * numIds);
+  for (int i = 0; i < numIds; i++){
+    cursor->blockFrequencies[first + i] = readFrequency(cursor->next, cursor->frequencyWidth,
+        cursor->bitmapRank + i);
+  }
+
+  // the ids from this block on, however many were skipped
+  cursor->remaining = docBitmapCardinality(&(cursor->bitmap)) - cursor->bitmapRank;
+  cursor->blocks = (cursor->remaining + POSTINGS_BLOCK_SIZE - 1) / POSTINGS_BLOCK_SIZE;
+  cursor->bitmapRank += numIds;
+  cursor->buffered = numIds;
+}
+
+// Returns the next posting of the decoded block, decoding the next block
+// when needed, or the next (gap, frequency) pair of the tail
+int nextPosting(POSTINGS_CURSOR* cursor){
+  if (cursor->remaining == 0){
+    return 0;
+  }
+
+  if (cursor->buffered == 0 && cursor->blocks > 0){
+    if (cursor->bitmap.header != NULL){
+      readBitmapBlock(cursor);
+      if (cursor->remaining == 0){
+        return 0;
+      }
+    } else {
+      cursor->next = decodePostingsBlock(cursor->next, cursor->documentId,
+          cursor->blockDocumentIds, cursor->blockFrequencies);
+      cursor->buffered = POSTINGS_BLOCK_SIZE;
+    }
+    cursor->blocks--;
+  }
+
+  if (cursor->buffered > 0){
+    int position = POSTINGS_BLOCK_SIZE - cursor->buffered;
+
+    cursor->documentId = cursor->blockDocumentIds[position];
+    cursor->frequency = cursor->blockFrequencies[position];
+    cursor->buffered--;
+  } else {
+    uint32_t gap;
+    uint32_t frequency;
+
+    cursor->next = decodeVarint(cursor->next, &gap);
+    cursor->next = decodeVarint(cursor->next, &frequency);
+
+    cursor->documentId += (int) gap;
+    cursor->frequency = (int) frequency;
+  }
+
+  cursor->remaining--;
+
+  return 1;
+}
+
+// Moves the cursor to the first id of its decoded block, after the
+// current one, that is at least documentId (the last one is): steps of
+// 1, 2, 4, ... find a range it is in, which is then binary searched
+static void gallopBlock(POSTINGS_CURSOR* cursor, int documentId){
+  const int* ids = cursor->blockDocumentIds;
+  int first = POSTINGS_BLOCK_SIZE - cursor->buffered;
+  int low = first;
+  int high = first;
+  int step = 1;
+
+  while (ids[high] < documentId){
+    low = high + 1;
+    high += step;
+    step <<= 1;
+    if (high > POSTINGS_BLOCK_SIZE - 1){
+      high = POSTINGS_BLOCK_SIZE - 1;
+    }
+  }
+
+  while (low < high){
+    int middle = low + (high - low) / 2;
+    if (ids[middle] < documentId){
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  cursor->documentId = ids[low];
+  cursor->frequency = cursor->blockFrequencies[low];
+  cursor->remaining -= low - first + 1;
+  cursor->buffered = POSTINGS_BLOCK_SIZE - 1 - low;
+}
+
+// The rest of a decoded block is dropped at once when its last id is
+// still before documentId, and otherwise galloped through. A block that
+// is not decoded yet is jumped over when its header says it ends before
+// documentId. A bitmap skips straight to documentId
+int advancePosting(POSTINGS_CURSOR* cursor, int documentId){
+  while (cursor->remaining > 0){
+    if (cursor->buffered > 0){
+      if (cursor->blockDocumentIds[POSTINGS_BLOCK_SIZE - 1] >= documentId){
+        gallopBlock(cursor, documentId);
+        return 1;
+      }
+
+      cursor->remaining -= cursor->buffered;
+      cursor->documentId = cursor->blockDocumentIds[POSTINGS_BLOCK_SIZE - 1];
+      cursor->buffered = 0;
+
+      if (cursor->bitmap.header != NULL && cursor->remaining > 0){
+        seekDocBitmapIds(&(cursor->bitmap), &(cursor->bitmapIds), documentId);
+        cursor->bitmapRank = -1;
+        cursor->blocks = 1;
+      }
+      continue;
+    }
+
+    if (cursor->blocks > 0 && cursor->bitmap.header == NULL){
+      uint32_t span;
+      uint32_t bodyLength;
+      const unsigned char* body = readBlockHeader(cursor->next, &span, &bodyLength);
+
+      if ((long) cursor->documentId + (long) span < documentId){
+        cursor->next = body + bodyLength;
+        cursor->documentId += (int) span;
+        cursor->remaining -= POSTINGS_BLOCK_SIZE;
+        cursor->blocks--;
+        continue;
+      }
+    }
+
+    if (!nextPosting(cursor)){
+      return 0;
+    }
+    if (cursor->documentId >= documentId){
+      return 1;
+    }
+  }
+
+  return 0;
+}
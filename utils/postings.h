@@ -0,0 +1,139 @@
+#ifndef _POSTINGS_H_
+#define _POSTINGS_H_
+
+// *****************Impementation Spec********************************
+// File: postings.c
+// Author: Delos Chang
+// This file contains useful information for the compressed posting lists:
+// - DEFINES
+// - DATA STRUCTURES
+// - PROTOTYPES
+//
+// A posting is a (gap, frequency) pair. The gap is the difference to the
+// previous document id (the first gap is the document id itself).
+//
+// The postings of a word are stored as a run of full blocks followed by
+// a tail:
+//
+//   block[(numPages - 1) / POSTINGS_BLOCK_SIZE]   sealed, never change
+//   tail                                          1 to POSTINGS_BLOCK_SIZE postings
+//
+// The tail is a run of varints (7 bits per byte, least significant group
+// first, high bit set on every byte but the last) so that postings can
+// be appended and the last frequency rewritten cheaply. Once the tail
+// holds POSTINGS_BLOCK_SIZE postings and another one comes in, the tail
+// is sealed into a block.
+//
+// A block starts with a header of two varints: the sum of its gaps (so
+// its last document id is the previous one plus that) and the number of
+// bytes after the header. Skipping ahead reads only the header of a
+// block that ends before the document it is looking for and jumps past
+// it without decoding it.
+//
+// The rest of a block uses the StreamVByte layout: the 2 bit byte lengths
+// of all the gaps and then of all the frequencies (4 to a control byte),
+// followed by the bytes of the gaps and then those of the frequencies.
+// The lengths being separate from the data is what lets a block be
+// decoded with a byte shuffle per 4 numbers (SSSE3) instead of a branch
+// per byte. A portable scalar decoder is used where SSSE3 is not
+// available.
+//
+// The same encoding is used by the WordNodes in memory and by the binary
+// index file, so postings are written out and mapped back in unchanged.
+// They are decoded on the fly with a POSTINGS_CURSOR.
+//
+// The binary index file keeps the document ids of dense words in a
+// document bitmap instead (see docbitmap.h), with their frequencies in
+// document order next to it. A cursor reads those in the same way.
+
+#include <stdint.h>
+
+#include "docbitmap.h"
+
+// DEFINES
+
+// a 32 bit number never takes more than this many bytes as a varint
+#define POSTINGS_MAX_VARINT_BYTES 5
+
+// number of postings in a block
+#define POSTINGS_BLOCK_SIZE 128
+
+// largest possible encoded block (header, control bytes and 4 bytes a number)
+#define POSTINGS_MAX_BLOCK_BYTES (2 * POSTINGS_MAX_VARINT_BYTES \
+    + POSTINGS_BLOCK_SIZE / 2 + 2 * 4 * POSTINGS_BLOCK_SIZE)
+
+// block decoders selectPostingsDecoder can pick
+#define POSTINGS_DECODER_SCALAR 0       // portable, one number at a time
+#define POSTINGS_DECODER_SSSE3 1        // 4 numbers per byte shuffle
+
+// DATA STRUCTURES
+
+// reads the postings of one word in document order
+typedef struct _POSTINGS_CURSOR {
+  const unsigned char *next;        // next byte to decode
+  int remaining;                    // postings not returned yet
+  int blocks;                       // blocks not decoded yet
+  int buffered;                     // postings of the decoded block not returned yet
+  int documentId;                   // document of the current posting
+  int frequency;                    // occurrences in that document
+  int blockDocumentIds[POSTINGS_BLOCK_SIZE];   // the decoded block
+  int blockFrequencies[POSTINGS_BLOCK_SIZE];
+  DOC_BITMAP bitmap;                // the document ids of a dense word
+                                    // (header is NULL for blocks)
+  DOC_BITMAP_ITERATOR bitmapIds;    // how many of them were read
+  int bitmapRank;                   // rank of the next id (-1 after a seek)
+  int frequencyWidth;               // bytes of each of its frequencies
+} POSTINGS_CURSOR;
+
+// function PROTOTYPES
+
+// encodeVarint: writes value to out and returns the number of bytes used
+// (at most POSTINGS_MAX_VARINT_BYTES)
+int encodeVarint(unsigned char* out, uint32_t value);
+
+// decodeVarint: reads one number from in into value and returns the
+// byte after it
+const unsigned char* decodeVarint(const unsigned char* in, uint32_t* value);
+
+// encodePostingsBlock: writes POSTINGS_BLOCK_SIZE gaps and frequencies
+// to out as a block and returns the number of bytes used (at most
+// POSTINGS_MAX_BLOCK_BYTES)
+int encodePostingsBlock(unsigned char* out, const uint32_t* gaps, const uint32_t* frequencies);
+
+// decodePostingsBlock: decodes the block at in with the selected decoder.
+// The gaps are added up starting from previousDocumentId. Returns the
+// byte after the block
+const unsigned char* decodePostingsBlock(const unsigned char* in, int previousDocumentId,
+    int* documentIds, int* frequencies);
+
+// selectPostingsDecoder: makes decodePostingsBlock use decoder if this
+// CPU supports it, the scalar one otherwise. Returns the decoder in use.
+// Without a call, the fastest supported decoder is used. It is not meant
+// to be called while other threads are decoding
+int selectPostingsDecoder(int decoder);
+
+// startPostings: points the cursor before the first of numPages postings
+void startPostings(POSTINGS_CURSOR* cursor, const unsigned char* postings, int numPages);
+
+// startBitmapPostings: points the cursor before the first posting of a
+// word whose document ids are in bitmap and whose frequencies (one for
+// each id, frequencyWidth bytes each) start at frequencies
+void startBitmapPostings(POSTINGS_CURSOR* cursor, const DOC_BITMAP* bitmap,
+    const unsigned char* frequencies, int frequencyWidth);
+
+// readFrequency: returns the frequency at position of a run of
+// frequencies that are width bytes each
+int readFrequency(const unsigned char* frequencies, int width, int position);
+
+// nextPosting: moves the cursor to the next posting. Returns 1 and sets
+// documentId and frequency, or returns 0 once every posting was read
+int nextPosting(POSTINGS_CURSOR* cursor);
+
+// advancePosting: moves the cursor to the first posting after the
+// current one whose document id is at least documentId, jumping over
+// the blocks that end before it and galloping through the one it is in.
+// Returns 1 and sets documentId and frequency, or returns 0 if there is
+// none
+int advancePosting(POSTINGS_CURSOR* cursor, int documentId);
+
+#endif